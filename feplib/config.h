@@ -1,6 +1,151 @@
 #ifndef CONFIG_H
 #define CONFIG_H
 
+/* Every option may be overridden by a compiler definition, e.g. from a build system */
+
+#ifndef OPENEPT_ED_CONF_RECEIVE_BUFFER_SIZE
 #define OPENEPT_ED_CONF_RECEIVE_BUFFER_SIZE    100
+#endif
+#ifndef OPENEPT_ED_CONF_TRANSMIT_BUFFER_SIZE
+#define OPENEPT_ED_CONF_TRANSMIT_BUFFER_SIZE   64
+#endif
+/* Maximum time OpenEPT_ED_Platform_Read waits for a character */
+#ifndef OPENEPT_ED_CONF_READ_TIMEOUT_MS
+#define OPENEPT_ED_CONF_READ_TIMEOUT_MS        1000
+#endif
+
+/* Number of START/STOP resends when Acquisition device does not respond, 0 resends forever */
+#ifndef OPENEPT_ED_CONF_HANDSHAKE_RETRIES
+#define OPENEPT_ED_CONF_HANDSHAKE_RETRIES      5
+#endif
+/* Time to wait for START/STOP response before resending */
+#ifndef OPENEPT_ED_CONF_HANDSHAKE_TIMEOUT_MS
+#define OPENEPT_ED_CONF_HANDSHAKE_TIMEOUT_MS   1000
+#endif
+/* Delay before first resend, doubled on every next resend up to OPENEPT_ED_CONF_HANDSHAKE_BACKOFF_MAX_MS */
+#ifndef OPENEPT_ED_CONF_HANDSHAKE_BACKOFF_MS
+#define OPENEPT_ED_CONF_HANDSHAKE_BACKOFF_MS   100
+#endif
+#ifndef OPENEPT_ED_CONF_HANDSHAKE_BACKOFF_MAX_MS
+#define OPENEPT_ED_CONF_HANDSHAKE_BACKOFF_MAX_MS 2000
+#endif
+
+/*
+ * Link baud rates offered to Acquisition device in START handshake, comma separated and
+ * terminated with 0 (e.g. 1000000, 2000000, 4000000, 0). Only 0 disables negotiation.
+ */
+#ifndef OPENEPT_ED_CONF_LINK_BAUDRATES
+#define OPENEPT_ED_CONF_LINK_BAUDRATES         0
+#endif
+
+/*
+ * Binary protocol version offered to Acquisition device in START handshake (see protocol.h).
+ * Acquisition devices that do not select it keep receiving ASCII frames; 0 disables the offer.
+ */
+#ifndef OPENEPT_ED_CONF_PROTOCOL_VERSION
+#define OPENEPT_ED_CONF_PROTOCOL_VERSION       1
+#endif
+
+/* Maximum number of energy point names registered with OpenEPT_ED_RegisterEP */
+#ifndef OPENEPT_ED_CONF_EP_DICTIONARY_SIZE
+#define OPENEPT_ED_CONF_EP_DICTIONARY_SIZE     32
+#endif
+
+/* Buffer for encoded OPENEPT_EPF arguments (bytes); arguments that do not fit are not sent */
+#ifndef OPENEPT_ED_CONF_EP_ARGS_SIZE
+#define OPENEPT_ED_CONF_EP_ARGS_SIZE           32
+#endif
+
+/* Open regions whose IDs are kept to check OpenEPT_ED_End; deeper regions are sent but not checked */
+#ifndef OPENEPT_ED_CONF_REGION_DEPTH
+#define OPENEPT_ED_CONF_REGION_DEPTH           8
+#endif
+
+/*
+ * Event batching in binary sessions: events are collected into one frame that is sent when
+ * it reaches OPENEPT_ED_CONF_BATCH_SIZE bytes (0 disables batching), when the oldest event is
+ * OPENEPT_ED_CONF_BATCH_AGE_MS old (0 for no age limit) or on OpenEPT_ED_Flush/OpenEPT_ED_Stop.
+ * OPENEPT_ED_CONF_BATCH_BUFFER_SIZE is the largest batch (bytes, at most 251).
+ */
+#ifndef OPENEPT_ED_CONF_BATCH_BUFFER_SIZE
+#define OPENEPT_ED_CONF_BATCH_BUFFER_SIZE      128
+#endif
+#ifndef OPENEPT_ED_CONF_BATCH_SIZE
+#define OPENEPT_ED_CONF_BATCH_SIZE             0
+#endif
+#ifndef OPENEPT_ED_CONF_BATCH_AGE_MS
+#define OPENEPT_ED_CONF_BATCH_AGE_MS           10
+#endif
+
+/*
+ * Link clock synchronization in binary sessions with event timestamps: DUT sends ping records
+ * and Acquisition device answers with its receive and send time. A burst of
+ * OPENEPT_ED_CONF_CLOCK_FILTER exchanges follows START, then one exchange is made every
+ * OPENEPT_ED_CONF_CLOCK_PERIOD_MS from OpenEPT_ED_Poll (0 disables). The estimate comes from
+ * the exchange with the shortest round trip among the last OPENEPT_ED_CONF_CLOCK_FILTER ones.
+ */
+#ifndef OPENEPT_ED_CONF_CLOCK_PERIOD_MS
+#define OPENEPT_ED_CONF_CLOCK_PERIOD_MS        1000
+#endif
+#ifndef OPENEPT_ED_CONF_CLOCK_FILTER
+#define OPENEPT_ED_CONF_CLOCK_FILTER           4
+#endif
+
+/* Sequence numbers on events of binary sessions, so Acquisition device detects lost events (1 enables) */
+#ifndef OPENEPT_ED_CONF_EVENT_SEQUENCE
+#define OPENEPT_ED_CONF_EVENT_SEQUENCE         1
+#endif
+/*
+ * Event frame that does not fit into transport transmit queue: OPENEPT_ED_OVERFLOW_BLOCK,
+ * OPENEPT_ED_OVERFLOW_DROP_NEWEST, OPENEPT_ED_OVERFLOW_DROP_OLDEST or OPENEPT_ED_OVERFLOW_MARK.
+ * Default for OpenEPT_ED_SetOverflowPolicy.
+ */
+#ifndef OPENEPT_ED_CONF_OVERFLOW_POLICY
+#define OPENEPT_ED_CONF_OVERFLOW_POLICY        OPENEPT_ED_OVERFLOW_BLOCK
+#endif
+
+/*
+ * Lock-free ring that events from interrupts and threads are queued to (slots, power of two,
+ * 0 disables). Producers only queue; events are sent by OpenEPT_ED_Poll, OpenEPT_ED_Flush and
+ * the control functions, e.g. in a task woken by OpenEPT_ED_Platform_DrainRequest. Requires
+ * compare-and-swap (GCC atomics: LDREX/STREX on Cortex-M, native on hosts).
+ * OPENEPT_ED_CONF_EVENT_RING_SLOT_SIZE is the largest queued event payload (bytes), larger
+ * events are dropped. A control function that finds another thread using the transport
+ * yields and fails with OPEN_EPT_STATUS_TIMEOUT after OPENEPT_ED_CONF_LOCK_TIMEOUT_MS.
+ */
+#ifndef OPENEPT_ED_CONF_EVENT_RING_SLOTS
+#define OPENEPT_ED_CONF_EVENT_RING_SLOTS       0
+#endif
+#ifndef OPENEPT_ED_CONF_EVENT_RING_SLOT_SIZE
+#define OPENEPT_ED_CONF_EVENT_RING_SLOT_SIZE   48
+#endif
+#ifndef OPENEPT_ED_CONF_LOCK_TIMEOUT_MS
+#define OPENEPT_ED_CONF_LOCK_TIMEOUT_MS        100
+#endif
+
+/*
+ * Threads with a private event buffer per context (0 disables), see
+ * OpenEPT_ED_AttachThread, and events each buffer holds until the next drain (power of two).
+ * Queued events are at most OPENEPT_ED_CONF_EVENT_RING_SLOT_SIZE bytes.
+ */
+#ifndef OPENEPT_ED_CONF_THREAD_BUFFERS
+#define OPENEPT_ED_CONF_THREAD_BUFFERS         0
+#endif
+#ifndef OPENEPT_ED_CONF_THREAD_BUFFER_SLOTS
+#define OPENEPT_ED_CONF_THREAD_BUFFER_SLOTS    32
+#endif
+
+/* Transmit ring of buffered platform transports (bytes, power of two) */
+#ifndef OPENEPT_ED_CONF_TX_RING_SIZE
+#define OPENEPT_ED_CONF_TX_RING_SIZE           1024
+#endif
+/* Frame that does not fit into transmit ring: OPENEPT_ED_TX_OVERFLOW_BLOCK or OPENEPT_ED_TX_OVERFLOW_DROP */
+#ifndef OPENEPT_ED_CONF_TX_OVERFLOW_POLICY
+#define OPENEPT_ED_CONF_TX_OVERFLOW_POLICY     OPENEPT_ED_TX_OVERFLOW_BLOCK
+#endif
+/* Maximum time OpenEPT_ED_Platform_Flush waits for transmit ring to drain */
+#ifndef OPENEPT_ED_CONF_TX_FLUSH_TIMEOUT_MS
+#define OPENEPT_ED_CONF_TX_FLUSH_TIMEOUT_MS    100
+#endif
 
 #endif  // CONFIG_H
\ No newline at end of file
@@ -10,169 +10,1900 @@
  * @author Dimitrije Lilic, Haris Turkmanovic
  */
 
+ #include <stdarg.h>
  #include <stdio.h>
  #include <string.h> 
  #include "feplib.h"
  #include "platform.h"
+ #include "protocol.h"
  
 
- static uint8_t OPENEPT_START_MSG[]           = "START\r";
- static uint8_t OPENEPT_START_MSG_SIZE        = 6;
- static uint8_t OPENEPT_STOP_MSG[]            = "STOP\r";
- static uint8_t OPENEPT_STOP_MSG_SIZE         = 5;
- static uint8_t OPENEPT_RECEIVE_BUFFER[OPENEPT_CONF_RECEIVE_BUFFER_SIZE];
+ static const uint8_t OPENEPT_START_MSG[]     = "0:START\r";
+ static const uint8_t OPENEPT_START_MSG_SIZE  = 8;
+ static const uint8_t OPENEPT_STOP_MSG[]      = "0:STOP\r";
+ static const uint8_t OPENEPT_STOP_MSG_SIZE   = 7;
+ static const uint8_t OPENEPT_BAUD_MSG[]      = "0:BAUD\r";
+ static const uint8_t OPENEPT_BAUD_MSG_SIZE   = 7;
+ static const uint32_t OPENEPT_LINK_BAUDRATES[] = { OPENEPT_CONF_LINK_BAUDRATES };
+ static const uint8_t OPENEPT_MSG_TERMINATOR[]    = "\r";
+ static const uint8_t OPENEPT_STOP_COMMAND[]      = { OPENEPT_ED_CONTROL_STOP };
+ /* START message offering supported baud rates and protocol, "0:START BAUD=<rate>,<rate>... PROTO=<version>\r" */
+ static uint8_t OPENEPT_START_NEGOTIATE_MSG[OPENEPT_CONF_TRANSMIT_BUFFER_SIZE];
+ static uint32_t OPENEPT_START_NEGOTIATE_MSG_SIZE;
+ /* STOP message in binary protocol */
+ static uint8_t OPENEPT_STOP_BINARY_MSG[8];
+ static uint32_t OPENEPT_STOP_BINARY_MSG_SIZE;
  
+ #if OPENEPT_CONF_PROTOCOL_VERSION > OPENEPT_ED_PROTOCOL_VERSION
+ #error "OPENEPT_ED_CONF_PROTOCOL_VERSION is higher than implemented protocol version"
+ #endif
  
+ /* Bounds of OPENEPT_EP_SECTION provided by the linker, weak so that firmware without descriptors links */
+ #if defined(__GNUC__)
+ extern const char __start_openept_eps[] __attribute__((weak));
+ extern const char __stop_openept_eps[] __attribute__((weak));
+ #define OPENEPT_EP_SECTION_START   __start_openept_eps
+ #define OPENEPT_EP_SECTION_STOP    __stop_openept_eps
+ #else
+ #define OPENEPT_EP_SECTION_START   ((const char*)0)
+ #define OPENEPT_EP_SECTION_STOP    ((const char*)0)
+ #endif
  
- int OpenEPT_ED_Init()
+ /* Timestamp record: type, size and varint timestamp */
+ #define OPENEPT_TIMESTAMP_RECORD_SIZE  (2 + OPENEPT_ED_PROTOCOL_VARINT64_MAX_SIZE)
+ /* Records placed before an event record: dropped frame count, sequence number and timestamp */
+ #define OPENEPT_EVENT_HEADER_SIZE      (2 * (2 + OPENEPT_ED_PROTOCOL_VARINT_MAX_SIZE) + OPENEPT_TIMESTAMP_RECORD_SIZE)
+ /* Frame with a single dropped record */
+ #define OPENEPT_DROPPED_FRAME_SIZE     (2 + OPENEPT_ED_PROTOCOL_VARINT_MAX_SIZE + 5)
+ 
+ #if OPENEPT_CONF_CLOCK_FILTER < 1
+ #error "OPENEPT_ED_CONF_CLOCK_FILTER must be at least 1"
+ #endif
+ 
+ #if (OPENEPT_CONF_THREAD_BUFFER_SLOTS & (OPENEPT_CONF_THREAD_BUFFER_SLOTS - 1)) != 0
+ #error "OPENEPT_ED_CONF_THREAD_BUFFER_SLOTS must be a power of two"
+ #endif
+ #if (OPENEPT_CONF_EVENT_RING_SLOTS & (OPENEPT_CONF_EVENT_RING_SLOTS - 1)) != 0
+ #error "OPENEPT_ED_CONF_EVENT_RING_SLOTS must be a power of two"
+ #endif
+ #if OPENEPT_CONF_EVENT_RING_SLOT_SIZE > 255
+ #error "OPENEPT_ED_CONF_EVENT_RING_SLOT_SIZE must be at most 255"
+ #endif
+ 
+ #if OPENEPT_CONF_BATCH_BUFFER_SIZE > OPENEPT_ED_PROTOCOL_MAX_RAW_SIZE - 2
+ #error "OPENEPT_ED_CONF_BATCH_BUFFER_SIZE does not fit into one binary frame"
+ #endif
+ 
+ /* Largest record list (including CRC) of one binary frame */
+ #if OPENEPT_CONF_TRANSMIT_BUFFER_SIZE - 2 < OPENEPT_ED_PROTOCOL_MAX_RAW_SIZE
+ #define OPENEPT_BINARY_RAW_SIZE    (OPENEPT_CONF_TRANSMIT_BUFFER_SIZE - 2)
+ #else
+ #define OPENEPT_BINARY_RAW_SIZE    OPENEPT_ED_PROTOCOL_MAX_RAW_SIZE
+ #endif
+ 
+ #if OPENEPT_BINARY_RAW_SIZE - 5 <= OPENEPT_EVENT_HEADER_SIZE + 2 * OPENEPT_ED_PROTOCOL_VARINT_MAX_SIZE
+ #error "OPENEPT_ED_CONF_TRANSMIT_BUFFER_SIZE is too small for binary event frames"
+ #endif
+ 
+ 
+ static uint32_t OpenEPT_ED_FormatU32(uint8_t* buffer, uint32_t value)
+ {
+     uint8_t digits[10];
+     uint32_t cnt = 0;
+     uint32_t size = 0;
+     do
+     {
+         digits[cnt++] = (uint8_t)('0' + value % 10);
+         value /= 10;
+     }while(value != 0);
+     while(cnt > 0) buffer[size++] = digits[--cnt];
+     return size;
+ }
+ 
+ uint64_t OpenEPT_ED_ExtendCounter(OpenEPT_ED_CounterExtender* extender, uint32_t counter, uint32_t tickMs, uint32_t frequency)
+ {
+     uint32_t delta = counter - extender->counter;
+     uint64_t expected = (uint64_t)(tickMs - extender->tickMs) * (frequency / 1000);
+ 
+     //Counter wrapped (expected - delta) / 2^32 times more than delta shows, rounded to absorb tick jitter
+     if(expected > delta) extender->value += ((expected - delta + 0x80000000ull) >> 32) << 32;
+     extender->value += delta;
+     extender->counter = counter;
+     extender->tickMs = tickMs;
+     return extender->value;
+ }
+ 
+ /*
+  * Build START message with baud rate and protocol offer. Returns 0 if there is nothing to offer.
+  */
+ static uint32_t OpenEPT_ED_BuildNegotiateMsg()
+ {
+     uint32_t size = 0;
+     uint32_t cnt;
+ 
+     if(OPENEPT_LINK_BAUDRATES[0] == 0 && OPENEPT_CONF_PROTOCOL_VERSION == 0) return 0;
+     memcpy(OPENEPT_START_NEGOTIATE_MSG, OPENEPT_START_MSG, OPENEPT_START_MSG_SIZE - 1);
+     size = OPENEPT_START_MSG_SIZE - 1;
+     if(OPENEPT_LINK_BAUDRATES[0] != 0)
+     {
+         memcpy(&OPENEPT_START_NEGOTIATE_MSG[size], " BAUD=", 6);
+         size += 6;
+     }
+     for(cnt = 0; OPENEPT_LINK_BAUDRATES[cnt] != 0; cnt++)
+     {
+         //Leave room for separator, longest rate, protocol offer and terminator
+         if(size + 22 > OPENEPT_CONF_TRANSMIT_BUFFER_SIZE) break;
+         if(cnt != 0) OPENEPT_START_NEGOTIATE_MSG[size++] = ',';
+         size += OpenEPT_ED_FormatU32(&OPENEPT_START_NEGOTIATE_MSG[size], OPENEPT_LINK_BAUDRATES[cnt]);
+     }
+     if(OPENEPT_CONF_PROTOCOL_VERSION != 0)
+     {
+         memcpy(&OPENEPT_START_NEGOTIATE_MSG[size], " PROTO=", 7);
+         size += 7;
+         size += OpenEPT_ED_FormatU32(&OPENEPT_START_NEGOTIATE_MSG[size], OPENEPT_CONF_PROTOCOL_VERSION);
+     }
+     OPENEPT_START_NEGOTIATE_MSG[size++] = '\r';
+     return size;
+ }
+ 
+ /*
+  * Store record "<type><varint size><prefix><content>" at raw. Returns record size.
+  */
+ static uint32_t OpenEPT_ED_PutRecord(uint8_t* raw, uint8_t type, const uint8_t* prefix, uint32_t prefixSize, const uint8_t* content, uint32_t contentSize)
+ {
+     uint32_t size = 0;
+ 
+     raw[size++] = type;
+     size += OpenEPT_ED_Protocol_PutVarint(&raw[size], prefixSize + contentSize);
+     if(prefixSize != 0) memcpy(&raw[size], prefix, prefixSize);
+     size += prefixSize;
+     if(contentSize != 0) memcpy(&raw[size], content, contentSize);
+     size += contentSize;
+     return size;
+ }
+ 
+ /*
+  * Append CRC to records at buffer[1]..buffer[size] and COBS encode the frame. Returns encoded size.
+  */
+ static uint32_t OpenEPT_ED_EncodeFrame(uint8_t* buffer, uint32_t size)
  {
-     if(OpenEPT_ED_Platform_Init() != 0) return OPEN_EPT_STATUS_ERROR;
-     memset(OPENEPT_RECEIVE_BUFFER, 0, OPENEPT_CONF_RECEIVE_BUFFER_SIZE);
+     uint16_t crc = OpenEPT_ED_Protocol_Crc16(0xFFFF, &buffer[1], size);
+     buffer[1 + size++] = (uint8_t)crc;
+     buffer[1 + size++] = (uint8_t)(crc >> 8);
+     return OpenEPT_ED_Protocol_CobsEncode(buffer, size);
+ }
+ 
+ /*
+  * Build binary frame from one record in buffer. Record payload is prefix followed by content.
+  * Header holds complete records (e.g. event timestamp) placed before the record. Returns encoded size.
+  */
+ static uint32_t OpenEPT_ED_BuildRecordFrame(uint8_t* buffer, const uint8_t* header, uint32_t headerSize, uint8_t type, const uint8_t* prefix, uint32_t prefixSize, const uint8_t* content, uint32_t contentSize)
+ {
+     if(headerSize != 0) memcpy(&buffer[1], header, headerSize);
+     return OpenEPT_ED_EncodeFrame(buffer, headerSize + OpenEPT_ED_PutRecord(&buffer[1 + headerSize], type, prefix, prefixSize, content, contentSize));
+ }
+ 
+ /*
+  * Find "OK" response in receive buffer. Returns index after "OK" or -1.
+  */
+ static int32_t OpenEPT_ED_FindOK(OpenEPT_ED_Context* ctx, uint32_t size)
+ {
+     uint32_t cnt;
+     for(cnt = 0; cnt + 1 < size; cnt++)
+     {
+         if(ctx->receiveBuffer[cnt] == 'O' && ctx->receiveBuffer[cnt + 1] == 'K') return (int32_t)(cnt + 2);
+     }
+     return -1;
+ }
+ 
+ /*
+  * Parse optional " <option><number>" (e.g. " BAUD=<rate>") that follows "OK" in START response. Returns 0 if absent.
+  */
+ static uint32_t OpenEPT_ED_ParseOption(OpenEPT_ED_Context* ctx, uint32_t pos, uint32_t size, const char* option)
+ {
+     uint32_t optionSize = strlen(option);
+     uint32_t value = 0;
+ 
+     for(; pos + optionSize + 1 <= size; pos++)
+     {
+         if(ctx->receiveBuffer[pos] == ' ' && memcmp(&ctx->receiveBuffer[pos + 1], option, optionSize) == 0) break;
+     }
+     if(pos + optionSize + 1 > size) return 0;
+     for(pos += optionSize + 1; pos < size && ctx->receiveBuffer[pos] >= '0' && ctx->receiveBuffer[pos] <= '9'; pos++)
+     {
+         value = value * 10 + (ctx->receiveBuffer[pos] - '0');
+     }
+     return value;
+ }
+ 
+ /*
+  * Check whether received line is an answer to a clock ping, "PONG ..." (see OPENEPT_ED_RECORD_PING).
+  */
+ static uint8_t OpenEPT_ED_IsPong(OpenEPT_ED_Context* ctx, uint32_t size)
+ {
+     return size >= 5 && memcmp(ctx->receiveBuffer, "PONG ", 5) == 0;
+ }
+ 
+ /*
+  * Parse " <number>" of PONG line, 64 bit wide. Returns position after the number, 0 if there is none.
+  */
+ static uint32_t OpenEPT_ED_ParseU64(OpenEPT_ED_Context* ctx, uint32_t pos, uint32_t size, uint64_t* value)
+ {
+     uint32_t start;
+ 
+     if(pos >= size || ctx->receiveBuffer[pos] != ' ') return 0;
+     *value = 0;
+     for(start = ++pos; pos < size && ctx->receiveBuffer[pos] >= '0' && ctx->receiveBuffer[pos] <= '9'; pos++)
+     {
+         *value = *value * 10 + (ctx->receiveBuffer[pos] - '0');
+     }
+     return pos != start ? pos : 0;
+ }
+ 
+ 
+ /*
+  * Optional transport operations
+  */
+ static int OpenEPT_ED_TransportSendSegments(OpenEPT_ED_Context* ctx, const OpenEPT_ED_Segment* segments, uint32_t count)
+ {
+     uint32_t cnt;
+     if(ctx->ops->sendSegments != NULL) return ctx->ops->sendSegments(ctx->arg, segments, count);
+     for(cnt = 0; cnt < count; cnt++)
+     {
+         if(ctx->ops->sendBuffer(ctx->arg, segments[cnt].data, segments[cnt].size) != 0) return OPEN_EPT_STATUS_ERROR;
+     }
      return OPEN_EPT_STATUS_OK;
  }
  
- int OpenEPT_ED_Start()
+ static int OpenEPT_ED_TransportFlush(OpenEPT_ED_Context* ctx)
  {
-     uint32_t cntSend;
-     uint32_t cntRec;
-     char data = 0;
-     uint8_t pingResend = 1;
+     if(ctx->ops->flush == NULL) return OPEN_EPT_STATUS_OK;
+     return ctx->ops->flush(ctx->arg);
+ }
+ 
+ static int OpenEPT_ED_TransportTryRead(OpenEPT_ED_Context* ctx, char* data)
+ {
+     if(ctx->ops->tryRead == NULL) return OPEN_EPT_STATUS_ERROR;
+     return ctx->ops->tryRead(ctx->arg, data);
+ }
+ 
+ /*
+  * Send frame the overflow policy must not discard: definitions and control records that
+  * later events depend on.
+  */
+ static int OpenEPT_ED_TransportSendProtected(OpenEPT_ED_Context* ctx, const uint8_t* buffer, uint32_t size)
+ {
+     if(ctx->ops->sendBuffer(ctx->arg, buffer, size) != 0) return OPEN_EPT_STATUS_ERROR;
+     if(ctx->ops->txProtect != NULL) ctx->ops->txProtect(ctx->arg);
+     return OPEN_EPT_STATUS_OK;
+ }
+ 
+ 
+ /*
+  * Build "<type>:<content>\r" frame and hand it to the transport in a single call.
+  * Frames that fit into the transmit buffer are assembled there, longer ones are
+  * passed as a segment list so the content is never copied.
+  */
+ static int OpenEPT_ED_SendAsciiFrame(OpenEPT_ED_Context* ctx, uint8_t type, const uint8_t* content, uint32_t contentSize)
+ {
+     OpenEPT_ED_Segment segments[3];
+     uint8_t header[2];
+ 
+     header[0] = (uint8_t)('0' + type);
+     header[1] = ':';
+     if(contentSize + 3 <= OPENEPT_CONF_TRANSMIT_BUFFER_SIZE)
+     {
+         ctx->transmitBuffer[0] = header[0];
+         ctx->transmitBuffer[1] = header[1];
+         memcpy(&ctx->transmitBuffer[2], content, contentSize);
+         ctx->transmitBuffer[contentSize + 2] = OPENEPT_MSG_TERMINATOR[0];
+         if(ctx->ops->sendBuffer(ctx->arg, ctx->transmitBuffer, contentSize + 3) != 0) return OPEN_EPT_STATUS_ERROR;
+         return OPEN_EPT_STATUS_OK;
+     }
+ 
+     segments[0].data = header;
+     segments[0].size = 2;
+     segments[1].data = content;
+     segments[1].size = contentSize;
+     segments[2].data = OPENEPT_MSG_TERMINATOR;
+     segments[2].size = 1;
+     if(OpenEPT_ED_TransportSendSegments(ctx, segments, 3) != 0) return OPEN_EPT_STATUS_ERROR;
+     return OPEN_EPT_STATUS_OK;
+ }
+ 
+ /*
+  * Store record with a single varint payload. Returns record size.
+  */
+ static uint32_t OpenEPT_ED_PutVarintRecord(uint8_t* record, uint8_t type, uint32_t value)
+ {
+     uint32_t size = OpenEPT_ED_Protocol_PutVarint(&record[2], value);
+     record[0] = type;
+     record[1] = (uint8_t)size;
+     return size + 2;
+ }
+ 
+ /*
+  * Send dropped frame count as a frame of its own. With discard set, the oldest queued
+  * frames are discarded to make room for it.
+  */
+ static int OpenEPT_ED_SendDropped(OpenEPT_ED_Context* ctx, uint8_t discard)
+ {
+     uint8_t frame[OPENEPT_DROPPED_FRAME_SIZE];
+     uint32_t size;
+ 
+     for(;;)
+     {
+         size = OpenEPT_ED_EncodeFrame(frame, OpenEPT_ED_PutVarintRecord(&frame[1], OPENEPT_ED_RECORD_DROPPED, ctx->dropped));
+         if(!discard || ctx->ops->txSpace == NULL || ctx->ops->txSpace(ctx->arg) >= size) break;
+         //Only data that is already being transmitted is left, count goes with the next event
+         if(ctx->ops->txDiscard == NULL || ctx->ops->txDiscard(ctx->arg) != 0) return OPEN_EPT_STATUS_ERROR;
+         ctx->dropped += 1;
+     }
+     //Not protected, a later count replaces it
+     if(ctx->ops->sendBuffer(ctx->arg, frame, size) != 0) return OPEN_EPT_STATUS_ERROR;
+     ctx->droppedReported = ctx->dropped;
+     return OPEN_EPT_STATUS_OK;
+ }
+ 
+ /*
+  * Hand event frame to the transport according to overflow policy. Frames that are not
+  * accepted are counted as dropped.
+  */
+ static int OpenEPT_ED_QueueEventFrame(OpenEPT_ED_Context* ctx, const uint8_t* buffer, uint32_t size)
+ {
+     uint8_t accepted = 1;
+ 
+     //Transports that do not report free space always wait
+     while(ctx->ops->txSpace != NULL && ctx->ops->txSpace(ctx->arg) < size)
+     {
+         if(ctx->overflowPolicy == OPENEPT_ED_OVERFLOW_BLOCK) break;
+         if(ctx->overflowPolicy != OPENEPT_ED_OVERFLOW_DROP_OLDEST)
+         {
+             accepted = 0;
+             break;
+         }
+         //Only data that is already being transmitted is left, wait for it
+         if(ctx->ops->txDiscard == NULL || ctx->ops->txDiscard(ctx->arg) != 0) break;
+         ctx->dropped += 1;
+     }
+     if(accepted && ctx->ops->sendBuffer(ctx->arg, buffer, size) == 0) return OPEN_EPT_STATUS_OK;
+     ctx->dropped += 1;
+     if(ctx->overflowPolicy == OPENEPT_ED_OVERFLOW_MARK) OpenEPT_ED_SendDropped(ctx, 1);
+     return OPEN_EPT_STATUS_ERROR;
+ }
+ 
+ /*
+  * Send record as binary frame. Payload is prefix (at most 2 * OPENEPT_ED_PROTOCOL_VARINT_MAX_SIZE bytes)
+  * followed by content. Content that does not fit into the transmit buffer is split over several
+  * frames, all but the last marked with OPENEPT_ED_RECORD_CONTINUED. Header records (at most
+  * OPENEPT_EVENT_HEADER_SIZE bytes) go into the first frame. Event frames are subject to the
+  * overflow policy.
+  */
+ static int OpenEPT_ED_SendBinaryFrame(OpenEPT_ED_Context* ctx, uint8_t event, const uint8_t* header, uint32_t headerSize, uint8_t type, const uint8_t* prefix, uint32_t prefixSize, const uint8_t* content, uint32_t contentSize)
+ {
+     //Record type, size varint (at most 2 bytes for a frame) and CRC
+     const uint32_t maxChunk = OPENEPT_BINARY_RAW_SIZE - 5;
+     uint32_t chunk;
+     uint32_t size;
+     int result;
+ 
      do
      {
-         //Send ping message
-         cntSend = 0;
-         cntRec = 0;
+         chunk = contentSize > maxChunk - headerSize - prefixSize ? maxChunk - headerSize - prefixSize : contentSize;
+         size = OpenEPT_ED_BuildRecordFrame(ctx->transmitBuffer, header, headerSize, (uint8_t)(type | (chunk < contentSize ? OPENEPT_ED_RECORD_CONTINUED : 0)), prefix, prefixSize, content, chunk);
+         result = event ? OpenEPT_ED_QueueEventFrame(ctx, ctx->transmitBuffer, size) : OpenEPT_ED_TransportSendProtected(ctx, ctx->transmitBuffer, size);
+         if(result != 0) return OPEN_EPT_STATUS_ERROR;
+         headerSize = 0;
+         prefixSize = 0;
+         content += chunk;
+         contentSize -= chunk;
+     }while(contentSize > 0);
+     return OPEN_EPT_STATUS_OK;
+ }
+ 
+ /*
+  * Store event timestamp as timestamp record. Returns record size, 0 if events of the current
+  * session are not timestamped.
+  */
+ static uint32_t OpenEPT_ED_Timestamp(OpenEPT_ED_Context* ctx, uint8_t* record, uint64_t timestamp)
+ {
+     uint32_t size;
+     if(ctx->timebase == 0) return 0;
+     size = OpenEPT_ED_Protocol_PutVarint64(&record[2], timestamp);
+     record[0] = OPENEPT_ED_RECORD_TIMESTAMP;
+     record[1] = (uint8_t)size;
+     return size + 2;
+ }
+ 
+ /*
+  * Build header records of the event: dropped frame count when it changed since last
+  * reported, sequence number and timestamp. Returns header size.
+  */
+ static uint32_t OpenEPT_ED_EventHeader(OpenEPT_ED_Context* ctx, uint8_t* header, uint64_t time)
+ {
+     uint8_t timestamp[OPENEPT_TIMESTAMP_RECORD_SIZE];
+     uint32_t timestampSize = OpenEPT_ED_Timestamp(ctx, timestamp, time);
+     uint32_t size = 0;
+ 
+     if(ctx->dropped != ctx->droppedReported)
+     {
+         size += OpenEPT_ED_PutVarintRecord(&header[size], OPENEPT_ED_RECORD_DROPPED, ctx->dropped);
+         //Frame carrying it may be dropped too, that changes the count and it is reported again
+         ctx->droppedReported = ctx->dropped;
+     }
+ #if OPENEPT_CONF_EVENT_SEQUENCE == 1
+     size += OpenEPT_ED_PutVarintRecord(&header[size], OPENEPT_ED_RECORD_SEQUENCE, ctx->sequence++);
+ #endif
+     if(timestampSize != 0) memcpy(&header[size], timestamp, timestampSize);
+     return size + timestampSize;
+ }
+ 
+ /*
+  * Send dropped frame count and sequence number the next event would get, so Acquisition
+  * device also knows about events lost at the end of the session.
+  */
+ static int OpenEPT_ED_SendSessionEnd(OpenEPT_ED_Context* ctx)
+ {
+     uint8_t frame[OPENEPT_EVENT_HEADER_SIZE + 4];
+     uint32_t size;
+ 
+     size = OpenEPT_ED_PutVarintRecord(&frame[1], OPENEPT_ED_RECORD_DROPPED, ctx->dropped);
+ #if OPENEPT_CONF_EVENT_SEQUENCE == 1
+     size += OpenEPT_ED_PutVarintRecord(&frame[1 + size], OPENEPT_ED_RECORD_SEQUENCE, ctx->sequence);
+ #endif
+     ctx->droppedReported = ctx->dropped;
+     size = OpenEPT_ED_EncodeFrame(frame, size);
+     return OpenEPT_ED_TransportSendProtected(ctx, frame, size);
+ }
+ 
+ /*
+  * Send batched records as one frame. Batch is emptied even if sending fails.
+  */
+ static int OpenEPT_ED_BatchSend(OpenEPT_ED_Context* ctx)
+ {
+     uint32_t size;
+     if(ctx->batchUsed == 0) return OPEN_EPT_STATUS_OK;
+     size = OpenEPT_ED_EncodeFrame(ctx->batch, ctx->batchUsed);
+     ctx->batchUsed = 0;
+     return OpenEPT_ED_QueueEventFrame(ctx, ctx->batch, size);
+ }
+ 
+ static int OpenEPT_ED_BatchExpired(OpenEPT_ED_Context* ctx)
+ {
+     if(ctx->batchUsed == 0 || ctx->batchAgeMs == 0) return 0;
+     return ctx->ops->getTickMs(ctx->arg) - ctx->batchTick >= ctx->batchAgeMs;
+ }
+ 
+ /*
+  * Add event to the batch, header records first. Batch is sent when the event does not fit,
+  * when it is full and when the oldest event is too old.
+  */
+ static int OpenEPT_ED_BatchEvent(OpenEPT_ED_Context* ctx, const uint8_t* header, uint32_t headerSize, uint8_t type, const uint8_t* prefix, uint32_t prefixSize, const uint8_t* content, uint32_t contentSize)
+ {
+     uint32_t size = headerSize + 1 + (prefixSize + contentSize < 0x80 ? 1 : 2) + prefixSize + contentSize;
+     int result = OPEN_EPT_STATUS_OK;
+ 
+     //Event larger than a batch follows the batched ones in its own frame
+     if(size > ctx->batchSize)
+     {
+         if(OpenEPT_ED_BatchSend(ctx) != 0) result = OPEN_EPT_STATUS_ERROR;
+         if(OpenEPT_ED_SendBinaryFrame(ctx, 1, header, headerSize, type, prefix, prefixSize, content, contentSize) != 0) result = OPEN_EPT_STATUS_ERROR;
+         return result;
+     }
+     if(ctx->batchUsed + size > ctx->batchSize && OpenEPT_ED_BatchSend(ctx) != 0) result = OPEN_EPT_STATUS_ERROR;
+     if(ctx->batchUsed == 0) ctx->batchTick = ctx->ops->getTickMs(ctx->arg);
+     if(headerSize != 0) memcpy(&ctx->batch[1 + ctx->batchUsed], header, headerSize);
+     ctx->batchUsed += headerSize;
+     ctx->batchUsed += OpenEPT_ED_PutRecord(&ctx->batch[1 + ctx->batchUsed], type, prefix, prefixSize, content, contentSize);
+     if((ctx->batchUsed == ctx->batchSize || OpenEPT_ED_BatchExpired(ctx)) && OpenEPT_ED_BatchSend(ctx) != 0) result = OPEN_EPT_STATUS_ERROR;
+     return result;
+ }
+ 
+ /*
+  * Send event record of binary session, preceded by the event header records. May be batched.
+  */
+ static int OpenEPT_ED_SendBinaryEvent(OpenEPT_ED_Context* ctx, uint64_t timestamp, uint8_t type, const uint8_t* prefix, uint32_t prefixSize, const uint8_t* content, uint32_t contentSize)
+ {
+     uint8_t header[OPENEPT_EVENT_HEADER_SIZE];
+     uint32_t headerSize = OpenEPT_ED_EventHeader(ctx, header, timestamp);
+ 
+     if(ctx->batchSize != 0) return OpenEPT_ED_BatchEvent(ctx, header, headerSize, type, prefix, prefixSize, content, contentSize);
+     return OpenEPT_ED_SendBinaryFrame(ctx, 1, header, headerSize, type, prefix, prefixSize, content, contentSize);
+ }
+ 
+ /*
+  * Copy event into a queue slot. ASCII session events keep only the frame content.
+  */
+ static void OpenEPT_ED_SlotFill(OpenEPT_ED_Context* ctx, OpenEPT_ED_RingSlot* slot, uint64_t timestamp, uint8_t type, const uint8_t* prefix, uint32_t prefixSize, const uint8_t* content, uint32_t contentSize)
+ {
+     slot->timestamp = timestamp;
+     slot->type = type;
+     slot->ascii = ctx->protocol == 0;
+     slot->prefixSize = (uint8_t)(slot->ascii ? 0 : prefixSize);
+     slot->size = (uint8_t)(slot->prefixSize + contentSize);
+     if(slot->prefixSize != 0) memcpy(slot->data, prefix, prefixSize);
+     if(contentSize != 0) memcpy(&slot->data[slot->prefixSize], content, contentSize);
+ }
+ 
+ static int OpenEPT_ED_SlotSend(OpenEPT_ED_Context* ctx, const OpenEPT_ED_RingSlot* slot)
+ {
+     if(slot->ascii) return OpenEPT_ED_SendAsciiFrame(ctx, slot->type, slot->data, slot->size);
+     //Events queued in a session that ended meanwhile are not sent
+     if(ctx->protocol == 0) return OPEN_EPT_STATUS_OK;
+     return OpenEPT_ED_SendBinaryEvent(ctx, slot->timestamp, slot->type, slot->data, slot->prefixSize, &slot->data[slot->prefixSize], slot->size - slot->prefixSize);
+ }
+ 
+ /*
+  * Count events that did not fit into a queue as dropped frames. They skip sequence
+  * numbers, so Acquisition device sees the gap.
+  */
+ static void OpenEPT_ED_CountMissed(OpenEPT_ED_Context* ctx, uint32_t missed)
+ {
+     if(missed == 0 || ctx->protocol == 0) return;
+     ctx->dropped += missed;
+     ctx->sequence += missed;
+ }
+ 
+ #if OPENEPT_CONF_EVENT_RING_SLOTS != 0
  
-         //Send Config message header
-         if(OpenEPT_ED_Platform_Send('0') != 0) return OPEN_EPT_STATUS_ERROR;
-         if(OpenEPT_ED_Platform_Send(':') != 0) return OPEN_EPT_STATUS_ERROR;
-         
-         //Send Config message content
-         while(cntSend < OPENEPT_START_MSG_SIZE)
+ /*
+  * Event ring: bounded MPSC queue where every slot carries its own sequence. Producers in
+  * any context reserve a position with compare-and-swap on ringHead, fill the slot and
+  * publish it by storing position + 1 to its sequence, then ask for a drain (drainRequest).
+  * They never touch the transport, so an interrupt does not wait for it. The context
+  * holding ringLock (OpenEPT_ED_Lock: poll, flush and control functions) sends published
+  * slots in position order and frees them by advancing sequence a lap, so a frame is never
+  * interleaved with another.
+  */
+ static uint8_t OpenEPT_ED_TryLock(OpenEPT_ED_Context* ctx)
+ {
+     uint32_t expected = 0;
+     return __atomic_compare_exchange_n(&ctx->ringLock, &expected, 1, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED);
+ }
+ 
+ /*
+  * Send published events in position order, caller holds ringLock. Only positions reserved
+  * before the call are sent, so busy producers can not keep it running.
+  */
+ static int OpenEPT_ED_RingSend(OpenEPT_ED_Context* ctx)
+ {
+     OpenEPT_ED_RingSlot* slot;
+     uint32_t tail = ctx->ringTail;
+     uint32_t head = __atomic_load_n(&ctx->ringHead, __ATOMIC_RELAXED);
+     int result = OPEN_EPT_STATUS_OK;
+ 
+     OpenEPT_ED_CountMissed(ctx, __atomic_exchange_n(&ctx->ringDropped, 0, __ATOMIC_RELAXED));
+     while(tail != head)
+     {
+         slot = &ctx->ring[tail % OPENEPT_CONF_EVENT_RING_SLOTS];
+         if(__atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE) != tail + 1) break;
+         if(OpenEPT_ED_SlotSend(ctx, slot) != OPEN_EPT_STATUS_OK) result = OPEN_EPT_STATUS_ERROR;
+         tail += 1;
+         __atomic_store_n(&slot->sequence, tail - 1 + OPENEPT_CONF_EVENT_RING_SLOTS, __ATOMIC_RELEASE);
+         __atomic_store_n(&ctx->ringTail, tail, __ATOMIC_RELAXED);
+     }
+     return result;
+ }
+ 
+ static int OpenEPT_ED_RingPut(OpenEPT_ED_Context* ctx, uint64_t timestamp, uint8_t type, const uint8_t* prefix, uint32_t prefixSize, const uint8_t* content, uint32_t contentSize)
+ {
+     OpenEPT_ED_RingSlot* slot;
+     uint32_t position = __atomic_load_n(&ctx->ringHead, __ATOMIC_RELAXED);
+     int32_t lap;
+ 
+     if(prefixSize + contentSize > OPENEPT_CONF_EVENT_RING_SLOT_SIZE)
+     {
+         __atomic_fetch_add(&ctx->ringDropped, 1, __ATOMIC_RELAXED);
+         return OPEN_EPT_STATUS_ERROR;
+     }
+     for(;;)
+     {
+         slot = &ctx->ring[position % OPENEPT_CONF_EVENT_RING_SLOTS];
+         lap = (int32_t)(__atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE) - position);
+         if(lap == 0)
          {
-             if(OpenEPT_ED_Platform_Send((char)OPENEPT_START_MSG[cntSend]) != 0) return OPEN_EPT_STATUS_ERROR;
-             cntSend += 1;
+             //Failed exchange loads the new head into position
+             if(__atomic_compare_exchange_n(&ctx->ringHead, &position, position + 1, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) break;
          }
-         
-         //Wait for response
-         do
+         else if(lap < 0)
          {
-             if(OpenEPT_ED_Platform_Read(&data) != OPEN_EPT_STATUS_OK) break;
-             OPENEPT_RECEIVE_BUFFER[cntRec] = data;
-             cntRec += 1;
-         }while(data != '\r');
- 
-         if(data == '\r')
+             //Ring is full, slot of this position is still waiting to be sent
+             __atomic_fetch_add(&ctx->ringDropped, 1, __ATOMIC_RELAXED);
+             return OPEN_EPT_STATUS_ERROR;
+         }
+         else
          {
-             //Check is received response OK\r 
-             if(strncmp((const char*)OPENEPT_RECEIVE_BUFFER, "OK\r", 3) != 0)
-             {
-                 memset(OPENEPT_RECEIVE_BUFFER, 0, OPENEPT_CONF_RECEIVE_BUFFER_SIZE);
-                 pingResend = 0;
-             }
-             else
-             {
-                 memset(OPENEPT_RECEIVE_BUFFER, 0, OPENEPT_CONF_RECEIVE_BUFFER_SIZE);
-                 return OPEN_EPT_STATUS_OK;
-             }
+             position = __atomic_load_n(&ctx->ringHead, __ATOMIC_RELAXED);
          }
- 
-     }while(pingResend == 1);
-        
-     return OPEN_EPT_STATUS_ERROR;
+     }
+     OpenEPT_ED_SlotFill(ctx, slot, timestamp, type, prefix, prefixSize, content, contentSize);
+     __atomic_store_n(&slot->sequence, position + 1, __ATOMIC_RELEASE);
+     if(ctx->ops->drainRequest != NULL) ctx->ops->drainRequest(ctx->arg);
+     return OPEN_EPT_STATUS_OK;
  }
  
+ #endif
  
- int OpenEPT_ED_Stop()
+ #if OPENEPT_CONF_THREAD_BUFFERS != 0
+ 
+ /*
+  * Thread buffers: SPSC queue per attached thread. The owner thread fills the slot at head
+  * and publishes it by advancing head; the thread that drains the context sends the slot
+  * at tail and frees it by advancing tail. Producers share nothing, so they never contend.
+  */
+ static int OpenEPT_ED_ThreadPut(OpenEPT_ED_Context* ctx, OpenEPT_ED_ThreadBuffer* buffer, uint64_t timestamp, uint8_t type, const uint8_t* prefix, uint32_t prefixSize, const uint8_t* content, uint32_t contentSize)
  {
-     uint32_t cntSend;
-     uint32_t cntRec;
-     char data = 0;
-     uint8_t pingResend = 1;
-     do
+     uint32_t head = buffer->head;
+ 
+     if(prefixSize + contentSize > OPENEPT_CONF_EVENT_RING_SLOT_SIZE || head - __atomic_load_n(&buffer->tail, __ATOMIC_ACQUIRE) >= OPENEPT_CONF_THREAD_BUFFER_SLOTS)
+     {
+         __atomic_store_n(&buffer->dropped, buffer->dropped + 1, __ATOMIC_RELAXED);
+         return OPEN_EPT_STATUS_ERROR;
+     }
+     OpenEPT_ED_SlotFill(ctx, &buffer->slots[head % OPENEPT_CONF_THREAD_BUFFER_SLOTS], timestamp, type, prefix, prefixSize, content, contentSize);
+     __atomic_store_n(&buffer->head, head + 1, __ATOMIC_RELEASE);
+     if(ctx->ops->drainRequest != NULL) ctx->ops->drainRequest(ctx->arg);
+     return OPEN_EPT_STATUS_OK;
+ }
+ 
+ /*
+  * Restore min-heap order of thread buffer indices from position down. Key of a buffer is
+  * the timestamp of its oldest event not sent yet.
+  */
+ static void OpenEPT_ED_ThreadSiftDown(uint32_t* heap, const uint64_t* keys, uint32_t size, uint32_t position)
+ {
+     uint32_t index = heap[position];
+     uint32_t child;
+ 
+     while((child = 2 * position + 1) < size)
      {
-         //Send ping message
-         cntSend = 0;
-         cntRec = 0;
+         if(child + 1 < size && keys[heap[child + 1]] < keys[heap[child]]) child++;
+         if(keys[heap[child]] >= keys[index]) break;
+         heap[position] = heap[child];
+         position = child;
+     }
+     heap[position] = index;
+ }
+ 
+ /*
+  * Send events queued in thread buffers so far, merged by timestamp (oldest first). Buffers
+  * with events are kept in a min-heap, so picking the next event costs log2 of the number
+  * of buffers. Events queued while merging wait for the next call, so busy threads do not
+  * keep it running.
+  */
+ static int OpenEPT_ED_ThreadSend(OpenEPT_ED_Context* ctx)
+ {
+     OpenEPT_ED_ThreadBuffer* buffers[OPENEPT_CONF_THREAD_BUFFERS];
+     uint32_t heads[OPENEPT_CONF_THREAD_BUFFERS];
+     uint64_t keys[OPENEPT_CONF_THREAD_BUFFERS];
+     uint32_t heap[OPENEPT_CONF_THREAD_BUFFERS];
+     uint32_t count = __atomic_load_n(&ctx->threadCount, __ATOMIC_ACQUIRE);
+     OpenEPT_ED_ThreadBuffer* buffer;
+     uint32_t dropped;
+     uint32_t size = 0;
+     uint32_t tail;
+     uint32_t cnt;
+     int result = OPEN_EPT_STATUS_OK;
  
-         //Send Config message header
-         if(OpenEPT_ED_Platform_Send('0') != 0) return OPEN_EPT_STATUS_ERROR;
-         if(OpenEPT_ED_Platform_Send(':') != 0) return OPEN_EPT_STATUS_ERROR;
-         
-         //Send Config message content
-         while(cntSend < OPENEPT_STOP_MSG_SIZE)
+     for(cnt = 0; cnt < count; cnt++)
+     {
+         buffer = __atomic_load_n(&ctx->threads[cnt], __ATOMIC_ACQUIRE);
+         //Buffer of a thread that is still attaching is drained next time
+         if(buffer == NULL) continue;
+         buffers[cnt] = buffer;
+         heads[cnt] = __atomic_load_n(&buffer->head, __ATOMIC_ACQUIRE);
+         dropped = __atomic_load_n(&buffer->dropped, __ATOMIC_RELAXED);
+         OpenEPT_ED_CountMissed(ctx, dropped - buffer->droppedReported);
+         buffer->droppedReported = dropped;
+         if(buffer->tail == heads[cnt]) continue;
+         keys[cnt] = buffer->slots[buffer->tail % OPENEPT_CONF_THREAD_BUFFER_SLOTS].timestamp;
+         heap[size++] = cnt;
+     }
+     for(cnt = size / 2; cnt-- > 0;) OpenEPT_ED_ThreadSiftDown(heap, keys, size, cnt);
+     while(size != 0)
+     {
+         buffer = buffers[heap[0]];
+         tail = buffer->tail;
+         if(OpenEPT_ED_SlotSend(ctx, &buffer->slots[tail % OPENEPT_CONF_THREAD_BUFFER_SLOTS]) != OPEN_EPT_STATUS_OK) result = OPEN_EPT_STATUS_ERROR;
+         __atomic_store_n(&buffer->tail, tail + 1, __ATOMIC_RELEASE);
+         if(tail + 1 == heads[heap[0]])
          {
-             if(OpenEPT_ED_Platform_Send((char)OPENEPT_STOP_MSG[cntSend]) != 0) return OPEN_EPT_STATUS_ERROR;
-             cntSend += 1;
+             heap[0] = heap[--size];
          }
-         
-         //Wait for response
-         do
+         else
          {
-             if(OpenEPT_ED_Platform_Read(&data) != OPEN_EPT_STATUS_OK) break;
-             OPENEPT_RECEIVE_BUFFER[cntRec] = data;
-             cntRec += 1;
-         }while(data != '\r');
+             keys[heap[0]] = buffer->slots[(tail + 1) % OPENEPT_CONF_THREAD_BUFFER_SLOTS].timestamp;
+         }
+         if(size != 0) OpenEPT_ED_ThreadSiftDown(heap, keys, size, 0);
+     }
+     return result;
+ }
+ 
+ #endif
+ 
+ /*
+  * Take the transport for operations that use it outside of events and send events queued
+  * so far, so they precede what the operation sends. With the event ring, a thread that
+  * finds another one holding the transport yields (OpenEPT_ED_Platform_Yield) and gives up
+  * after OPENEPT_CONF_LOCK_TIMEOUT_MS; transports with a lock operation never wait here.
+  * Not taken from interrupts.
+  *
+  * Returns OPEN_EPT_STATUS_TIMEOUT without the transport, then there is nothing to unlock.
+  */
+ static int OpenEPT_ED_Lock(OpenEPT_ED_Context* ctx)
+ {
+     int result = OPEN_EPT_STATUS_OK;
+ #if OPENEPT_CONF_EVENT_RING_SLOTS != 0
+     uint32_t start;
+ #endif
  
-         if(data == '\r')
+     if(ctx->ops->lock != NULL) ctx->ops->lock(ctx->arg);
+ #if OPENEPT_CONF_EVENT_RING_SLOTS != 0
+     start = ctx->ops->getTickMs(ctx->arg);
+     while(!OpenEPT_ED_TryLock(ctx))
+     {
+         if(ctx->ops->getTickMs(ctx->arg) - start >= OPENEPT_CONF_LOCK_TIMEOUT_MS)
          {
-             //Check is received response OK\r 
-             if(strncmp((const char*)OPENEPT_RECEIVE_BUFFER, "OK\r", 3) != 0)
-             {
-                 memset(OPENEPT_RECEIVE_BUFFER, 0, OPENEPT_CONF_RECEIVE_BUFFER_SIZE);
-                 pingResend = 0;
-             }
-             else
-             {
-                 memset(OPENEPT_RECEIVE_BUFFER, 0, OPENEPT_CONF_RECEIVE_BUFFER_SIZE);
-                 return OPEN_EPT_STATUS_OK;
-             }
+             if(ctx->ops->unlock != NULL) ctx->ops->unlock(ctx->arg);
+             return OPEN_EPT_STATUS_TIMEOUT;
          }
+         OpenEPT_ED_Platform_Yield();
+     }
+     result = OpenEPT_ED_RingSend(ctx);
+ #endif
+     OpenEPT_ED_CountMissed(ctx, __atomic_exchange_n(&ctx->queueDropped, 0, __ATOMIC_RELAXED));
+ #if OPENEPT_CONF_THREAD_BUFFERS != 0
+     if(OpenEPT_ED_ThreadSend(ctx) != OPEN_EPT_STATUS_OK) result = OPEN_EPT_STATUS_ERROR;
+ #endif
+     return result;
+ }
+ 
+ static int OpenEPT_ED_Unlock(OpenEPT_ED_Context* ctx)
+ {
+     int result = OPEN_EPT_STATUS_OK;
+ 
+ #if OPENEPT_CONF_EVENT_RING_SLOTS != 0
+     //Events published while it was held go out before it is released
+     result = OpenEPT_ED_RingSend(ctx);
+     __atomic_store_n(&ctx->ringLock, 0, __ATOMIC_RELEASE);
+ #endif
+     if(ctx->ops->unlock != NULL) ctx->ops->unlock(ctx->arg);
+     return result;
+ }
+ 
+ /*
+  * Hand event to the transport queue, it comes back through OpenEPT_ED_Ctx_SendQueued.
+  * Events that do not fit into a slot or the queue are counted as dropped when the
+  * transport is taken next.
+  */
+ static int OpenEPT_ED_QueueEvent(OpenEPT_ED_Context* ctx, uint64_t timestamp, uint8_t type, const uint8_t* prefix, uint32_t prefixSize, const uint8_t* content, uint32_t contentSize)
+ {
+     OpenEPT_ED_RingSlot slot;
  
-     }while(pingResend == 1);
-        
+     if(prefixSize + contentSize <= OPENEPT_CONF_EVENT_RING_SLOT_SIZE)
+     {
+         OpenEPT_ED_SlotFill(ctx, &slot, timestamp, type, prefix, prefixSize, content, contentSize);
+         if(ctx->ops->queueEvent(ctx->arg, &slot) == 0) return OPEN_EPT_STATUS_OK;
+     }
+     __atomic_fetch_add(&ctx->queueDropped, 1, __ATOMIC_RELAXED);
      return OPEN_EPT_STATUS_ERROR;
  }
  
+ /*
+  * Send event. Timestamp is taken before anything is sent. Events of a thread with its own
+  * buffer wait there for the drain, a transport with queueEvent gets them for its sending
+  * task, with the event ring the event is queued and sent by whichever context holds the
+  * transport.
+  */
+ static int OpenEPT_ED_SendEvent(OpenEPT_ED_Context* ctx, uint8_t type, const uint8_t* prefix, uint32_t prefixSize, const uint8_t* content, uint32_t contentSize)
+ {
+     uint64_t timestamp = ctx->timebase != 0 ? ctx->ops->getTimestamp(ctx->arg) : 0;
+ #if OPENEPT_CONF_THREAD_BUFFERS != 0
+     OpenEPT_ED_ThreadBuffer* buffer = (OpenEPT_ED_ThreadBuffer*)OpenEPT_ED_Platform_GetThreadBuffer();
+ 
+     if(buffer != NULL && buffer->ctx == ctx) return OpenEPT_ED_ThreadPut(ctx, buffer, timestamp, type, prefix, prefixSize, content, contentSize);
+ #endif
+ 
+     if(ctx->ops->queueEvent != NULL) return OpenEPT_ED_QueueEvent(ctx, timestamp, type, prefix, prefixSize, content, contentSize);
+ #if OPENEPT_CONF_EVENT_RING_SLOTS != 0
+     return OpenEPT_ED_RingPut(ctx, timestamp, type, prefix, prefixSize, content, contentSize);
+ #else
+     if(ctx->protocol == 0) return OpenEPT_ED_SendAsciiFrame(ctx, type, content, contentSize);
+     return OpenEPT_ED_SendBinaryEvent(ctx, timestamp, type, prefix, prefixSize, content, contentSize);
+ #endif
+ }
+ 
+ /*
+  * Send EP definition record "<varint id><name>" so Acquisition device can expand EP ID records.
+  */
+ static int OpenEPT_ED_SendDefinition(OpenEPT_ED_Context* ctx, uint32_t epId)
+ {
+     uint8_t prefix[OPENEPT_ED_PROTOCOL_VARINT_MAX_SIZE];
+     uint32_t prefixSize = OpenEPT_ED_Protocol_PutVarint(prefix, epId);
+     return OpenEPT_ED_SendBinaryFrame(ctx, 0, NULL, 0, OPENEPT_ED_RECORD_EP_DEFINE, prefix, prefixSize, ctx->dictionary[epId].data, ctx->dictionary[epId].size);
+ }
  
- int OpenEPT_ED_SetEPFast(uint8_t* epName, uint32_t epNameSize)
+ /*
+  * Send whole EP dictionary, done once per session right after START.
+  */
+ static int OpenEPT_ED_SendDictionary(OpenEPT_ED_Context* ctx)
  {
-     if(OpenEPT_ED_Platform_SyncToogle() != 0) return OPEN_EPT_STATUS_ERROR;
-     uint32_t cnt = 0;
-     //Send EP message header
-     if(OpenEPT_ED_Platform_Send('1') != 0) return OPEN_EPT_STATUS_ERROR;
-     if(OpenEPT_ED_Platform_Send(':') != 0) return OPEN_EPT_STATUS_ERROR;
-     
-     //Send EP message content
-     while(cnt < epNameSize)
+     uint32_t cnt;
+     for(cnt = 0; cnt < ctx->dictionarySize; cnt++)
      {
-         if(OpenEPT_ED_Platform_Send((char)epName[cnt]) != 0) return OPEN_EPT_STATUS_ERROR;
-         cnt++;
+         if(OpenEPT_ED_SendDefinition(ctx, cnt) != OPEN_EPT_STATUS_OK) return OPEN_EPT_STATUS_ERROR;
      }
-     if(OpenEPT_ED_Platform_Send('\r') != 0) return OPEN_EPT_STATUS_ERROR;
      return OPEN_EPT_STATUS_OK;
+ }
+ 
+ 
+ 
+ int OpenEPT_ED_Ctx_Init(OpenEPT_ED_Context* ctx, const OpenEPT_ED_TransportOps* ops, void* arg)
+ {
+ #if OPENEPT_CONF_EVENT_RING_SLOTS != 0
+     uint32_t cnt;
+ #endif
+ 
+     if(ctx == NULL || ops == NULL || ops->sendBuffer == NULL || ops->getTickMs == NULL) return OPEN_EPT_STATUS_ERROR;
+     if(ops->init != NULL && ops->init(arg) != 0) return OPEN_EPT_STATUS_ERROR;
+     memset(ctx, 0, sizeof(OpenEPT_ED_Context));
+     ctx->ops = ops;
+     ctx->arg = arg;
+     ctx->handshake.state = OPENEPT_ED_HANDSHAKE_IDLE;
+     ctx->handshake.result = OPEN_EPT_STATUS_OK;
+     ctx->handshake.retries = OPENEPT_CONF_HANDSHAKE_RETRIES;
+     ctx->handshake.timeoutMs = OPENEPT_CONF_HANDSHAKE_TIMEOUT_MS;
+     ctx->handshake.backoffMs = OPENEPT_CONF_HANDSHAKE_BACKOFF_MS;
+     ctx->batchSize = OPENEPT_CONF_BATCH_SIZE < OPENEPT_CONF_BATCH_BUFFER_SIZE ? OPENEPT_CONF_BATCH_SIZE : OPENEPT_CONF_BATCH_BUFFER_SIZE;
+     ctx->batchAgeMs = OPENEPT_CONF_BATCH_AGE_MS;
+     ctx->overflowPolicy = OPENEPT_CONF_OVERFLOW_POLICY;
+     ctx->clock.periodMs = OPENEPT_CONF_CLOCK_PERIOD_MS;
+ #if OPENEPT_CONF_EVENT_RING_SLOTS != 0
+     //Slot is free for the position it is used at first
+     for(cnt = 0; cnt < OPENEPT_CONF_EVENT_RING_SLOTS; cnt++) ctx->ring[cnt].sequence = cnt;
+ #endif
+     OPENEPT_START_NEGOTIATE_MSG_SIZE = OpenEPT_ED_BuildNegotiateMsg();
+     OPENEPT_STOP_BINARY_MSG_SIZE = OpenEPT_ED_BuildRecordFrame(OPENEPT_STOP_BINARY_MSG, NULL, 0, OPENEPT_ED_RECORD_CONTROL, NULL, 0, OPENEPT_STOP_COMMAND, 1);
+     return OPEN_EPT_STATUS_OK;
+ }
+ 
+ int OpenEPT_ED_Ctx_SetTransport(OpenEPT_ED_Context* ctx, const OpenEPT_ED_TransportOps* ops, void* arg)
+ {
+     if(ops == NULL || ops->sendBuffer == NULL || ops->getTickMs == NULL) return OPEN_EPT_STATUS_ERROR;
+     if(ctx->handshake.state != OPENEPT_ED_HANDSHAKE_IDLE) return OPEN_EPT_STATUS_ERROR;
+     ctx->ops = ops;
+     ctx->arg = arg;
+     return OPEN_EPT_STATUS_OK;
+ }
  
+ void OpenEPT_ED_Ctx_SetHandshakePolicy(OpenEPT_ED_Context* ctx, uint32_t retries, uint32_t timeoutMs, uint32_t backoffMs)
+ {
+     ctx->handshake.retries = retries;
+     ctx->handshake.timeoutMs = timeoutMs;
+     ctx->handshake.backoffMs = backoffMs;
  }
  
+ /*
+  * Arm handshake state machine with given control message. Message is sent on the next poll.
+  */
+ static void OpenEPT_ED_HandshakeEnter(OpenEPT_ED_Context* ctx, OpenEPT_ED_HandshakeStage stage, const uint8_t* msg, uint32_t msgSize)
+ {
+     ctx->handshake.stage = stage;
+     ctx->handshake.msg = msg;
+     ctx->handshake.msgSize = msgSize;
+     ctx->handshake.attempt = 0;
+     ctx->handshake.currentBackoffMs = ctx->handshake.backoffMs;
+     ctx->handshake.state = OPENEPT_ED_HANDSHAKE_SEND;
+ }
  
- int OpenEPT_ED_SendInfo(const char* message)
- {    
-     uint32_t cnt = 0;
-     int msgLen = strlen(message);
-     //Send EP message header
-     if(OpenEPT_ED_Platform_Send('2') != 0) return OPEN_EPT_STATUS_ERROR;
-     if(OpenEPT_ED_Platform_Send(':') != 0) return OPEN_EPT_STATUS_ERROR;
-     
-     //Send EP message content
-     while(cnt < msgLen)
-     {
-         if(OpenEPT_ED_Platform_Send((char)message[cnt]) != 0) return OPEN_EPT_STATUS_ERROR;
-         cnt++;
-     }
-     if(OpenEPT_ED_Platform_Send('\r') != 0) return OPEN_EPT_STATUS_ERROR;
+ static int OpenEPT_ED_HandshakeBegin(OpenEPT_ED_Context* ctx, OpenEPT_ED_HandshakeStage stage, const uint8_t* msg, uint32_t msgSize)
+ {
+     if(ctx->handshake.state != OPENEPT_ED_HANDSHAKE_IDLE) return OPEN_EPT_STATUS_ERROR;
+     OpenEPT_ED_HandshakeEnter(ctx, stage, msg, msgSize);
+     ctx->handshake.result = OPEN_EPT_STATUS_PENDING;
      return OPEN_EPT_STATUS_OK;
  }
-
  
+ /*
+  * Send timebase record and enable event timestamps when transport has a timestamp source.
+  */
+ static int OpenEPT_ED_SendTimebase(OpenEPT_ED_Context* ctx)
+ {
+     uint8_t timebase[OPENEPT_ED_PROTOCOL_VARINT_MAX_SIZE];
+     uint32_t frequency;
+ 
+     if(ctx->ops->getTimestamp == NULL || ctx->ops->getTimestampFrequency == NULL) return OPEN_EPT_STATUS_OK;
+     frequency = ctx->ops->getTimestampFrequency(ctx->arg);
+     if(frequency == 0) return OPEN_EPT_STATUS_OK;
+     if(OpenEPT_ED_SendBinaryFrame(ctx, 0, NULL, 0, OPENEPT_ED_RECORD_TIMEBASE, NULL, 0, timebase, OpenEPT_ED_Protocol_PutVarint(timebase, frequency)) != 0) return OPEN_EPT_STATUS_ERROR;
+     ctx->timebase = frequency;
+     return OPEN_EPT_STATUS_OK;
+ }
+ 
+ /*
+  * Convert DUT timestamp to ns, split so that the product can not overflow.
+  */
+ static uint64_t OpenEPT_ED_TimestampNs(OpenEPT_ED_Context* ctx, uint64_t timestamp)
+ {
+     return timestamp / ctx->timebase * 1000000000ull + timestamp % ctx->timebase * 1000000000ull / ctx->timebase;
+ }
+ 
+ static uint8_t OpenEPT_ED_ClockEnabled(OpenEPT_ED_Context* ctx)
+ {
+     //Answers are read in idle state, so transport has to support reads without waiting
+     return ctx->protocol != 0 && ctx->timebase != 0 && ctx->clock.periodMs != 0 && ctx->ops->tryRead != NULL;
+ }
+ 
+ static int OpenEPT_ED_ClockPing(OpenEPT_ED_Context* ctx)
+ {
+     uint8_t timestamp[OPENEPT_ED_PROTOCOL_VARINT64_MAX_SIZE];
+ 
+     ctx->clock.pingTick = ctx->ops->getTickMs(ctx->arg);
+     ctx->clock.pingTime = ctx->ops->getTimestamp(ctx->arg);
+     ctx->clock.pending = 1;
+     return OpenEPT_ED_SendBinaryFrame(ctx, 0, NULL, 0, OPENEPT_ED_RECORD_PING, NULL, 0, timestamp, OpenEPT_ED_Protocol_PutVarint64(timestamp, ctx->clock.pingTime));
+ }
+ 
+ /*
+  * Send clock estimate record.
+  */
+ static int OpenEPT_ED_ClockReport(OpenEPT_ED_Context* ctx)
+ {
+     uint8_t record[OPENEPT_ED_PROTOCOL_VARINT64_MAX_SIZE * 3 + OPENEPT_ED_PROTOCOL_VARINT_MAX_SIZE];
+     uint64_t timestamp = ctx->clock.estimate.timeNs / 1000000000ull * ctx->timebase + ctx->clock.estimate.timeNs % 1000000000ull * ctx->timebase / 1000000000ull;
+     uint32_t size;
+ 
+     size = OpenEPT_ED_Protocol_PutVarint64(record, timestamp);
+     size += OpenEPT_ED_Protocol_PutZigzag64(&record[size], ctx->clock.estimate.offsetNs);
+     size += OpenEPT_ED_Protocol_PutVarint(&record[size], ctx->clock.estimate.rttNs);
+     size += OpenEPT_ED_Protocol_PutZigzag64(&record[size], ctx->clock.driftPpb);
+     return OpenEPT_ED_SendBinaryFrame(ctx, 0, NULL, 0, OPENEPT_ED_RECORD_CLOCK, NULL, 0, record, size);
+ }
  
- 
\ No newline at end of file
+ /*
+  * Take sample from "PONG <DUT timestamp> <receive ns> <send ns>" answer and update estimate.
+  * Answers that do not belong to the pending ping are ignored.
+  */
+ static int OpenEPT_ED_ClockPong(OpenEPT_ED_Context* ctx, uint32_t size)
+ {
+     OpenEPT_ED_ClockSample* sample;
+     uint64_t receiveTime = ctx->ops->getTimestamp(ctx->arg);
+     uint64_t pingTime;
+     uint64_t pingNs;
+     uint64_t pongNs;
+     uint64_t acqReceiveNs;
+     uint64_t acqSendNs;
+     uint64_t elapsedNs;
+     uint32_t pos = 4;
+     uint32_t cnt;
+ 
+     pos = OpenEPT_ED_ParseU64(ctx, pos, size, &pingTime);
+     if(pos != 0) pos = OpenEPT_ED_ParseU64(ctx, pos, size, &acqReceiveNs);
+     if(pos != 0) pos = OpenEPT_ED_ParseU64(ctx, pos, size, &acqSendNs);
+     if(pos == 0 || !ctx->clock.pending || pingTime != ctx->clock.pingTime) return OPEN_EPT_STATUS_OK;
+     ctx->clock.pending = 0;
+ 
+     //NTP on-wire calculation: offset is exact when both link directions take the same time
+     pingNs = OpenEPT_ED_TimestampNs(ctx, pingTime);
+     pongNs = OpenEPT_ED_TimestampNs(ctx, receiveTime);
+     sample = &ctx->clock.samples[ctx->clock.count % OPENEPT_CONF_CLOCK_FILTER];
+     sample->timeNs = pingNs + (pongNs - pingNs) / 2;
+     sample->offsetNs = ((int64_t)(acqReceiveNs - pingNs) + (int64_t)(acqSendNs - pongNs)) / 2;
+     elapsedNs = (pongNs - pingNs) - (acqSendNs - acqReceiveNs);
+     sample->rttNs = (int64_t)elapsedNs < 0 ? 0 : elapsedNs > 0xFFFFFFFFull ? 0xFFFFFFFFu : (uint32_t)elapsedNs;
+     ctx->clock.count += 1;
+ 
+     //Queueing delay only adds to round trip, so the shortest one is the most accurate
+     ctx->clock.estimate = ctx->clock.samples[0];
+     for(cnt = 1; cnt < ctx->clock.count && cnt < OPENEPT_CONF_CLOCK_FILTER; cnt++)
+     {
+         if(ctx->clock.samples[cnt].rttNs < ctx->clock.estimate.rttNs) ctx->clock.estimate = ctx->clock.samples[cnt];
+     }
+     if(ctx->clock.count == OPENEPT_CONF_CLOCK_FILTER) ctx->clock.reference = ctx->clock.estimate;
+     //Each offset is known within half its round trip, drift is taken once that is below 10 ppm of the time between them
+     elapsedNs = ctx->clock.estimate.timeNs - ctx->clock.reference.timeNs;
+     if(ctx->clock.count > OPENEPT_CONF_CLOCK_FILTER && elapsedNs / 1000 > 0 &&
+        elapsedNs / 100000 >= ((uint64_t)ctx->clock.estimate.rttNs + ctx->clock.reference.rttNs) / 2)
+     {
+         //ppb = offset change * 10^9 / elapsed, in us to keep the product in range
+         ctx->clock.driftPpb = (int32_t)((ctx->clock.estimate.offsetNs - ctx->clock.reference.offsetNs) * 1000000 / (int64_t)(elapsedNs / 1000));
+     }
+     return OpenEPT_ED_ClockReport(ctx);
+ }
+ 
+ /*
+  * Read ping answers and send the next ping when it is due. Initial burst sends the next ping
+  * as soon as the previous one is answered.
+  */
+ static int OpenEPT_ED_ClockPoll(OpenEPT_ED_Context* ctx)
+ {
+     uint32_t now;
+     char data;
+ 
+     if(!OpenEPT_ED_ClockEnabled(ctx)) return OPEN_EPT_STATUS_OK;
+     while(OpenEPT_ED_TransportTryRead(ctx, &data) == OPEN_EPT_STATUS_OK)
+     {
+         if(ctx->handshake.received >= OPENEPT_CONF_RECEIVE_BUFFER_SIZE) ctx->handshake.received = 0;
+         ctx->receiveBuffer[ctx->handshake.received++] = (uint8_t)data;
+         if(data != '\r') continue;
+         if(OpenEPT_ED_IsPong(ctx, ctx->handshake.received) && OpenEPT_ED_ClockPong(ctx, ctx->handshake.received) != 0) return OPEN_EPT_STATUS_ERROR;
+         ctx->handshake.received = 0;
+     }
+     now = ctx->ops->getTickMs(ctx->arg);
+     if((ctx->clock.pending || ctx->clock.count >= OPENEPT_CONF_CLOCK_FILTER) && now - ctx->clock.pingTick < ctx->clock.periodMs) return OPEN_EPT_STATUS_OK;
+     return OpenEPT_ED_ClockPing(ctx);
+ }
+ 
+ static int OpenEPT_ED_HandshakeEnd(OpenEPT_ED_Context* ctx, int result)
+ {
+     //Session started, Acquisition device needs timebase and EP names before the first event
+     if(result == OPEN_EPT_STATUS_OK && ctx->handshake.stage != OPENEPT_ED_HANDSHAKE_STAGE_STOP && ctx->protocol != 0)
+     {
+         ctx->sequence = 0;
+         ctx->session += 1;
+         ctx->dropped = 0;
+         ctx->droppedReported = 0;
+         ctx->clock.count = 0;
+         ctx->clock.pending = 0;
+         ctx->clock.driftPpb = 0;
+         result = OpenEPT_ED_SendTimebase(ctx);
+         if(result == OPEN_EPT_STATUS_OK) result = OpenEPT_ED_SendDictionary(ctx);
+         //First exchange goes right after START, before any event
+         if(result == OPEN_EPT_STATUS_OK && OpenEPT_ED_ClockEnabled(ctx)) result = OpenEPT_ED_ClockPing(ctx);
+     }
+     ctx->handshake.received = 0;
+     ctx->handshake.state = OPENEPT_ED_HANDSHAKE_IDLE;
+     ctx->handshake.result = result;
+     return result;
+ }
+ 
+ /*
+  * Switch link to the given baud rate, 0 restores initial rate. Pending data is sent at the old rate first.
+  */
+ static int OpenEPT_ED_SwitchBaudrate(OpenEPT_ED_Context* ctx, uint32_t baudrate)
+ {
+     if(ctx->ops->reconfigure == NULL) return OPEN_EPT_STATUS_ERROR;
+     OpenEPT_ED_TransportFlush(ctx);
+     if(ctx->ops->reconfigure(ctx->arg, baudrate) != 0) return OPEN_EPT_STATUS_ERROR;
+     ctx->handshake.baudrate = baudrate;
+     return OPEN_EPT_STATUS_OK;
+ }
+ 
+ /*
+  * Handle "OK" response. Returns OPEN_EPT_STATUS_PENDING if handshake continues with another exchange.
+  */
+ static int OpenEPT_ED_HandshakeAccepted(OpenEPT_ED_Context* ctx, uint32_t okEnd)
+ {
+     uint32_t baudrate;
+     uint32_t protocol;
+ 
+     switch(ctx->handshake.stage)
+     {
+     case OPENEPT_ED_HANDSHAKE_STAGE_START:
+         protocol = OpenEPT_ED_ParseOption(ctx, okEnd, ctx->handshake.received, "PROTO=");
+         //Frames after START OK use the selected protocol
+         if(protocol != 0 && protocol <= OPENEPT_CONF_PROTOCOL_VERSION) ctx->protocol = (uint8_t)protocol;
+         baudrate = OpenEPT_ED_ParseOption(ctx, okEnd, ctx->handshake.received, "BAUD=");
+         if(baudrate == 0 || baudrate == ctx->handshake.baudrate) return OPEN_EPT_STATUS_OK;
+         //Both sides switch now, confirm with BAUD exchange at the new rate
+         if(OpenEPT_ED_SwitchBaudrate(ctx, baudrate) != OPEN_EPT_STATUS_OK) return OPEN_EPT_STATUS_OK;
+         OpenEPT_ED_HandshakeEnter(ctx, OPENEPT_ED_HANDSHAKE_STAGE_CONFIRM, OPENEPT_BAUD_MSG, OPENEPT_BAUD_MSG_SIZE);
+         return OPEN_EPT_STATUS_PENDING;
+     case OPENEPT_ED_HANDSHAKE_STAGE_STOP:
+         //Session is over, Acquisition device returns to initial rate and ASCII protocol too
+         ctx->protocol = 0;
+         ctx->timebase = 0;
+         //Events set while STOP was pending belong to no session
+         ctx->batchUsed = 0;
+         if(ctx->handshake.baudrate != 0) OpenEPT_ED_SwitchBaudrate(ctx, 0);
+         return OPEN_EPT_STATUS_OK;
+     default:
+         return OPEN_EPT_STATUS_OK;
+     }
+ }
+ 
+ int OpenEPT_ED_Ctx_StartAsync(OpenEPT_ED_Context* ctx)
+ {
+     int result;
+ 
+     if(OpenEPT_ED_Lock(ctx) == OPEN_EPT_STATUS_TIMEOUT) return OPEN_EPT_STATUS_TIMEOUT;
+     if(OPENEPT_START_NEGOTIATE_MSG_SIZE != 0)
+     {
+         result = OpenEPT_ED_HandshakeBegin(ctx, OPENEPT_ED_HANDSHAKE_STAGE_START, OPENEPT_START_NEGOTIATE_MSG, OPENEPT_START_NEGOTIATE_MSG_SIZE);
+     }
+     else
+     {
+         result = OpenEPT_ED_HandshakeBegin(ctx, OPENEPT_ED_HANDSHAKE_STAGE_START_LEGACY, OPENEPT_START_MSG, OPENEPT_START_MSG_SIZE);
+     }
+     OpenEPT_ED_Unlock(ctx);
+     return result;
+ }
+ 
+ int OpenEPT_ED_Ctx_StopAsync(OpenEPT_ED_Context* ctx)
+ {
+     int result = OPEN_EPT_STATUS_OK;
+
+     if(OpenEPT_ED_Lock(ctx) == OPEN_EPT_STATUS_TIMEOUT) return OPEN_EPT_STATUS_TIMEOUT;
+     //Session end goes out once, only when no START or STOP is pending
+     if(ctx->handshake.state != OPENEPT_ED_HANDSHAKE_IDLE) result = OPEN_EPT_STATUS_ERROR;
+     //Make sure all energy points reach Acquisition device before STOP; dropped ones are counted
+     if(result == OPEN_EPT_STATUS_OK) result = OpenEPT_ED_BatchSend(ctx);
+     if(result == OPEN_EPT_STATUS_OK && ctx->protocol != 0) result = OpenEPT_ED_SendSessionEnd(ctx);
+     if(result == OPEN_EPT_STATUS_OK) result = OpenEPT_ED_TransportFlush(ctx) != 0 ? OPEN_EPT_STATUS_ERROR : OPEN_EPT_STATUS_OK;
+     if(result == OPEN_EPT_STATUS_OK && ctx->protocol != 0) result = OpenEPT_ED_HandshakeBegin(ctx, OPENEPT_ED_HANDSHAKE_STAGE_STOP, OPENEPT_STOP_BINARY_MSG, OPENEPT_STOP_BINARY_MSG_SIZE);
+     else if(result == OPEN_EPT_STATUS_OK) result = OpenEPT_ED_HandshakeBegin(ctx, OPENEPT_ED_HANDSHAKE_STAGE_STOP, OPENEPT_STOP_MSG, OPENEPT_STOP_MSG_SIZE);
+     OpenEPT_ED_Unlock(ctx);
+     return result;
+ }
+ 
+ /*
+  * Advance handshake or session maintenance, caller holds the transport.
+  */
+ static int OpenEPT_ED_HandshakePoll(OpenEPT_ED_Context* ctx)
+ {
+     uint32_t now;
+     char data;
+ 
+     switch(ctx->handshake.state)
+     {
+     case OPENEPT_ED_HANDSHAKE_IDLE:
+         if(OpenEPT_ED_BatchExpired(ctx) && OpenEPT_ED_BatchSend(ctx) != 0) return OPEN_EPT_STATUS_ERROR;
+         if(OpenEPT_ED_ClockPoll(ctx) != 0) return OPEN_EPT_STATUS_ERROR;
+         return ctx->handshake.result;
+ 
+     case OPENEPT_ED_HANDSHAKE_BACKOFF:
+         now = ctx->ops->getTickMs(ctx->arg);
+         if(now - ctx->handshake.tick < ctx->handshake.currentBackoffMs) return OPEN_EPT_STATUS_PENDING;
+         //Double backoff for the next attempt
+         ctx->handshake.currentBackoffMs *= 2;
+         if(ctx->handshake.currentBackoffMs > OPENEPT_CONF_HANDSHAKE_BACKOFF_MAX_MS) ctx->handshake.currentBackoffMs = OPENEPT_CONF_HANDSHAKE_BACKOFF_MAX_MS;
+         ctx->handshake.state = OPENEPT_ED_HANDSHAKE_SEND;
+         /* fall through */
+ 
+     case OPENEPT_ED_HANDSHAKE_SEND:
+         //Send Config message
+         if(OpenEPT_ED_TransportSendProtected(ctx, ctx->handshake.msg, ctx->handshake.msgSize) != 0) return OpenEPT_ED_HandshakeEnd(ctx, OPEN_EPT_STATUS_ERROR);
+         ctx->handshake.attempt += 1;
+         ctx->handshake.received = 0;
+         ctx->handshake.tick = ctx->ops->getTickMs(ctx->arg);
+         ctx->handshake.state = OPENEPT_ED_HANDSHAKE_WAIT;
+         /* fall through */
+ 
+     case OPENEPT_ED_HANDSHAKE_WAIT:
+         //Collect response without waiting for characters that did not arrive yet
+         while(OpenEPT_ED_TransportTryRead(ctx, &data) == OPEN_EPT_STATUS_OK)
+         {
+             int32_t okEnd;
+             int status;
+ 
+             if(ctx->handshake.received >= OPENEPT_CONF_RECEIVE_BUFFER_SIZE)
+             {
+                 //Response does not fit, drop what is collected so far
+                 ctx->handshake.received = 0;
+             }
+             ctx->receiveBuffer[ctx->handshake.received++] = (uint8_t)data;
+             if(data != '\r') continue;
+             //Late answer to a clock ping is not a handshake response
+             if(OpenEPT_ED_IsPong(ctx, ctx->handshake.received))
+             {
+                 ctx->handshake.received = 0;
+                 continue;
+             }
+ 
+             //Check is received response OK\r (START response may carry selected baud rate)
+             okEnd = OpenEPT_ED_FindOK(ctx, ctx->handshake.received);
+             if(okEnd >= 0)
+             {
+                 status = OpenEPT_ED_HandshakeAccepted(ctx, (uint32_t)okEnd);
+                 if(status == OPEN_EPT_STATUS_PENDING) return status;
+                 return OpenEPT_ED_HandshakeEnd(ctx, status);
+             }
+             if(ctx->handshake.stage == OPENEPT_ED_HANDSHAKE_STAGE_START)
+             {
+                 //Acquisition device does not understand baud rate offer, fall back to plain START
+                 OpenEPT_ED_HandshakeEnter(ctx, OPENEPT_ED_HANDSHAKE_STAGE_START_LEGACY, OPENEPT_START_MSG, OPENEPT_START_MSG_SIZE);
+                 return OPEN_EPT_STATUS_PENDING;
+             }
+             if(ctx->handshake.stage == OPENEPT_ED_HANDSHAKE_STAGE_CONFIRM)
+             {
+                 OpenEPT_ED_SwitchBaudrate(ctx, 0);
+                 return OpenEPT_ED_HandshakeEnd(ctx, OPEN_EPT_STATUS_OK);
+             }
+             return OpenEPT_ED_HandshakeEnd(ctx, OPEN_EPT_STATUS_ERROR);
+         }
+ 
+         now = ctx->ops->getTickMs(ctx->arg);
+         if(now - ctx->handshake.tick < ctx->handshake.timeoutMs) return OPEN_EPT_STATUS_PENDING;
+ 
+         if(ctx->handshake.stage == OPENEPT_ED_HANDSHAKE_STAGE_CONFIRM)
+         {
+             //New rate does not work, both sides fall back to initial rate. Session is already started.
+             OpenEPT_ED_SwitchBaudrate(ctx, 0);
+             return OpenEPT_ED_HandshakeEnd(ctx, OPEN_EPT_STATUS_OK);
+         }
+ 
+         //No response, resend after backoff unless all attempts are used
+         if(ctx->handshake.retries != 0 && ctx->handshake.attempt > ctx->handshake.retries)
+         {
+             return OpenEPT_ED_HandshakeEnd(ctx, OPEN_EPT_STATUS_TIMEOUT);
+         }
+         if(ctx->handshake.stage == OPENEPT_ED_HANDSHAKE_STAGE_START)
+         {
+             //Acquisition device may silently ignore START with options, offer nothing on next attempts
+             ctx->handshake.stage = OPENEPT_ED_HANDSHAKE_STAGE_START_LEGACY;
+             ctx->handshake.msg = OPENEPT_START_MSG;
+             ctx->handshake.msgSize = OPENEPT_START_MSG_SIZE;
+         }
+         ctx->handshake.tick = now;
+         ctx->handshake.state = OPENEPT_ED_HANDSHAKE_BACKOFF;
+         return OPEN_EPT_STATUS_PENDING;
+     }
+     return OPEN_EPT_STATUS_ERROR;
+ }
+ 
+ int OpenEPT_ED_Ctx_Poll(OpenEPT_ED_Context* ctx)
+ {
+     int result;
+ 
+     if(OpenEPT_ED_Lock(ctx) == OPEN_EPT_STATUS_TIMEOUT) return OPEN_EPT_STATUS_TIMEOUT;
+     result = OpenEPT_ED_HandshakePoll(ctx);
+     if(OpenEPT_ED_Unlock(ctx) != OPEN_EPT_STATUS_OK && result == OPEN_EPT_STATUS_OK) result = OPEN_EPT_STATUS_ERROR;
+     return result;
+ }
+ 
+ /*
+  * Run armed handshake until it completes.
+  */
+ static int OpenEPT_ED_HandshakeWait(OpenEPT_ED_Context* ctx)
+ {
+     int status;
+     do
+     {
+         status = OpenEPT_ED_Ctx_Poll(ctx);
+     }while(status == OPEN_EPT_STATUS_PENDING);
+     return status;
+ }
+ 
+ int OpenEPT_ED_Ctx_Start(OpenEPT_ED_Context* ctx)
+ {
+     if(OpenEPT_ED_Ctx_StartAsync(ctx) != OPEN_EPT_STATUS_OK) return OPEN_EPT_STATUS_ERROR;
+     return OpenEPT_ED_HandshakeWait(ctx);
+ }
+ 
+ 
+ int OpenEPT_ED_Ctx_Stop(OpenEPT_ED_Context* ctx)
+ {
+     if(OpenEPT_ED_Ctx_StopAsync(ctx) != OPEN_EPT_STATUS_OK) return OPEN_EPT_STATUS_ERROR;
+     return OpenEPT_ED_HandshakeWait(ctx);
+ }
+ 
+ 
+ int OpenEPT_ED_Ctx_SetEPFast(OpenEPT_ED_Context* ctx, uint8_t* epName, uint32_t epNameSize)
+ {
+     if(ctx->ops->syncToggle != NULL && ctx->ops->syncToggle(ctx->arg) != 0) return OPEN_EPT_STATUS_ERROR;
+     //Send EP message
+     return OpenEPT_ED_SendEvent(ctx, OPENEPT_ED_RECORD_EP_NAME, NULL, 0, epName, epNameSize);
+ }
+ 
+ 
+ int OpenEPT_ED_Ctx_SendInfo(OpenEPT_ED_Context* ctx, const char* message)
+ {    
+     //Send Info message
+     return OpenEPT_ED_SendEvent(ctx, OPENEPT_ED_RECORD_INFO, NULL, 0, (const uint8_t*)message, strlen(message));
+ }
+ 
+ 
+ int OpenEPT_ED_Ctx_RegisterEP(OpenEPT_ED_Context* ctx, const char* epName, uint32_t* epId)
+ {
+     uint32_t size = strlen(epName);
+     uint32_t cnt;
+     int result = OPEN_EPT_STATUS_OK;
+ 
+     //Lookup and insert under the lock, so concurrent registrations get distinct entries
+     if(OpenEPT_ED_Lock(ctx) == OPEN_EPT_STATUS_TIMEOUT) return OPEN_EPT_STATUS_TIMEOUT;
+     //Same name registered again gets the same ID
+     for(cnt = 0; cnt < ctx->dictionarySize; cnt++)
+     {
+         if(ctx->dictionary[cnt].size == size && memcmp(ctx->dictionary[cnt].data, epName, size) == 0) break;
+     }
+     if(cnt < ctx->dictionarySize) *epId = cnt;
+     else if(cnt >= OPENEPT_CONF_EP_DICTIONARY_SIZE) result = OPEN_EPT_STATUS_ERROR;
+     else
+     {
+         ctx->dictionary[cnt].data = (const uint8_t*)epName;
+         ctx->dictionary[cnt].size = size;
+         //Entry is complete before its ID passes the lock free checks of SetEP, Begin and End
+         __atomic_store_n(&ctx->dictionarySize, cnt + 1, __ATOMIC_RELEASE);
+         *epId = cnt;
+         //Registered during session, Acquisition device already has the rest of the table
+         if(ctx->protocol != 0 && ctx->handshake.state == OPENEPT_ED_HANDSHAKE_IDLE) result = OpenEPT_ED_SendDefinition(ctx, cnt);
+     }
+     if(OpenEPT_ED_Unlock(ctx) != OPEN_EPT_STATUS_OK) result = OPEN_EPT_STATUS_ERROR;
+     return result;
+ }
+ 
+ 
+ int OpenEPT_ED_Ctx_SetEPHash(OpenEPT_ED_Context* ctx, uint32_t epHash, const char* epName, uint32_t epNameSize)
+ {
+     uint8_t hash[4];
+ 
+     if(ctx->ops->syncToggle != NULL && ctx->ops->syncToggle(ctx->arg) != 0) return OPEN_EPT_STATUS_ERROR;
+     if(ctx->protocol == 0) return OpenEPT_ED_SendEvent(ctx, OPENEPT_ED_RECORD_EP_NAME, NULL, 0, (const uint8_t*)epName, epNameSize);
+     hash[0] = (uint8_t)epHash;
+     hash[1] = (uint8_t)(epHash >> 8);
+     hash[2] = (uint8_t)(epHash >> 16);
+     hash[3] = (uint8_t)(epHash >> 24);
+     return OpenEPT_ED_SendEvent(ctx, OPENEPT_ED_RECORD_EP_HASH, NULL, 0, hash, 4);
+ }
+ 
+ 
+ int OpenEPT_ED_Ctx_SetEPDescriptor(OpenEPT_ED_Context* ctx, const char* epDescriptor)
+ {
+     uint8_t prefix[OPENEPT_ED_PROTOCOL_VARINT_MAX_SIZE];
+     uint32_t prefixSize;
+ 
+     if(OPENEPT_EP_SECTION_START == NULL || epDescriptor < OPENEPT_EP_SECTION_START || epDescriptor >= OPENEPT_EP_SECTION_STOP) return OPEN_EPT_STATUS_ERROR;
+     if(ctx->ops->syncToggle != NULL && ctx->ops->syncToggle(ctx->arg) != 0) return OPEN_EPT_STATUS_ERROR;
+     if(ctx->protocol == 0) return OpenEPT_ED_SendEvent(ctx, OPENEPT_ED_RECORD_EP_NAME, NULL, 0, (const uint8_t*)epDescriptor, strlen(epDescriptor));
+     prefixSize = OpenEPT_ED_Protocol_PutVarint(prefix, (uint32_t)(epDescriptor - OPENEPT_EP_SECTION_START));
+     return OpenEPT_ED_SendEvent(ctx, OPENEPT_ED_RECORD_EP_OFFSET, prefix, prefixSize, NULL, 0);
+ }
+ 
+ 
+ int OpenEPT_ED_Ctx_SetEPArgsEncoded(OpenEPT_ED_Context* ctx, uint32_t fmtId, const char* format, const uint8_t* args, uint32_t argsSize)
+ {
+     char text[OPENEPT_CONF_TRANSMIT_BUFFER_SIZE];
+     uint8_t hash[4];
+ 
+     if(ctx->ops->syncToggle != NULL && ctx->ops->syncToggle(ctx->arg) != 0) return OPEN_EPT_STATUS_ERROR;
+     if(ctx->protocol == 0)
+     {
+         //Acquisition device without binary protocol can not format, it gets the text
+         return OpenEPT_ED_SendEvent(ctx, OPENEPT_ED_RECORD_EP_NAME, NULL, 0, (const uint8_t*)text, OpenEPT_ED_Protocol_FormatArgs(text, sizeof(text), format, args, argsSize));
+     }
+     hash[0] = (uint8_t)fmtId;
+     hash[1] = (uint8_t)(fmtId >> 8);
+     hash[2] = (uint8_t)(fmtId >> 16);
+     hash[3] = (uint8_t)(fmtId >> 24);
+     return OpenEPT_ED_SendEvent(ctx, OPENEPT_ED_RECORD_EP_FORMAT, hash, 4, args, argsSize);
+ }
+ 
+ int OpenEPT_ED_Ctx_SetEPArgs(OpenEPT_ED_Context* ctx, uint32_t fmtId, const char* format, ...)
+ {
+     uint8_t args[OPENEPT_CONF_EP_ARGS_SIZE];
+     uint32_t argsSize;
+     va_list list;
+ 
+     va_start(list, format);
+     argsSize = OpenEPT_ED_Protocol_EncodeArgs(args, sizeof(args), format, list);
+     va_end(list);
+     return OpenEPT_ED_Ctx_SetEPArgsEncoded(ctx, fmtId, format, args, argsSize);
+ }
+ 
+ 
+ /*
+  * Send region record "<varint depth><varint id>", ASCII protocol gets the EP name behind
+  * OPENEPT_ED_ASCII_REGION_BEGIN or OPENEPT_ED_ASCII_REGION_END, cut to the transmit buffer.
+  */
+ static int OpenEPT_ED_SendRegion(OpenEPT_ED_Context* ctx, uint8_t type, uint32_t depth, uint32_t epId)
+ {
+     uint8_t prefix[2 * OPENEPT_ED_PROTOCOL_VARINT_MAX_SIZE];
+     uint8_t text[OPENEPT_CONF_TRANSMIT_BUFFER_SIZE];
+     const char* mark = type == OPENEPT_ED_RECORD_REGION_BEGIN ? OPENEPT_ED_ASCII_REGION_BEGIN : OPENEPT_ED_ASCII_REGION_END;
+     uint32_t prefixSize;
+ 
+     if(ctx->ops->syncToggle != NULL && ctx->ops->syncToggle(ctx->arg) != 0) return OPEN_EPT_STATUS_ERROR;
+     if(ctx->protocol == 0)
+     {
+         prefixSize = strlen(mark);
+         memcpy(text, mark, prefixSize);
+         if(ctx->dictionary[epId].size < sizeof(text) - prefixSize) prefixSize += ctx->dictionary[epId].size;
+         else prefixSize = sizeof(text);
+         memcpy(&text[strlen(mark)], ctx->dictionary[epId].data, prefixSize - strlen(mark));
+         return OpenEPT_ED_SendEvent(ctx, OPENEPT_ED_RECORD_EP_NAME, NULL, 0, text, prefixSize);
+     }
+     prefixSize = OpenEPT_ED_Protocol_PutVarint(prefix, depth);
+     prefixSize += OpenEPT_ED_Protocol_PutVarint(&prefix[prefixSize], epId);
+     return OpenEPT_ED_SendEvent(ctx, type, prefix, prefixSize, NULL, 0);
+ }
+ 
+ int OpenEPT_ED_Ctx_Begin(OpenEPT_ED_Context* ctx, uint32_t epId)
+ {
+     uint32_t depth = ctx->regionDepth;
+ 
+     if(epId >= ctx->dictionarySize) return OPEN_EPT_STATUS_ERROR;
+     //Region is open even if it can not be sent, so its end stays balanced
+     if(depth < OPENEPT_CONF_REGION_DEPTH) ctx->regions[depth] = epId;
+     ctx->regionDepth = depth + 1;
+     return OpenEPT_ED_SendRegion(ctx, OPENEPT_ED_RECORD_REGION_BEGIN, depth, epId);
+ }
+ 
+ int OpenEPT_ED_Ctx_End(OpenEPT_ED_Context* ctx, uint32_t epId)
+ {
+     uint32_t depth = ctx->regionDepth;
+ 
+     if(depth == 0 || epId >= ctx->dictionarySize) return OPEN_EPT_STATUS_ERROR;
+     depth -= 1;
+     if(depth < OPENEPT_CONF_REGION_DEPTH && ctx->regions[depth] != epId) return OPEN_EPT_STATUS_ERROR;
+     ctx->regionDepth = depth;
+     return OpenEPT_ED_SendRegion(ctx, OPENEPT_ED_RECORD_REGION_END, depth, epId);
+ }
+
+ OpenEPT_ED_Scope OpenEPT_ED_Ctx_ScopeBegin(OpenEPT_ED_Context* ctx, uint32_t epId)
+ {
+     OpenEPT_ED_Scope scope;
+ 
+     scope.ctx = ctx;
+     scope.epId = epId;
+     //Region is open also if sending failed, only an unknown ID leaves nothing to end
+     scope.open = epId < ctx->dictionarySize;
+     if(OpenEPT_ED_Ctx_Begin(ctx, epId) != OPEN_EPT_STATUS_OK) ctx->scopeErrors += 1;
+     return scope;
+ }
+ 
+ void OpenEPT_ED_ScopeEnd(OpenEPT_ED_Scope* scope)
+ {
+     if(!scope->open) return;
+     scope->open = 0;
+     if(OpenEPT_ED_Ctx_End(scope->ctx, scope->epId) != OPEN_EPT_STATUS_OK) scope->ctx->scopeErrors += 1;
+ }
+ 
+ uint32_t OpenEPT_ED_Ctx_GetScopeErrors(OpenEPT_ED_Context* ctx)
+ {
+     return ctx->scopeErrors;
+ }
+ 
+ 
+ int OpenEPT_ED_Ctx_SetBatchPolicy(OpenEPT_ED_Context* ctx, uint32_t size, uint32_t maxAgeMs)
+ {
+     int result;
+ 
+     if(OpenEPT_ED_Lock(ctx) == OPEN_EPT_STATUS_TIMEOUT) return OPEN_EPT_STATUS_TIMEOUT;
+     result = OpenEPT_ED_BatchSend(ctx);
+     ctx->batchSize = size < OPENEPT_CONF_BATCH_BUFFER_SIZE ? size : OPENEPT_CONF_BATCH_BUFFER_SIZE;
+     ctx->batchAgeMs = maxAgeMs;
+     if(OpenEPT_ED_Unlock(ctx) != OPEN_EPT_STATUS_OK) result = OPEN_EPT_STATUS_ERROR;
+     return result;
+ }
+ 
+ int OpenEPT_ED_Ctx_Flush(OpenEPT_ED_Context* ctx)
+ {
+     //Events queued in the ring go into the batch before it is sent
+     int result = OpenEPT_ED_Lock(ctx);
+ 
+     if(result == OPEN_EPT_STATUS_TIMEOUT) return result;
+     if(OpenEPT_ED_BatchSend(ctx) != OPEN_EPT_STATUS_OK) result = OPEN_EPT_STATUS_ERROR;
+     if(OpenEPT_ED_Unlock(ctx) != OPEN_EPT_STATUS_OK) result = OPEN_EPT_STATUS_ERROR;
+     return result;
+ }
+ 
+ int OpenEPT_ED_Ctx_SetOverflowPolicy(OpenEPT_ED_Context* ctx, uint32_t policy)
+ {
+     if(policy > OPENEPT_ED_OVERFLOW_MARK) return OPEN_EPT_STATUS_ERROR;
+     ctx->overflowPolicy = policy;
+     return OPEN_EPT_STATUS_OK;
+ }
+ 
+ uint32_t OpenEPT_ED_Ctx_GetDropped(OpenEPT_ED_Context* ctx)
+ {
+     return ctx->dropped;
+ }
+ 
+ int OpenEPT_ED_Ctx_SetClockPeriod(OpenEPT_ED_Context* ctx, uint32_t periodMs)
+ {
+     ctx->clock.periodMs = periodMs;
+     return OPEN_EPT_STATUS_OK;
+ }
+ 
+ int OpenEPT_ED_Ctx_GetClock(OpenEPT_ED_Context* ctx, int64_t* offsetNs, uint32_t* rttNs, int32_t* driftPpb)
+ {
+     if(ctx->protocol == 0 || ctx->clock.count == 0) return OPEN_EPT_STATUS_ERROR;
+     if(offsetNs != NULL) *offsetNs = ctx->clock.estimate.offsetNs;
+     if(rttNs != NULL) *rttNs = ctx->clock.estimate.rttNs;
+     if(driftPpb != NULL) *driftPpb = ctx->clock.driftPpb;
+     return OPEN_EPT_STATUS_OK;
+ }
+ 
+ 
+ int OpenEPT_ED_Ctx_SendQueued(OpenEPT_ED_Context* ctx, const OpenEPT_ED_RingSlot* slot)
+ {
+     int result = OpenEPT_ED_Lock(ctx);
+ 
+     if(result == OPEN_EPT_STATUS_TIMEOUT) return result;
+     if(slot != NULL && OpenEPT_ED_SlotSend(ctx, slot) != OPEN_EPT_STATUS_OK) result = OPEN_EPT_STATUS_ERROR;
+     if(OpenEPT_ED_Unlock(ctx) != OPEN_EPT_STATUS_OK) result = OPEN_EPT_STATUS_ERROR;
+     return result;
+ }
+ 
+ int OpenEPT_ED_Ctx_SendTask(OpenEPT_ED_Context* ctx, uint64_t timestamp, uint32_t taskId)
+ {
+     uint8_t prefix[OPENEPT_ED_PROTOCOL_VARINT_MAX_SIZE];
+     uint32_t prefixSize = OpenEPT_ED_Protocol_PutVarint(prefix, taskId);
+     int result = OpenEPT_ED_Lock(ctx);
+ 
+     if(result == OPEN_EPT_STATUS_TIMEOUT) return result;
+     //Task IDs mean nothing without the table, so ASCII sessions get no switches
+     if(ctx->protocol != 0 && OpenEPT_ED_SendBinaryEvent(ctx, timestamp, OPENEPT_ED_RECORD_TASK, prefix, prefixSize, NULL, 0) != OPEN_EPT_STATUS_OK) result = OPEN_EPT_STATUS_ERROR;
+     if(OpenEPT_ED_Unlock(ctx) != OPEN_EPT_STATUS_OK) result = OPEN_EPT_STATUS_ERROR;
+     return result;
+ }
+ 
+ int OpenEPT_ED_Ctx_DefineTask(OpenEPT_ED_Context* ctx, uint32_t taskId, const char* name)
+ {
+     uint8_t prefix[OPENEPT_ED_PROTOCOL_VARINT_MAX_SIZE];
+     uint32_t prefixSize = OpenEPT_ED_Protocol_PutVarint(prefix, taskId);
+     int result = OpenEPT_ED_Lock(ctx);
+ 
+     if(result == OPEN_EPT_STATUS_TIMEOUT) return result;
+     if(ctx->protocol != 0 && OpenEPT_ED_SendBinaryFrame(ctx, 0, NULL, 0, OPENEPT_ED_RECORD_TASK_DEFINE, prefix, prefixSize, (const uint8_t*)name, (uint32_t)strlen(name)) != OPEN_EPT_STATUS_OK) result = OPEN_EPT_STATUS_ERROR;
+     if(OpenEPT_ED_Unlock(ctx) != OPEN_EPT_STATUS_OK) result = OPEN_EPT_STATUS_ERROR;
+     return result;
+ }
+ 
+ int OpenEPT_ED_Ctx_AttachThread(OpenEPT_ED_Context* ctx, OpenEPT_ED_ThreadBuffer* buffer)
+ {
+ #if OPENEPT_CONF_THREAD_BUFFERS != 0
+     uint32_t index = __atomic_load_n(&ctx->threadCount, __ATOMIC_RELAXED);
+ 
+     //Reserve an entry, threads may attach concurrently
+     do
+     {
+         if(index >= OPENEPT_CONF_THREAD_BUFFERS) return OPEN_EPT_STATUS_ERROR;
+     }while(!__atomic_compare_exchange_n(&ctx->threadCount, &index, index + 1, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+     memset(buffer, 0, sizeof(OpenEPT_ED_ThreadBuffer));
+     buffer->ctx = ctx;
+     __atomic_store_n(&ctx->threads[index], buffer, __ATOMIC_RELEASE);
+     OpenEPT_ED_Platform_SetThreadBuffer(buffer);
+     return OPEN_EPT_STATUS_OK;
+ #else
+     (void)ctx;
+     (void)buffer;
+     return OPEN_EPT_STATUS_ERROR;
+ #endif
+ }
+ 
+ int OpenEPT_ED_Ctx_SetEP(OpenEPT_ED_Context* ctx, uint32_t epId)
+ {
+     uint8_t prefix[OPENEPT_ED_PROTOCOL_VARINT_MAX_SIZE];
+     uint32_t prefixSize;
+ 
+     if(epId >= ctx->dictionarySize) return OPEN_EPT_STATUS_ERROR;
+     if(ctx->ops->syncToggle != NULL && ctx->ops->syncToggle(ctx->arg) != 0) return OPEN_EPT_STATUS_ERROR;
+     //ASCII protocol has no dictionary, the name is sent instead
+     if(ctx->protocol == 0) return OpenEPT_ED_SendEvent(ctx, OPENEPT_ED_RECORD_EP_NAME, NULL, 0, ctx->dictionary[epId].data, ctx->dictionary[epId].size);
+     prefixSize = OpenEPT_ED_Protocol_PutVarint(prefix, epId);
+     return OpenEPT_ED_SendEvent(ctx, OPENEPT_ED_RECORD_EP_ID, prefix, prefixSize, NULL, 0);
+ }
+ 
+ 
+ /*
+  * Transport over platform functions. Each operation calls the platform directly, so
+  * default context pays a single indirect call per transport operation.
+  */
+ static int OpenEPT_ED_PlatformOpInit(void* arg)
+ {
+     (void)arg;
+     return OpenEPT_ED_Platform_Init();
+ }
+ 
+ static int OpenEPT_ED_PlatformOpSendBuffer(void* arg, const uint8_t* buffer, uint32_t size)
+ {
+     (void)arg;
+     return OpenEPT_ED_Platform_SendBuffer(buffer, size);
+ }
+ 
+ static int OpenEPT_ED_PlatformOpSendSegments(void* arg, const OpenEPT_ED_Segment* segments, uint32_t count)
+ {
+     (void)arg;
+     return OpenEPT_ED_Platform_SendSegments(segments, count);
+ }
+ 
+ static int OpenEPT_ED_PlatformOpFlush(void* arg)
+ {
+     (void)arg;
+     return OpenEPT_ED_Platform_Flush();
+ }
+ 
+ static int OpenEPT_ED_PlatformOpTryRead(void* arg, char* character)
+ {
+     (void)arg;
+     return OpenEPT_ED_Platform_TryRead(character);
+ }
+ 
+ static int OpenEPT_ED_PlatformOpSyncToggle(void* arg)
+ {
+     (void)arg;
+     return OpenEPT_ED_Platform_SyncToogle();
+ }
+ 
+ static int OpenEPT_ED_PlatformOpReconfigure(void* arg, uint32_t baudrate)
+ {
+     (void)arg;
+     return OpenEPT_ED_Platform_Reconfigure(baudrate);
+ }
+ 
+ static uint32_t OpenEPT_ED_PlatformOpGetTickMs(void* arg)
+ {
+     (void)arg;
+     return OpenEPT_ED_Platform_GetTickMs();
+ }
+ 
+ static uint64_t OpenEPT_ED_PlatformOpGetTimestamp(void* arg)
+ {
+     (void)arg;
+     return OpenEPT_ED_Platform_GetTimestamp();
+ }
+ 
+ static uint32_t OpenEPT_ED_PlatformOpGetTimestampFrequency(void* arg)
+ {
+     (void)arg;
+     return OpenEPT_ED_Platform_GetTimestampFrequency();
+ }
+ 
+ static uint32_t OpenEPT_ED_PlatformOpTxSpace(void* arg)
+ {
+     (void)arg;
+     return OpenEPT_ED_Platform_TxSpace();
+ }
+ 
+ static int OpenEPT_ED_PlatformOpTxDiscard(void* arg)
+ {
+     (void)arg;
+     return OpenEPT_ED_Platform_TxDiscard();
+ }
+ 
+ static void OpenEPT_ED_PlatformOpTxProtect(void* arg)
+ {
+     (void)arg;
+     OpenEPT_ED_Platform_TxProtect();
+ }
+ 
+ static void OpenEPT_ED_PlatformOpDrainRequest(void* arg)
+ {
+     (void)arg;
+     OpenEPT_ED_Platform_DrainRequest();
+ }
+ 
+ const OpenEPT_ED_TransportOps OpenEPT_ED_PlatformTransportOps =
+ {
+     OpenEPT_ED_PlatformOpInit,
+     OpenEPT_ED_PlatformOpSendBuffer,
+     OpenEPT_ED_PlatformOpSendSegments,
+     OpenEPT_ED_PlatformOpFlush,
+     OpenEPT_ED_PlatformOpTryRead,
+     OpenEPT_ED_PlatformOpSyncToggle,
+     OpenEPT_ED_PlatformOpReconfigure,
+     OpenEPT_ED_PlatformOpGetTickMs,
+     OpenEPT_ED_PlatformOpGetTimestamp,
+     OpenEPT_ED_PlatformOpGetTimestampFrequency,
+     OpenEPT_ED_PlatformOpTxSpace,
+     OpenEPT_ED_PlatformOpTxDiscard,
+     OpenEPT_ED_PlatformOpTxProtect,
+     NULL,
+     OpenEPT_ED_PlatformOpDrainRequest,
+     NULL,
+     NULL
+ };
+ 
+ 
+ /*
+  * Transport that appends frames to a RAM buffer. Nothing is ever received, so START/STOP
+  * handshakes on it time out; use it for energy points and info messages only.
+  */
+ static int OpenEPT_ED_MemoryOpSendBuffer(void* arg, const uint8_t* buffer, uint32_t size)
+ {
+     OpenEPT_ED_MemoryTransport* memory = (OpenEPT_ED_MemoryTransport*)arg;
+     if(size > memory->size - memory->used) return OPEN_EPT_STATUS_ERROR;
+     memcpy(&memory->buffer[memory->used], buffer, size);
+     memory->used += size;
+     return OPEN_EPT_STATUS_OK;
+ }
+ 
+ static uint32_t OpenEPT_ED_MemoryOpGetTickMs(void* arg)
+ {
+     (void)arg;
+     return OpenEPT_ED_Platform_GetTickMs();
+ }
+ 
+ static uint32_t OpenEPT_ED_MemoryOpTxSpace(void* arg)
+ {
+     OpenEPT_ED_MemoryTransport* memory = (OpenEPT_ED_MemoryTransport*)arg;
+     return memory->size - memory->used;
+ }
+ 
+ /*
+  * Remove the oldest stored binary frame after the protected ones, up to and including its
+  * 0x00 delimiter.
+  */
+ static int OpenEPT_ED_MemoryOpTxDiscard(void* arg)
+ {
+     OpenEPT_ED_MemoryTransport* memory = (OpenEPT_ED_MemoryTransport*)arg;
+     const uint8_t* delimiter;
+     uint8_t* start;
+     uint32_t size;
+ 
+     //Buffer was emptied by its owner since frames were protected
+     if(memory->protect > memory->used) memory->protect = memory->used;
+     start = &memory->buffer[memory->protect];
+     delimiter = memchr(start, 0x00, memory->used - memory->protect);
+     if(delimiter == NULL) return OPEN_EPT_STATUS_ERROR;
+     size = (uint32_t)(delimiter - start) + 1;
+     memmove(start, &start[size], memory->used - memory->protect - size);
+     memory->used -= size;
+     return OPEN_EPT_STATUS_OK;
+ }
+ 
+ static void OpenEPT_ED_MemoryOpTxProtect(void* arg)
+ {
+     OpenEPT_ED_MemoryTransport* memory = (OpenEPT_ED_MemoryTransport*)arg;
+     memory->protect = memory->used;
+ }
+ 
+ const OpenEPT_ED_TransportOps OpenEPT_ED_MemoryTransportOps =
+ {
+     NULL,
+     OpenEPT_ED_MemoryOpSendBuffer,
+     NULL,
+     NULL,
+     NULL,
+     NULL,
+     NULL,
+     OpenEPT_ED_MemoryOpGetTickMs,
+     NULL,
+     NULL,
+     OpenEPT_ED_MemoryOpTxSpace,
+     OpenEPT_ED_MemoryOpTxDiscard,
+     OpenEPT_ED_MemoryOpTxProtect,
+     NULL,
+     NULL,
+     NULL,
+     NULL
+ };
+ 
+ 
+ /*
+  * Functions without context argument operate on default context
+  */
+ static OpenEPT_ED_Context OPENEPT_DEFAULT_CONTEXT = { .ops = &OpenEPT_ED_PlatformTransportOps };
+ 
+ OpenEPT_ED_Context* OpenEPT_ED_GetDefaultContext()
+ {
+     return &OPENEPT_DEFAULT_CONTEXT;
+ }
+ 
+ int OpenEPT_ED_Init()
+ {
+     return OpenEPT_ED_Ctx_Init(&OPENEPT_DEFAULT_CONTEXT, &OpenEPT_ED_PlatformTransportOps, NULL);
+ }
+ 
+ void OpenEPT_ED_SetHandshakePolicy(uint32_t retries, uint32_t timeoutMs, uint32_t backoffMs)
+ {
+     OpenEPT_ED_Ctx_SetHandshakePolicy(&OPENEPT_DEFAULT_CONTEXT, retries, timeoutMs, backoffMs);
+ }
+ 
+ int OpenEPT_ED_Start()
+ {
+     return OpenEPT_ED_Ctx_Start(&OPENEPT_DEFAULT_CONTEXT);
+ }
+ 
+ int OpenEPT_ED_StartAsync()
+ {
+     return OpenEPT_ED_Ctx_StartAsync(&OPENEPT_DEFAULT_CONTEXT);
+ }
+ 
+ int OpenEPT_ED_Stop()
+ {
+     return OpenEPT_ED_Ctx_Stop(&OPENEPT_DEFAULT_CONTEXT);
+ }
+ 
+ int OpenEPT_ED_StopAsync()
+ {
+     return OpenEPT_ED_Ctx_StopAsync(&OPENEPT_DEFAULT_CONTEXT);
+ }
+ 
+ int OpenEPT_ED_Poll()
+ {
+     return OpenEPT_ED_Ctx_Poll(&OPENEPT_DEFAULT_CONTEXT);
+ }
+ 
+ int OpenEPT_ED_SetEPFast(uint8_t* epName, uint32_t epNameSize)
+ {
+     return OpenEPT_ED_Ctx_SetEPFast(&OPENEPT_DEFAULT_CONTEXT, epName, epNameSize);
+ }
+ 
+ int OpenEPT_ED_SendInfo(const char* message)
+ {
+     return OpenEPT_ED_Ctx_SendInfo(&OPENEPT_DEFAULT_CONTEXT, message);
+ }
+ 
+ int OpenEPT_ED_RegisterEP(const char* epName, uint32_t* epId)
+ {
+     return OpenEPT_ED_Ctx_RegisterEP(&OPENEPT_DEFAULT_CONTEXT, epName, epId);
+ }
+ 
+ int OpenEPT_ED_SetEP(uint32_t epId)
+ {
+     return OpenEPT_ED_Ctx_SetEP(&OPENEPT_DEFAULT_CONTEXT, epId);
+ }
+ 
+ int OpenEPT_ED_SetEPHash(uint32_t epHash, const char* epName, uint32_t epNameSize)
+ {
+     return OpenEPT_ED_Ctx_SetEPHash(&OPENEPT_DEFAULT_CONTEXT, epHash, epName, epNameSize);
+ }
+ 
+ int OpenEPT_ED_SetEPDescriptor(const char* epDescriptor)
+ {
+     return OpenEPT_ED_Ctx_SetEPDescriptor(&OPENEPT_DEFAULT_CONTEXT, epDescriptor);
+ }
+ 
+ int OpenEPT_ED_SetEPArgs(uint32_t fmtId, const char* format, ...)
+ {
+     uint8_t args[OPENEPT_CONF_EP_ARGS_SIZE];
+     uint32_t argsSize;
+     va_list list;
+ 
+     va_start(list, format);
+     argsSize = OpenEPT_ED_Protocol_EncodeArgs(args, sizeof(args), format, list);
+     va_end(list);
+     return OpenEPT_ED_Ctx_SetEPArgsEncoded(&OPENEPT_DEFAULT_CONTEXT, fmtId, format, args, argsSize);
+ }
+ 
+ int OpenEPT_ED_SetEPArgsEncoded(uint32_t fmtId, const char* format, const uint8_t* args, uint32_t argsSize)
+ {
+     return OpenEPT_ED_Ctx_SetEPArgsEncoded(&OPENEPT_DEFAULT_CONTEXT, fmtId, format, args, argsSize);
+ }
+ 
+ int OpenEPT_ED_Begin(uint32_t epId)
+ {
+     return OpenEPT_ED_Ctx_Begin(&OPENEPT_DEFAULT_CONTEXT, epId);
+ }
+ 
+ int OpenEPT_ED_End(uint32_t epId)
+ {
+     return OpenEPT_ED_Ctx_End(&OPENEPT_DEFAULT_CONTEXT, epId);
+ }
+ 
+ OpenEPT_ED_Scope OpenEPT_ED_ScopeBegin(uint32_t epId)
+ {
+     return OpenEPT_ED_Ctx_ScopeBegin(&OPENEPT_DEFAULT_CONTEXT, epId);
+ }
+
+ uint32_t OpenEPT_ED_GetScopeErrors()
+ {
+     return OpenEPT_ED_Ctx_GetScopeErrors(&OPENEPT_DEFAULT_CONTEXT);
+ }
+ 
+ int OpenEPT_ED_SetBatchPolicy(uint32_t size, uint32_t maxAgeMs)
+ {
+     return OpenEPT_ED_Ctx_SetBatchPolicy(&OPENEPT_DEFAULT_CONTEXT, size, maxAgeMs);
+ }
+ 
+ int OpenEPT_ED_Flush()
+ {
+     return OpenEPT_ED_Ctx_Flush(&OPENEPT_DEFAULT_CONTEXT);
+ }
+ 
+ int OpenEPT_ED_SetOverflowPolicy(uint32_t policy)
+ {
+     return OpenEPT_ED_Ctx_SetOverflowPolicy(&OPENEPT_DEFAULT_CONTEXT, policy);
+ }
+ 
+ uint32_t OpenEPT_ED_GetDropped()
+ {
+     return OpenEPT_ED_Ctx_GetDropped(&OPENEPT_DEFAULT_CONTEXT);
+ }
+ 
+ int OpenEPT_ED_SetClockPeriod(uint32_t periodMs)
+ {
+     return OpenEPT_ED_Ctx_SetClockPeriod(&OPENEPT_DEFAULT_CONTEXT, periodMs);
+ }
+ 
+ int OpenEPT_ED_GetClock(int64_t* offsetNs, uint32_t* rttNs, int32_t* driftPpb)
+ {
+     return OpenEPT_ED_Ctx_GetClock(&OPENEPT_DEFAULT_CONTEXT, offsetNs, rttNs, driftPpb);
+ }
+ 
+ int OpenEPT_ED_AttachThread(OpenEPT_ED_ThreadBuffer* buffer)
+ {
+     return OpenEPT_ED_Ctx_AttachThread(&OPENEPT_DEFAULT_CONTEXT, buffer);
+ }
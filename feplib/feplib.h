@@ -22,11 +22,326 @@ extern "C" {
 
 #define OPEN_EPT_STATUS_OK                  0
 #define OPEN_EPT_STATUS_ERROR               1
+#define OPEN_EPT_STATUS_PENDING             2
+#define OPEN_EPT_STATUS_TIMEOUT             3
 
 
 /* Size of the buffer used within OpenEPT EP Library to receive messages from Acquistion device */
 #define OPENEPT_CONF_RECEIVE_BUFFER_SIZE    OPENEPT_ED_CONF_RECEIVE_BUFFER_SIZE
 
+/* START/STOP handshake retry policy, can be changed at run time with OpenEPT_ED_SetHandshakePolicy */
+#define OPENEPT_CONF_HANDSHAKE_RETRIES      OPENEPT_ED_CONF_HANDSHAKE_RETRIES
+#define OPENEPT_CONF_HANDSHAKE_TIMEOUT_MS   OPENEPT_ED_CONF_HANDSHAKE_TIMEOUT_MS
+#define OPENEPT_CONF_HANDSHAKE_BACKOFF_MS   OPENEPT_ED_CONF_HANDSHAKE_BACKOFF_MS
+#define OPENEPT_CONF_HANDSHAKE_BACKOFF_MAX_MS OPENEPT_ED_CONF_HANDSHAKE_BACKOFF_MAX_MS
+
+/* Baud rates offered in START handshake, 0 terminated */
+#define OPENEPT_CONF_LINK_BAUDRATES         OPENEPT_ED_CONF_LINK_BAUDRATES
+
+/* Binary protocol version offered in START handshake, 0 keeps ASCII frames */
+#define OPENEPT_CONF_PROTOCOL_VERSION       OPENEPT_ED_CONF_PROTOCOL_VERSION
+
+/*
+ * Compile-time energy point IDs: 32 bit FNV-1a hash of the name. OPENEPT_EP_HASH("name") is
+ * folded by the compiler, names longer than OPENEPT_EP_NAME_MAX characters do not compile.
+ * Hash of a string literal is constant in GCC/Clang static initializers, which OPENEPT_EP
+ * relies on; feplib.hpp provides a constexpr implementation for C++.
+ */
+#define OPENEPT_EP_NAME_MAX                 48
+#define OPENEPT_EP_HASH_BASIS               2166136261u
+#define OPENEPT_EP_HASH_PRIME               16777619u
+#define OPENEPT_EP_HASH_STEP(h, s, i)       (((h) ^ ((i) < sizeof(s) - 1 ? (uint8_t)(s)[(i) < sizeof(s) - 1 ? (i) : 0] : 0u)) * \
+                                             ((i) < sizeof(s) - 1 ? OPENEPT_EP_HASH_PRIME : 1u))
+#define OPENEPT_EP_HASH_4(h, s, i)          OPENEPT_EP_HASH_STEP(OPENEPT_EP_HASH_STEP(OPENEPT_EP_HASH_STEP(OPENEPT_EP_HASH_STEP(h, s, i), s, (i) + 1), s, (i) + 2), s, (i) + 3)
+#define OPENEPT_EP_HASH_16(h, s, i)         OPENEPT_EP_HASH_4(OPENEPT_EP_HASH_4(OPENEPT_EP_HASH_4(OPENEPT_EP_HASH_4(h, s, i), s, (i) + 4), s, (i) + 8), s, (i) + 12)
+#define OPENEPT_EP_HASH(s)                  ((uint32_t)(OPENEPT_EP_HASH_16(OPENEPT_EP_HASH_16(OPENEPT_EP_HASH_16(OPENEPT_EP_HASH_BASIS, s, 0), s, 16), s, 32) + \
+                                             0u * sizeof(char[sizeof(s) - 1 <= OPENEPT_EP_NAME_MAX ? 1 : -1])))
+
+/*
+ * Set up energy point identified by its name hash, e.g. OPENEPT_EP("LStart"). Name must be
+ * a string literal. Run tools/ephash over the sources to check hashes for collisions and to
+ * get the hash to name table for the Acquisition side.
+ */
+#define OPENEPT_EP(name)                    do { static const uint32_t openEptEpHash = OPENEPT_EP_HASH(name); \
+                                                 OpenEPT_ED_SetEPHash(openEptEpHash, name, sizeof(name) - 1); } while(0)
+
+/*
+ * Linked energy point descriptors: names placed in the OPENEPT_EP_SECTION linker section.
+ * Wire ID is the offset of the name in the section, tools/epelf rebuilds the ID to name
+ * table from the firmware ELF, so names never leave flash in binary sessions.
+ * OPENEPT_EP_DESCRIPTOR(loopStart, "LStart") declares descriptor loopStart (also at file
+ * scope), OPENEPT_EP_LINKED("LStart") declares and sets up one in place. Requires GCC/Clang;
+ * in C++ OPENEPT_EP_LINKED cannot be used in inline functions or templates.
+ */
+#define OPENEPT_EP_SECTION                  "openept_eps"
+#define OPENEPT_EP_DESCRIPTOR(symbol, name) const char symbol[] __attribute__((section(OPENEPT_EP_SECTION), used, aligned(1))) = name
+#define OPENEPT_EP_LINKED(name)             do { static OPENEPT_EP_DESCRIPTOR(openEptEpDescriptor, name); \
+                                                 OpenEPT_ED_SetEPDescriptor(openEptEpDescriptor); } while(0)
+
+/*
+ * Energy point with arguments formatted on the host, e.g. OPENEPT_EPF("LStart %u", cnt).
+ * Format is a string literal of at most OPENEPT_EP_NAME_MAX characters sent as its hash,
+ * arguments are sent in binary; tools/ephash collects formats for the Acquisition side.
+ * In ASCII sessions the text is formatted on the DUT.
+ */
+#define OPENEPT_EPF_FORMAT(format, ...)     format
+#define OPENEPT_EPF(...)                    OpenEPT_ED_SetEPArgs(OPENEPT_EP_HASH(OPENEPT_EPF_FORMAT(__VA_ARGS__, 0)), __VA_ARGS__)
+
+/*
+ * Region of registered energy point epId that ends when the enclosing block is left, e.g.
+ * { OPENEPT_SCOPE(loopId); ... }, OPENEPT_CTX_SCOPE(ctx, loopId) for another context. The
+ * scope variable keeps the context; failed begin and end are counted, see
+ * OpenEPT_ED_GetScopeErrors. Uses the GCC/Clang cleanup attribute; C++ sources can use
+ * OpenEPT::ScopedEnergyPoint from feplib.hpp instead.
+ */
+#define OPENEPT_SCOPE_VAR_(line)            openEptScope##line
+#define OPENEPT_SCOPE_VAR(line)             OPENEPT_SCOPE_VAR_(line)
+#define OPENEPT_CTX_SCOPE(ctx, epId)        OpenEPT_ED_Scope OPENEPT_SCOPE_VAR(__LINE__) __attribute__((cleanup(OpenEPT_ED_ScopeEnd), unused)) = \
+                                                OpenEPT_ED_Ctx_ScopeBegin(ctx, epId)
+#define OPENEPT_SCOPE(epId)                 OPENEPT_CTX_SCOPE(OpenEPT_ED_GetDefaultContext(), epId)
+
+/* Maximum number of energy point names registered with OpenEPT_ED_RegisterEP */
+#define OPENEPT_CONF_EP_DICTIONARY_SIZE     OPENEPT_ED_CONF_EP_DICTIONARY_SIZE
+
+/* Nesting depth of regions checked by OpenEPT_ED_End */
+#define OPENEPT_CONF_REGION_DEPTH           OPENEPT_ED_CONF_REGION_DEPTH
+
+/* Buffer for encoded OPENEPT_EPF arguments */
+#define OPENEPT_CONF_EP_ARGS_SIZE           OPENEPT_ED_CONF_EP_ARGS_SIZE
+
+/* Size of the buffer used within OpenEPT EP Library to assemble a frame before it is passed to the platform */
+#define OPENEPT_CONF_TRANSMIT_BUFFER_SIZE   OPENEPT_ED_CONF_TRANSMIT_BUFFER_SIZE
+
+/* Event sequence numbers and overflow policy, see OpenEPT_ED_SetOverflowPolicy */
+#define OPENEPT_CONF_EVENT_SEQUENCE         OPENEPT_ED_CONF_EVENT_SEQUENCE
+#define OPENEPT_CONF_OVERFLOW_POLICY        OPENEPT_ED_CONF_OVERFLOW_POLICY
+
+/* Link clock synchronization, see OpenEPT_ED_SetClockPeriod */
+#define OPENEPT_CONF_CLOCK_PERIOD_MS        OPENEPT_ED_CONF_CLOCK_PERIOD_MS
+#define OPENEPT_CONF_CLOCK_FILTER           OPENEPT_ED_CONF_CLOCK_FILTER
+
+/* Event ring for events from interrupts and threads, 0 slots disables it */
+#define OPENEPT_CONF_EVENT_RING_SLOTS       OPENEPT_ED_CONF_EVENT_RING_SLOTS
+#define OPENEPT_CONF_EVENT_RING_SLOT_SIZE   OPENEPT_ED_CONF_EVENT_RING_SLOT_SIZE
+#define OPENEPT_CONF_LOCK_TIMEOUT_MS        OPENEPT_ED_CONF_LOCK_TIMEOUT_MS
+
+/* Per-thread event buffers, see OpenEPT_ED_AttachThread */
+#define OPENEPT_CONF_THREAD_BUFFERS         OPENEPT_ED_CONF_THREAD_BUFFERS
+#define OPENEPT_CONF_THREAD_BUFFER_SLOTS    OPENEPT_ED_CONF_THREAD_BUFFER_SLOTS
+
+/* Event batching, see OpenEPT_ED_SetBatchPolicy */
+#define OPENEPT_CONF_BATCH_BUFFER_SIZE      OPENEPT_ED_CONF_BATCH_BUFFER_SIZE
+#define OPENEPT_CONF_BATCH_SIZE             OPENEPT_ED_CONF_BATCH_SIZE
+#define OPENEPT_CONF_BATCH_AGE_MS           OPENEPT_ED_CONF_BATCH_AGE_MS
+
+/**
+ * @brief One contiguous piece of an outgoing frame.
+ *
+ * Used to hand a frame that is stored in several places (header, energy point name,
+ * terminator) to the transport in a single call without copying it first.
+ */
+typedef struct
+{
+    const uint8_t*  data;
+    uint32_t        size;
+}OpenEPT_ED_Segment;
+
+/**
+ * @brief Queued event (event ring, thread buffers and queueEvent transports).
+ */
+typedef struct
+{
+    uint32_t    sequence;      /* Ring position + 1 when filled, position of its next use when free */
+    uint64_t    timestamp;     /* Taken when the event was set */
+    uint8_t     type;
+    uint8_t     ascii;         /* Set in an ASCII session, payload is the frame content */
+    uint8_t     prefixSize;
+    uint8_t     size;
+    uint8_t     data[OPENEPT_CONF_EVENT_RING_SLOT_SIZE];
+}OpenEPT_ED_RingSlot;
+
+/**
+ * @brief Transport operations table.
+ *
+ * Every operation receives the transport argument given together with the table, so one
+ * implementation can serve several links. Operations marked optional may be NULL.
+ */
+typedef struct
+{
+    int         (*init)(void* arg);                                                         /* Optional */
+    int         (*sendBuffer)(void* arg, const uint8_t* buffer, uint32_t size);
+    int         (*sendSegments)(void* arg, const OpenEPT_ED_Segment* segments, uint32_t count); /* Optional, falls back to sendBuffer */
+    int         (*flush)(void* arg);                                                        /* Optional */
+    int         (*tryRead)(void* arg, char* character);                                     /* Optional, handshake can not complete without it */
+    int         (*syncToggle)(void* arg);                                                   /* Optional */
+    int         (*reconfigure)(void* arg, uint32_t baudrate);                               /* Optional */
+    uint32_t    (*getTickMs)(void* arg);
+    uint64_t    (*getTimestamp)(void* arg);                                                 /* Optional, events are not timestamped without it */
+    uint32_t    (*getTimestampFrequency)(void* arg);                                        /* Optional, Hz; 0 disables timestamps */
+    uint32_t    (*txSpace)(void* arg);                                                      /* Optional, free bytes in transmit queue; overflow policy needs it */
+    int         (*txDiscard)(void* arg);                                                    /* Optional, discard oldest queued frame not being transmitted yet and not protected */
+    void        (*txProtect)(void* arg);                                                    /* Optional, frames queued so far are never discarded */
+    int         (*queueEvent)(void* arg, const OpenEPT_ED_RingSlot* slot);                  /* Optional, hand event to the task that sends it with OpenEPT_ED_Ctx_SendQueued */
+    void        (*drainRequest)(void* arg);                                                 /* Optional, event was queued to the event ring or a thread buffer (from any context, also interrupts); wake the task that drains them with OpenEPT_ED_Ctx_Poll */
+    void        (*lock)(void* arg);                                                         /* Optional, exclusive use of context and transport between tasks */
+    void        (*unlock)(void* arg);                                                       /* Optional */
+}OpenEPT_ED_TransportOps;
+
+/* Overflow policies, see OpenEPT_ED_SetOverflowPolicy */
+#define OPENEPT_ED_OVERFLOW_BLOCK           0   /* Wait until transport has room */
+#define OPENEPT_ED_OVERFLOW_DROP_NEWEST     1   /* Drop event that does not fit */
+#define OPENEPT_ED_OVERFLOW_DROP_OLDEST     2   /* Discard oldest queued frames until event fits */
+#define OPENEPT_ED_OVERFLOW_MARK            3   /* Drop event and queue dropped frame count in its place */
+
+typedef enum
+{
+    OPENEPT_ED_HANDSHAKE_IDLE,
+    OPENEPT_ED_HANDSHAKE_SEND,
+    OPENEPT_ED_HANDSHAKE_WAIT,
+    OPENEPT_ED_HANDSHAKE_BACKOFF
+}OpenEPT_ED_HandshakeState;
+
+typedef enum
+{
+    OPENEPT_ED_HANDSHAKE_STAGE_START,          /* START with offered baud rates */
+    OPENEPT_ED_HANDSHAKE_STAGE_START_LEGACY,   /* Plain START for Acquisition devices without negotiation */
+    OPENEPT_ED_HANDSHAKE_STAGE_CONFIRM,        /* BAUD exchange at the newly selected rate */
+    OPENEPT_ED_HANDSHAKE_STAGE_STOP
+}OpenEPT_ED_HandshakeStage;
+
+/**
+ * @brief START/STOP handshake state machine driven by OpenEPT_ED_Ctx_Poll.
+ */
+typedef struct
+{
+    OpenEPT_ED_HandshakeState   state;
+    OpenEPT_ED_HandshakeStage   stage;
+    int                         result;
+    uint32_t                    baudrate;      /* Link baud rate selected by Acquisition device, 0 for initial rate */
+    const uint8_t*              msg;
+    uint32_t                    msgSize;
+    uint32_t                    received;
+    uint32_t                    attempt;
+    uint32_t                    tick;
+    uint32_t                    currentBackoffMs;
+    uint32_t                    retries;
+    uint32_t                    timeoutMs;
+    uint32_t                    backoffMs;
+}OpenEPT_ED_Handshake;
+
+/**
+ * @brief One ping exchange, times in ns.
+ */
+typedef struct
+{
+    uint64_t    timeNs;        /* DUT time of the exchange (midpoint of ping and pong) */
+    int64_t     offsetNs;      /* Acquisition time minus DUT time */
+    uint32_t    rttNs;         /* Round trip time without Acquisition device processing time */
+}OpenEPT_ED_ClockSample;
+
+/**
+ * @brief Link clock offset and drift estimate, see OpenEPT_ED_GetClock.
+ */
+typedef struct
+{
+    OpenEPT_ED_ClockSample      samples[OPENEPT_CONF_CLOCK_FILTER];    /* Last exchanges, ring indexed by exchange count */
+    uint32_t                    count;         /* Exchanges completed in current session */
+    uint32_t                    periodMs;      /* Time between exchanges after the initial burst, 0 disables pings */
+    uint8_t                     pending;       /* Ping sent and not answered yet */
+    uint64_t                    pingTime;      /* DUT timestamp of pending ping */
+    uint32_t                    pingTick;
+    OpenEPT_ED_ClockSample      estimate;      /* Shortest round trip exchange among samples */
+    OpenEPT_ED_ClockSample      reference;     /* Estimate at the end of the initial burst, drift is measured from it */
+    int32_t                     driftPpb;      /* DUT clock rate error, positive when DUT clock is slow */
+}OpenEPT_ED_Clock;
+
+/**
+ * @brief Private event buffer of one thread, see OpenEPT_ED_AttachThread.
+ */
+typedef struct
+{
+    OpenEPT_ED_RingSlot slots[OPENEPT_CONF_THREAD_BUFFER_SLOTS];
+    uint32_t            head;          /* Next slot to fill, written by the owner thread */
+    uint32_t            tail;          /* Next slot to send, written by the draining thread */
+    uint32_t            dropped;       /* Events not queued because the buffer was full */
+    uint32_t            droppedReported;   /* Dropped count already added to the context */
+    const void*         ctx;           /* Context the buffer is attached to */
+}OpenEPT_ED_ThreadBuffer;
+
+/**
+ * @brief State of one EP link.
+ *
+ * Holds the transport, buffers and session state of one link to an Acquisition device.
+ * Fields are managed by the library and should not be accessed directly.
+ */
+typedef struct
+{
+    const OpenEPT_ED_TransportOps*  ops;
+    void*                           arg;
+    OpenEPT_ED_Handshake            handshake;
+    uint8_t                         protocol;      /* Binary protocol version selected in START, 0 for ASCII */
+    uint32_t                        timebase;      /* Event timestamp frequency of current session, 0 if events are not timestamped */
+    OpenEPT_ED_Segment              dictionary[OPENEPT_CONF_EP_DICTIONARY_SIZE];   /* Registered EP names, index is EP ID */
+    uint32_t                        dictionarySize;
+    uint32_t                        regions[OPENEPT_CONF_REGION_DEPTH];            /* EP IDs of open regions, outermost first */
+    uint32_t                        regionDepth;   /* Number of open regions, may exceed OPENEPT_CONF_REGION_DEPTH */
+    uint32_t                        scopeErrors;   /* Failed begin and end of OPENEPT_SCOPE regions */
+    uint8_t                         receiveBuffer[OPENEPT_CONF_RECEIVE_BUFFER_SIZE];
+    uint8_t                         transmitBuffer[OPENEPT_CONF_TRANSMIT_BUFFER_SIZE];
+    uint8_t                         batch[OPENEPT_CONF_BATCH_BUFFER_SIZE + 4];     /* Batched records from batch[1], room for COBS code, CRC and delimiter */
+    uint32_t                        batchUsed;
+    uint32_t                        batchSize;     /* Batch is sent when it reaches this size, 0 disables batching */
+    uint32_t                        batchAgeMs;    /* Batch is sent when the oldest event is this old, 0 for no limit */
+    uint32_t                        batchTick;     /* Tick of the oldest batched event */
+    uint32_t                        overflowPolicy;
+    uint32_t                        sequence;      /* Sequence number of the next event */
+    uint32_t                        session;       /* Binary sessions started, integrations resend their tables when it changes */
+    uint32_t                        dropped;       /* Frames dropped in current session */
+    uint32_t                        droppedReported;   /* Dropped frame count last sent to Acquisition device */
+    OpenEPT_ED_Clock                clock;
+    uint32_t                        queueDropped;  /* Events the transport queue (queueEvent) did not take */
+#if OPENEPT_CONF_EVENT_RING_SLOTS != 0
+    OpenEPT_ED_RingSlot             ring[OPENEPT_CONF_EVENT_RING_SLOTS];
+    uint32_t                        ringHead;      /* Next position to reserve, shared by all producers */
+    uint32_t                        ringTail;      /* Next position to send, owned by the context holding ringLock */
+    uint32_t                        ringLock;      /* Set while a context uses the transport */
+    uint32_t                        ringDropped;   /* Events not queued because the ring was full */
+#endif
+#if OPENEPT_CONF_THREAD_BUFFERS != 0
+    OpenEPT_ED_ThreadBuffer*        threads[OPENEPT_CONF_THREAD_BUFFERS];
+    uint32_t                        threadCount;
+#endif
+}OpenEPT_ED_Context;
+
+/**
+ * @brief Region opened by OPENEPT_SCOPE, ended by OpenEPT_ED_ScopeEnd.
+ */
+typedef struct
+{
+    OpenEPT_ED_Context*     ctx;
+    uint32_t                epId;
+    uint8_t                 open;          /* Region was opened and not ended yet */
+}OpenEPT_ED_Scope;
+
+/**
+ * @brief RAM buffer transport argument.
+ *
+ * Frames are appended to buffer until it is full; used counts stored bytes. Free space is
+ * reported to the overflow policy, which may discard the oldest stored event frames.
+ */
+typedef struct
+{
+    uint8_t*    buffer;
+    uint32_t    size;
+    uint32_t    used;
+    uint32_t    protect;       /* Stored bytes that are never discarded (definitions, control frames) */
+}OpenEPT_ED_MemoryTransport;
+
+/* Transport over OpenEPT_ED_Platform_* functions, used by the default context */
+extern const OpenEPT_ED_TransportOps OpenEPT_ED_PlatformTransportOps;
+/* Transport that stores frames into RAM, argument is OpenEPT_ED_MemoryTransport */
+extern const OpenEPT_ED_TransportOps OpenEPT_ED_MemoryTransportOps;
+
 /**
  * @brief Initializes the OpenEPT Embedded Device.
  *
@@ -38,21 +353,56 @@ extern "C" {
  */
 int OpenEPT_ED_Init();
 
+/**
+ * @brief Set START/STOP handshake retry policy.
+ *
+ * When the Acquisition device does not respond within timeoutMs, the command is sent again
+ * after a backoff delay. The delay starts at backoffMs and doubles on every resend up to
+ * OPENEPT_CONF_HANDSHAKE_BACKOFF_MAX_MS. Takes effect with the next handshake.
+ *
+ * @param retries Number of resends before handshake fails, 0 to resend forever.
+ * @param timeoutMs Time to wait for response to one command.
+ * @param backoffMs Delay before the first resend.
+ */
+void OpenEPT_ED_SetHandshakePolicy(uint32_t retries, uint32_t timeoutMs, uint32_t backoffMs);
+
 /**
  * @brief Start EP link for communication with Acqusition Device.
  *
  * Initiates communication with the OpenEPT Acquisition device by sending a "START" command.
- * This function waits for a response from the acquisition device to confirm the connection.
+ * This function waits for a response from the acquisition device to confirm the connection,
+ * resending the command according to the handshake retry policy.
+ *
+ * When OPENEPT_CONF_LINK_BAUDRATES lists rates, "START" offers them and the Acquisition
+ * device may answer "OK BAUD=<rate>". Both sides then switch to that rate and confirm it
+ * with a "BAUD" exchange; if the confirmation fails both return to the initial rate.
+ * An Acquisition device that rejects the offer is started with plain "START".
  *
  * @return OPEN_EPT_STATUS_OK if communication is successful established,
- *         OPEN_EPT_STATUS_ERROR if there is no response from Acquistion device.
+ *         OPEN_EPT_STATUS_ERROR if Acquistion device rejects the command,
+ *         OPEN_EPT_STATUS_TIMEOUT if there is no response from Acquistion device.
  */
 int OpenEPT_ED_Start();
 
+/**
+ * @brief Begin starting EP link without waiting for response.
+ *
+ * Arms the handshake state machine with "START" command and returns immediately. The
+ * command is sent and the response collected by subsequent OpenEPT_ED_Poll calls, so the
+ * firmware can continue booting while the link comes up.
+ *
+ * @return OPEN_EPT_STATUS_OK if handshake is armed,
+ *         OPEN_EPT_STATUS_ERROR if another handshake is in progress.
+ */
+int OpenEPT_ED_StartAsync();
+
 /**
  * @brief Stop EP link.
  *
  * Stop communication with the OpenEPT Acquisition device by sending a "STOP" command.
+ * Once accepted, a negotiated link baud rate is returned to the initial one.
+ * Data still queued by a buffered platform transport is flushed first, so every energy
+ * point set before this call reaches the Acquisition device ahead of "STOP".
  * This function waits for a response from the acquisition device to confirm the Acqusition
  * device successsfully receive this command.
  *
@@ -61,11 +411,40 @@ int OpenEPT_ED_Start();
  */
 int OpenEPT_ED_Stop();
 
+/**
+ * @brief Begin stopping EP link without waiting for response.
+ *
+ * Flushes queued data and arms the handshake state machine with "STOP" command. The
+ * handshake is completed by subsequent OpenEPT_ED_Poll calls. Nothing is sent while another
+ * handshake is in progress, and STOP is not armed when batched events or the session end
+ * can not be sent; call it again to retry.
+ *
+ * @return OPEN_EPT_STATUS_OK if handshake is armed,
+ *         OPEN_EPT_STATUS_ERROR if another handshake is in progress, or sending or flush fails.
+ */
+int OpenEPT_ED_StopAsync();
+
+/**
+ * @brief Advance START/STOP handshake state machine.
+ *
+ * Sends pending command, collects available response characters without blocking and
+ * handles response timeout, backoff and resend. Call it periodically (e.g. from main loop)
+ * after OpenEPT_ED_StartAsync or OpenEPT_ED_StopAsync. With the event ring it is also the
+ * drain: events queued by interrupts and threads are sent here.
+ *
+ * @return OPEN_EPT_STATUS_PENDING while handshake is in progress,
+ *         OPEN_EPT_STATUS_OK if the last handshake succeeded (or none was started),
+ *         OPEN_EPT_STATUS_ERROR if Acquistion device rejected the command,
+ *         OPEN_EPT_STATUS_TIMEOUT if all attempts are used without response, or another
+ *         thread held the transport for OPENEPT_CONF_LOCK_TIMEOUT_MS (event ring).
+ */
+int OpenEPT_ED_Poll();
+
 /**
  * @brief Sets up a communication energy point.
  *
- * This function configures a communication energy point by sending its name character by
- * character to the platform. It adds a carriage return ('\r') after the energy point
+ * This function configures a communication energy point by sending its name to the
+ * platform as a single frame. It adds a carriage return ('\r') after the energy point
  * name and performs synchronization before sending the data (SYNC  is toggled before 
  * energy point name is transmited over serial interface)
  *
@@ -87,6 +466,339 @@ int OpenEPT_ED_SetEPFast(uint8_t* epName, uint32_t epNameSize);
  */
 int OpenEPT_ED_SendInfo(const char* message);
 
+/**
+ * @brief Registers energy point name and assigns it an ID.
+ *
+ * With binary protocol the table of registered names is sent once per session, right after
+ * START, and OpenEPT_ED_SetEP sends only the ID. Names registered during a session are sent
+ * when registered. Registering the same name again returns the same ID. Tasks may register
+ * concurrently, the table is changed with the context lock held.
+ *
+ * @param epName Null terminated name, must stay valid while it is registered (e.g. literal).
+ * @param epId Assigned ID.
+ * @return OPEN_EPT_STATUS_OK on success,
+ *         OPEN_EPT_STATUS_ERROR if OPENEPT_CONF_EP_DICTIONARY_SIZE names are already registered
+ *         or the definition can not be sent,
+ *         OPEN_EPT_STATUS_TIMEOUT if another thread held the transport for
+ *         OPENEPT_CONF_LOCK_TIMEOUT_MS (event ring); nothing was registered.
+ */
+int OpenEPT_ED_RegisterEP(const char* epName, uint32_t* epId);
+
+/**
+ * @brief Sets up registered energy point.
+ *
+ * Same as OpenEPT_ED_SetEPFast, but sends only the ID assigned by OpenEPT_ED_RegisterEP.
+ * When Acquisition device uses ASCII protocol the name is sent instead.
+ *
+ * @param epId Energy point ID.
+ * @return OPEN_EPT_STATUS_OK on successful setup,
+ *         OPEN_EPT_STATUS_ERROR on failure or unknown ID.
+ */
+int OpenEPT_ED_SetEP(uint32_t epId);
+
+/**
+ * @brief Sets up energy point identified by compile-time name hash.
+ *
+ * Use through OPENEPT_EP. With binary protocol only the 32 bit hash is sent, so the cost does
+ * not depend on the name length; with ASCII protocol the name is sent.
+ *
+ * @param epHash OPENEPT_EP_HASH of the name.
+ * @param epName Energy point name.
+ * @param epNameSize Size of the energy point name in bytes.
+ * @return OPEN_EPT_STATUS_OK on successful setup,
+ *         OPEN_EPT_STATUS_ERROR on failure.
+ */
+int OpenEPT_ED_SetEPHash(uint32_t epHash, const char* epName, uint32_t epNameSize);
+
+/**
+ * @brief Sets up energy point declared with OPENEPT_EP_DESCRIPTOR.
+ *
+ * With binary protocol only the offset of the descriptor in OPENEPT_EP_SECTION is sent; with
+ * ASCII protocol the name is read from the descriptor and sent.
+ *
+ * @param epDescriptor Descriptor declared with OPENEPT_EP_DESCRIPTOR.
+ * @return OPEN_EPT_STATUS_OK on successful setup,
+ *         OPEN_EPT_STATUS_ERROR on failure or if descriptor is not in OPENEPT_EP_SECTION.
+ */
+int OpenEPT_ED_SetEPDescriptor(const char* epDescriptor);
+
+/**
+ * @brief Sets up energy point with arguments formatted on the host.
+ *
+ * Use through OPENEPT_EPF. With binary protocol the format hash and arguments are sent
+ * (see OpenEPT_ED_Protocol_EncodeArgs for supported conversions), no text is formatted on
+ * the DUT; with ASCII protocol formatted text is sent.
+ *
+ * @param fmtId OPENEPT_EP_HASH of the format.
+ * @param format printf format.
+ * @return OPEN_EPT_STATUS_OK on successful setup,
+ *         OPEN_EPT_STATUS_ERROR on failure.
+ */
+int OpenEPT_ED_SetEPArgs(uint32_t fmtId, const char* format, ...);
+
+/**
+ * @brief Sets up energy point with already encoded arguments.
+ *
+ * Used by the C++ OPENEPT_EPF, which encodes arguments by their type at compile time.
+ *
+ * @param fmtId OPENEPT_EP_HASH of the format.
+ * @param format printf format, used in ASCII sessions.
+ * @param args Arguments encoded with OpenEPT_ED_Protocol_PutArg* functions.
+ * @param argsSize Size of encoded arguments.
+ * @return OPEN_EPT_STATUS_OK on successful setup,
+ *         OPEN_EPT_STATUS_ERROR on failure.
+ */
+int OpenEPT_ED_SetEPArgsEncoded(uint32_t fmtId, const char* format, const uint8_t* args, uint32_t argsSize);
+
+/**
+ * @brief Begins region of registered energy point.
+ *
+ * Regions nest: every region begun inside another one must end before it. With binary
+ * protocol the region record carries the nesting depth, so the Acquisition device pairs
+ * begin and end and attributes energy to regions inclusive and exclusive of nested ones.
+ * With ASCII protocol the name is sent, like OpenEPT_ED_SetEP. Regions stay open across
+ * sessions.
+ *
+ * @param epId Energy point ID assigned by OpenEPT_ED_RegisterEP.
+ * @return OPEN_EPT_STATUS_OK on success,
+ *         OPEN_EPT_STATUS_ERROR on failure or unknown ID; region is open also if sending failed.
+ */
+int OpenEPT_ED_Begin(uint32_t epId);
+
+/**
+ * @brief Ends the innermost open region.
+ *
+ * @param epId Energy point ID the region was begun with.
+ * @return OPEN_EPT_STATUS_OK on success,
+ *         OPEN_EPT_STATUS_ERROR on failure, or if epId does not match the innermost region
+ *         (regions are left unchanged then).
+ */
+int OpenEPT_ED_End(uint32_t epId);
+
+/* OPENEPT_SCOPE helpers: begin region and return the scope, end region of the scope variable */
+OpenEPT_ED_Scope OpenEPT_ED_ScopeBegin(uint32_t epId);
+void OpenEPT_ED_ScopeEnd(OpenEPT_ED_Scope* scope);
+
+/**
+ * @brief Get number of failed region begins and ends of OPENEPT_SCOPE.
+ *
+ * Scope cleanup can not return a status, so failures are counted instead: unknown ID, end
+ * that does not match the innermost region, or sending failed.
+ *
+ * @return Failure count since the context was initialized.
+ */
+uint32_t OpenEPT_ED_GetScopeErrors();
+
+/**
+ * @brief Set event batching policy.
+ *
+ * In binary sessions events are collected in RAM and sent together in one frame, which
+ * saves framing overhead and lets the transport send long bursts. Event timestamps keep
+ * the timing. Batch is sent when it reaches size bytes, when the oldest event is maxAgeMs
+ * old (checked on every event and in OpenEPT_ED_Poll), on OpenEPT_ED_Flush and before STOP.
+ * Events that do not fit into an empty batch are sent on their own. Pending batch is sent
+ * before the policy changes.
+ *
+ * @param size Batch size in bytes, at most OPENEPT_CONF_BATCH_BUFFER_SIZE; 0 disables batching.
+ * @param maxAgeMs Maximum age of batched event, 0 for no limit.
+ * @return OPEN_EPT_STATUS_OK on success,
+ *         OPEN_EPT_STATUS_ERROR if pending batch could not be sent.
+ */
+int OpenEPT_ED_SetBatchPolicy(uint32_t size, uint32_t maxAgeMs);
+
+/**
+ * @brief Send batched events.
+ *
+ * Hands pending batch to the transport, after the events queued in the event ring and in
+ * thread buffers; does not wait for the transport to send it.
+ *
+ * @return OPEN_EPT_STATUS_OK on success or if nothing is batched,
+ *         OPEN_EPT_STATUS_ERROR on transmission error,
+ *         OPEN_EPT_STATUS_TIMEOUT if another thread held the transport for
+ *         OPENEPT_CONF_LOCK_TIMEOUT_MS (event ring); nothing was sent.
+ */
+int OpenEPT_ED_Flush();
+
+/**
+ * @brief Set what happens to an event that does not fit into transport transmit queue.
+ *
+ * Applies to events of binary sessions on transports that report free queue space
+ * (buffered platform ports and the RAM buffer transport); others always wait. Every dropped
+ * or discarded frame is counted and the session total is sent in a dropped record, with
+ * the next event or right away for OPENEPT_ED_OVERFLOW_MARK, and always before STOP.
+ * Together with event sequence numbers the Acquisition device knows which events are lost.
+ * Only event frames are discarded: definitions and other frames that later events depend on
+ * are protected (txProtect), and while one of them is queued the oldest events wait instead.
+ *
+ * @param policy One of OPENEPT_ED_OVERFLOW_* policies.
+ * @return OPEN_EPT_STATUS_OK on success,
+ *         OPEN_EPT_STATUS_ERROR if policy is not known.
+ */
+int OpenEPT_ED_SetOverflowPolicy(uint32_t policy);
+
+/**
+ * @brief Get number of frames dropped in current session.
+ *
+ * @return Dropped frame count, reset when a session starts.
+ */
+uint32_t OpenEPT_ED_GetDropped();
+
+/**
+ * @brief Set period of link clock synchronization exchanges.
+ *
+ * In binary sessions with event timestamps the DUT sends a ping with its timestamp right
+ * after START and then from OpenEPT_ED_Poll; the Acquisition device answers with the times
+ * it received the ping and sent the answer. Like NTP, the library estimates the offset of
+ * Acquisition time to DUT time from the exchange with the shortest round trip, and the drift
+ * between both clocks from how that offset changes. Every estimate is also sent in a clock
+ * record, so markers are aligned to the trace even when their frames arrive late. Answers
+ * are read in OpenEPT_ED_Poll, so call it often for short round trips.
+ *
+ * @param periodMs Time between exchanges, 0 disables them.
+ * @return OPEN_EPT_STATUS_OK.
+ */
+int OpenEPT_ED_SetClockPeriod(uint32_t periodMs);
+
+/**
+ * @brief Get link clock estimate of current session.
+ *
+ * Acquisition time of DUT time t is t + offsetNs + (t - T) * driftPpb / 10^9, T being the DUT
+ * time of the estimate (sent in the clock record).
+ *
+ * @param offsetNs Acquisition time minus DUT time.
+ * @param rttNs Round trip time of the exchange the estimate comes from, bound of offset error.
+ * @param driftPpb Drift of DUT clock, 0 until exchanges span enough time to know it within 10 ppm.
+ * @return OPEN_EPT_STATUS_OK on success,
+ *         OPEN_EPT_STATUS_ERROR if no exchange is completed in current session.
+ */
+int OpenEPT_ED_GetClock(int64_t* offsetNs, uint32_t* rttNs, int32_t* driftPpb);
+
+/**
+ * @brief Give the calling thread its own event buffer.
+ *
+ * Events the thread sets afterwards are copied into the buffer instead of being sent, so
+ * threads emitting at high rates do not contend for the transport. OpenEPT_ED_Poll,
+ * OpenEPT_ED_Flush and OpenEPT_ED_Stop send buffered events of all threads, merged by
+ * timestamp; call them from one thread. A full buffer drops the event and counts it with the
+ * dropped frames, as do events larger than OPENEPT_CONF_EVENT_RING_SLOT_SIZE. The buffer is
+ * found through OpenEPT_ED_Platform_SetThreadBuffer, so a thread has one buffer for one
+ * context, and it must stay valid as long as the context is used.
+ *
+ * @param buffer Buffer of the calling thread.
+ * @return OPEN_EPT_STATUS_OK on success,
+ *         OPEN_EPT_STATUS_ERROR if OPENEPT_CONF_THREAD_BUFFERS threads are already attached.
+ */
+int OpenEPT_ED_AttachThread(OpenEPT_ED_ThreadBuffer* buffer);
+
+/**
+ * @brief Get default context.
+ *
+ * Returns the context used by the functions without context argument, e.g. to switch
+ * its transport with OpenEPT_ED_Ctx_SetTransport.
+ *
+ * @return Default context.
+ */
+OpenEPT_ED_Context* OpenEPT_ED_GetDefaultContext();
+
+/**
+ * @brief Initializes EP link context.
+ *
+ * Resets context state and initializes the transport (ops->init, when provided).
+ *
+ * @param ctx Context to initialize.
+ * @param ops Transport operations.
+ * @param arg Transport argument passed to every operation.
+ * @return OPEN_EPT_STATUS_OK on successful initialization,
+ *         OPEN_EPT_STATUS_ERROR on failure.
+ */
+int OpenEPT_ED_Ctx_Init(OpenEPT_ED_Context* ctx, const OpenEPT_ED_TransportOps* ops, void* arg);
+
+/**
+ * @brief Replace transport of EP link context at run time.
+ *
+ * Session state is kept; the new transport is not initialized. Must not be called while
+ * a handshake is in progress.
+ *
+ * @param ctx Context.
+ * @param ops Transport operations.
+ * @param arg Transport argument passed to every operation.
+ * @return OPEN_EPT_STATUS_OK if transport is replaced,
+ *         OPEN_EPT_STATUS_ERROR if a handshake is in progress.
+ */
+int OpenEPT_ED_Ctx_SetTransport(OpenEPT_ED_Context* ctx, const OpenEPT_ED_TransportOps* ops, void* arg);
+
+/* Context variants of the functions above, see their descriptions */
+void OpenEPT_ED_Ctx_SetHandshakePolicy(OpenEPT_ED_Context* ctx, uint32_t retries, uint32_t timeoutMs, uint32_t backoffMs);
+int OpenEPT_ED_Ctx_Start(OpenEPT_ED_Context* ctx);
+int OpenEPT_ED_Ctx_StartAsync(OpenEPT_ED_Context* ctx);
+int OpenEPT_ED_Ctx_Stop(OpenEPT_ED_Context* ctx);
+int OpenEPT_ED_Ctx_StopAsync(OpenEPT_ED_Context* ctx);
+int OpenEPT_ED_Ctx_Poll(OpenEPT_ED_Context* ctx);
+int OpenEPT_ED_Ctx_SetEPFast(OpenEPT_ED_Context* ctx, uint8_t* epName, uint32_t epNameSize);
+int OpenEPT_ED_Ctx_SendInfo(OpenEPT_ED_Context* ctx, const char* message);
+int OpenEPT_ED_Ctx_RegisterEP(OpenEPT_ED_Context* ctx, const char* epName, uint32_t* epId);
+int OpenEPT_ED_Ctx_SetEP(OpenEPT_ED_Context* ctx, uint32_t epId);
+int OpenEPT_ED_Ctx_SetEPHash(OpenEPT_ED_Context* ctx, uint32_t epHash, const char* epName, uint32_t epNameSize);
+int OpenEPT_ED_Ctx_SetEPDescriptor(OpenEPT_ED_Context* ctx, const char* epDescriptor);
+int OpenEPT_ED_Ctx_SetEPArgs(OpenEPT_ED_Context* ctx, uint32_t fmtId, const char* format, ...);
+int OpenEPT_ED_Ctx_SetEPArgsEncoded(OpenEPT_ED_Context* ctx, uint32_t fmtId, const char* format, const uint8_t* args, uint32_t argsSize);
+int OpenEPT_ED_Ctx_Begin(OpenEPT_ED_Context* ctx, uint32_t epId);
+int OpenEPT_ED_Ctx_End(OpenEPT_ED_Context* ctx, uint32_t epId);
+OpenEPT_ED_Scope OpenEPT_ED_Ctx_ScopeBegin(OpenEPT_ED_Context* ctx, uint32_t epId);
+uint32_t OpenEPT_ED_Ctx_GetScopeErrors(OpenEPT_ED_Context* ctx);
+int OpenEPT_ED_Ctx_SetBatchPolicy(OpenEPT_ED_Context* ctx, uint32_t size, uint32_t maxAgeMs);
+int OpenEPT_ED_Ctx_Flush(OpenEPT_ED_Context* ctx);
+int OpenEPT_ED_Ctx_SetOverflowPolicy(OpenEPT_ED_Context* ctx, uint32_t policy);
+uint32_t OpenEPT_ED_Ctx_GetDropped(OpenEPT_ED_Context* ctx);
+int OpenEPT_ED_Ctx_SetClockPeriod(OpenEPT_ED_Context* ctx, uint32_t periodMs);
+int OpenEPT_ED_Ctx_GetClock(OpenEPT_ED_Context* ctx, int64_t* offsetNs, uint32_t* rttNs, int32_t* driftPpb);
+int OpenEPT_ED_Ctx_AttachThread(OpenEPT_ED_Context* ctx, OpenEPT_ED_ThreadBuffer* buffer);
+
+/**
+ * @brief Send event queued by the queueEvent operation of the context transport.
+ *
+ * Called by the task that owns the transport, with every event it takes from its queue.
+ * Events the queue did not take are counted as dropped frames before it is sent. The
+ * transport lock operation runs before control frames (STOP, flush, poll), so it can wait
+ * until queued events are sent.
+ *
+ * @param ctx Context.
+ * @param slot Queued event, NULL to only report dropped events.
+ * @return OPEN_EPT_STATUS_OK on success,
+ *         OPEN_EPT_STATUS_ERROR on transmission error.
+ */
+int OpenEPT_ED_Ctx_SendQueued(OpenEPT_ED_Context* ctx, const OpenEPT_ED_RingSlot* slot);
+
+/**
+ * @brief Send task switch recorded by an RTOS context switch hook.
+ *
+ * Task switch events carry the task ID only, names come with OpenEPT_ED_Ctx_DefineTask.
+ * The Acquisition device attributes the trace from one switch to the next to the task
+ * switched in. Switches are sent in binary sessions only; called by the task that owns the
+ * transport, like OpenEPT_ED_Ctx_SendQueued.
+ *
+ * @param ctx Context.
+ * @param timestamp Time of the switch, from the timestamp source of the context.
+ * @param taskId Task ID, 0 for a task without ID.
+ * @return OPEN_EPT_STATUS_OK if the switch is sent or there is no binary session,
+ *         OPEN_EPT_STATUS_ERROR on transmission error.
+ */
+int OpenEPT_ED_Ctx_SendTask(OpenEPT_ED_Context* ctx, uint64_t timestamp, uint32_t taskId);
+
+/**
+ * @brief Send task definition record "<varint id><name>".
+ *
+ * Sent once per session for every task before its first switch; compare ctx->session
+ * to find out when a new session needs the table again.
+ *
+ * @param ctx Context.
+ * @param taskId Task ID.
+ * @param name Task name.
+ * @return OPEN_EPT_STATUS_OK if the definition is sent or there is no binary session,
+ *         OPEN_EPT_STATUS_ERROR on transmission error.
+ */
+int OpenEPT_ED_Ctx_DefineTask(OpenEPT_ED_Context* ctx, uint32_t taskId, const char* name);
+
 #ifdef __cplusplus
 }
 #endif
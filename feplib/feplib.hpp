@@ -0,0 +1,159 @@
+/**
+ * @file feplib.hpp
+ * @brief C++ helpers for the OpenEPT Embedded Device (ED) library.
+ *
+ * Include instead of feplib.h in C++ sources. Energy point name hashes are computed by a
+ * constexpr (consteval with C++20) function, so OPENEPT_EP_HASH is a constant expression
+ * and OPENEPT_EP emits a constant ID. OPENEPT_EPF encodes arguments by their type at compile
+ * time and checks their number against the format. ScopedEnergyPoint ends a region when it
+ * goes out of scope.
+ *
+ * @date November 3, 2024
+ * @author Dimitrije Lilic, Haris Turkmanovic
+ */
+
+#ifndef OPENEPT_ED_HPP_
+#define OPENEPT_ED_HPP_
+
+#include "feplib.h"
+#include "protocol.h"
+
+#if defined(__cpp_consteval)
+#define OPENEPT_CONSTEVAL                   consteval
+#else
+#define OPENEPT_CONSTEVAL                   constexpr
+#endif
+
+namespace OpenEPT
+{
+
+/**
+ * @brief 32 bit FNV-1a hash of energy point name, same value as the C OPENEPT_EP_HASH.
+ */
+OPENEPT_CONSTEVAL uint32_t Hash(const char* name, uint32_t hash = OPENEPT_EP_HASH_BASIS)
+{
+    return *name == '\0' ? hash : Hash(name + 1, (hash ^ static_cast<uint8_t>(*name)) * OPENEPT_EP_HASH_PRIME);
+}
+
+OPENEPT_CONSTEVAL uint32_t NameSize(const char* name, uint32_t size = 0)
+{
+    return *name == '\0' ? size : NameSize(name + 1, size + 1);
+}
+
+/* Forces hash evaluation at compile time also where a constexpr call could run at run time */
+template<uint32_t hash>
+struct EPHash
+{
+    static constexpr uint32_t value = hash;
+};
+
+/* Number of arguments taken by printf format, "%%" takes none */
+OPENEPT_CONSTEVAL uint32_t ArgCount(const char* format, uint32_t count = 0)
+{
+    return *format == '\0' ? count :
+           *format != '%' ? ArgCount(format + 1, count) :
+           format[1] == '%' ? ArgCount(format + 2, count) : ArgCount(format + 1, count + 1);
+}
+
+/* Argument encoders selected by type, return 0 when the argument does not fit */
+inline uint32_t PutArg(uint8_t* buffer, uint32_t size, long long value)
+{
+    return size < OPENEPT_ED_PROTOCOL_ARG_MAX_SIZE ? 0 : OpenEPT_ED_Protocol_PutArgSigned(buffer, value);
+}
+inline uint32_t PutArg(uint8_t* buffer, uint32_t size, unsigned long long value)
+{
+    return size < OPENEPT_ED_PROTOCOL_ARG_MAX_SIZE ? 0 : OpenEPT_ED_Protocol_PutArgUnsigned(buffer, value);
+}
+inline uint32_t PutArg(uint8_t* buffer, uint32_t size, double value)
+{
+    return size < OPENEPT_ED_PROTOCOL_ARG_MAX_SIZE ? 0 : OpenEPT_ED_Protocol_PutArgFloat(buffer, static_cast<float>(value));
+}
+inline uint32_t PutArg(uint8_t* buffer, uint32_t size, const char* value)
+{
+    return size < 2 ? 0 : OpenEPT_ED_Protocol_PutArgString(buffer, size, value);
+}
+inline uint32_t PutArg(uint8_t* buffer, uint32_t size, const void* value)
+{
+    return PutArg(buffer, size, static_cast<unsigned long long>(reinterpret_cast<uintptr_t>(value)));
+}
+inline uint32_t PutArg(uint8_t* buffer, uint32_t size, signed char value) { return PutArg(buffer, size, static_cast<long long>(value)); }
+inline uint32_t PutArg(uint8_t* buffer, uint32_t size, short value) { return PutArg(buffer, size, static_cast<long long>(value)); }
+inline uint32_t PutArg(uint8_t* buffer, uint32_t size, int value) { return PutArg(buffer, size, static_cast<long long>(value)); }
+inline uint32_t PutArg(uint8_t* buffer, uint32_t size, long value) { return PutArg(buffer, size, static_cast<long long>(value)); }
+inline uint32_t PutArg(uint8_t* buffer, uint32_t size, bool value) { return PutArg(buffer, size, static_cast<unsigned long long>(value)); }
+inline uint32_t PutArg(uint8_t* buffer, uint32_t size, char value) { return PutArg(buffer, size, static_cast<unsigned long long>(static_cast<unsigned char>(value))); }
+inline uint32_t PutArg(uint8_t* buffer, uint32_t size, unsigned char value) { return PutArg(buffer, size, static_cast<unsigned long long>(value)); }
+inline uint32_t PutArg(uint8_t* buffer, uint32_t size, unsigned short value) { return PutArg(buffer, size, static_cast<unsigned long long>(value)); }
+inline uint32_t PutArg(uint8_t* buffer, uint32_t size, unsigned int value) { return PutArg(buffer, size, static_cast<unsigned long long>(value)); }
+inline uint32_t PutArg(uint8_t* buffer, uint32_t size, unsigned long value) { return PutArg(buffer, size, static_cast<unsigned long long>(value)); }
+inline uint32_t PutArg(uint8_t* buffer, uint32_t size, float value) { return PutArg(buffer, size, static_cast<double>(value)); }
+inline uint32_t PutArg(uint8_t* buffer, uint32_t size, char* value) { return PutArg(buffer, size, static_cast<const char*>(value)); }
+
+inline uint32_t EncodeArgs(uint8_t* buffer, uint32_t size)
+{
+    (void)buffer;
+    (void)size;
+    return 0;
+}
+
+template<typename T, typename... Rest>
+inline uint32_t EncodeArgs(uint8_t* buffer, uint32_t size, T value, Rest... rest)
+{
+    uint32_t used = PutArg(buffer, size, value);
+    //Arguments after the first one that does not fit are dropped too
+    if(used == 0) return 0;
+    return used + EncodeArgs(buffer + used, size - used, rest...);
+}
+
+/**
+ * @brief Region of registered energy point that ends when the object goes out of scope.
+ *
+ *     OpenEPT::ScopedEnergyPoint loop(loopId);
+ */
+class ScopedEnergyPoint
+{
+public:
+    explicit ScopedEnergyPoint(uint32_t epId, OpenEPT_ED_Context* ctx = OpenEPT_ED_GetDefaultContext())
+        : ctx(ctx), epId(epId)
+    {
+        OpenEPT_ED_Ctx_Begin(ctx, epId);
+    }
+
+    ~ScopedEnergyPoint()
+    {
+        OpenEPT_ED_Ctx_End(ctx, epId);
+    }
+
+    ScopedEnergyPoint(const ScopedEnergyPoint&) = delete;
+    ScopedEnergyPoint& operator=(const ScopedEnergyPoint&) = delete;
+
+private:
+    OpenEPT_ED_Context* ctx;
+    uint32_t epId;
+};
+
+/**
+ * @brief Sets up energy point with arguments formatted on the host, use through OPENEPT_EPF.
+ */
+template<uint32_t count, uint32_t fmtId, typename... Args>
+inline int SetEPArgs(const char* format, Args... args)
+{
+    static_assert(count == sizeof...(Args), "number of OPENEPT_EPF arguments does not match format");
+    uint8_t buffer[OPENEPT_CONF_EP_ARGS_SIZE];
+    return OpenEPT_ED_SetEPArgsEncoded(fmtId, format, buffer, EncodeArgs(buffer, sizeof(buffer), args...));
+}
+
+}
+
+#undef OPENEPT_EP_HASH
+#define OPENEPT_EP_HASH(name)               (::OpenEPT::EPHash< ::OpenEPT::Hash(name)>::value)
+
+#undef OPENEPT_EPF
+#define OPENEPT_EPF(...)                    (::OpenEPT::SetEPArgs< ::OpenEPT::ArgCount(OPENEPT_EPF_FORMAT(__VA_ARGS__, 0)), \
+                                                                 OPENEPT_EP_HASH(OPENEPT_EPF_FORMAT(__VA_ARGS__, 0))>(__VA_ARGS__))
+
+#undef OPENEPT_EP
+#define OPENEPT_EP(name)                    do { static_assert(::OpenEPT::NameSize(name) <= OPENEPT_EP_NAME_MAX, "energy point name too long"); \
+                                                 OpenEPT_ED_SetEPHash(OPENEPT_EP_HASH(name), name, sizeof(name) - 1); } while(0)
+
+#endif
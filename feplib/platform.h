@@ -1,22 +1,129 @@
 #ifndef PLATFOM_H_
 #define PLATFOM_H_
 
+#include <stdint.h>
+#include "feplib.h"
 
 #define OPEN_EPT_STATUS_OK                  0
 #define OPEN_EPT_STATUS_ERROR               1
 
+/* Transmit ring overflow policies (see OPENEPT_ED_CONF_TX_OVERFLOW_POLICY) */
+#define OPENEPT_ED_TX_OVERFLOW_BLOCK        0
+#define OPENEPT_ED_TX_OVERFLOW_DROP         1
+
+/* Marks default platform functions that a port may override with its own definition */
+#if defined(__CC_ARM) || defined(__ICCARM__)
+#define OPENEPT_ED_PLATFORM_WEAK            __weak
+#else
+#define OPENEPT_ED_PLATFORM_WEAK            __attribute__((weak))
+#endif
+
 
 #ifdef __cplusplus
 extern "C" {
 #endif
+
+/* One contiguous piece of an outgoing frame */
+typedef OpenEPT_ED_Segment OpenEPT_ED_Platform_Segment;
+
 int OpenEPT_ED_Platform_Init();
 int OpenEPT_ED_Platform_Send(char character);
 int OpenEPT_ED_Platform_Read(char* character);
 int OpenEPT_ED_Platform_SyncUp();
 int OpenEPT_ED_Platform_SyncDown();
 int OpenEPT_ED_Platform_SyncToogle();
+
+/*
+ * Buffer oriented send functions. Both have weak default implementations in platform_default.c:
+ * OpenEPT_ED_Platform_SendBuffer falls back to OpenEPT_ED_Platform_Send for every byte and
+ * OpenEPT_ED_Platform_SendSegments falls back to OpenEPT_ED_Platform_SendBuffer for every segment.
+ * A port has to implement at least OpenEPT_ED_Platform_Send or OpenEPT_ED_Platform_SendBuffer.
+ */
+int OpenEPT_ED_Platform_SendBuffer(const uint8_t* buffer, uint32_t size);
+int OpenEPT_ED_Platform_SendSegments(const OpenEPT_ED_Platform_Segment* segments, uint32_t count);
+
+/*
+ * Wait until everything passed to the send functions has left the device. Ports with
+ * buffered transmit must implement it; the weak default returns immediately.
+ */
+int OpenEPT_ED_Platform_Flush();
+
+/*
+ * Read one character only if it is already received. The weak default falls back to the
+ * blocking OpenEPT_ED_Platform_Read, ports should implement it to make OpenEPT_ED_Poll
+ * non-blocking.
+ */
+int OpenEPT_ED_Platform_TryRead(char* character);
+
+/*
+ * Millisecond tick used for handshake timeouts and backoff. The weak default only counts
+ * calls, ports should implement it with a real time source.
+ */
+uint32_t OpenEPT_ED_Platform_GetTickMs();
+
+/*
+ * Change link baud rate, 0 restores the rate set by OpenEPT_ED_Platform_Init. Used by
+ * baud rate negotiation in START handshake; the weak default reports an error.
+ */
+int OpenEPT_ED_Platform_Reconfigure(uint32_t baudrate);
+
+/*
+ * Event timestamp source. Timestamp counts ticks of OpenEPT_ED_Platform_GetTimestampFrequency
+ * and must not wrap; 32 bit counters are extended with OpenEPT_ED_ExtendCounter. The weak
+ * defaults report frequency 0, which disables event timestamps.
+ */
+uint64_t OpenEPT_ED_Platform_GetTimestamp();
+uint32_t OpenEPT_ED_Platform_GetTimestampFrequency();
+
+/*
+ * Transmit queue state for the event overflow policy (OpenEPT_ED_SetOverflowPolicy).
+ * OpenEPT_ED_Platform_TxSpace returns free bytes in the queue; OpenEPT_ED_Platform_TxDiscard
+ * removes the oldest queued binary frame (up to its 0x00 delimiter) that is not being
+ * transmitted yet; when the beginning of that frame is already sent, the delimiter is kept
+ * so the receiver rejects the partial frame alone. OpenEPT_ED_Platform_TxProtect is called after frames that must not be
+ * discarded (definitions, control records); TxDiscard fails while data queued before the
+ * last call is not being transmitted yet. The weak defaults suit unbuffered ports: the
+ * queue is never full and nothing can be discarded.
+ */
+uint32_t OpenEPT_ED_Platform_TxSpace();
+int OpenEPT_ED_Platform_TxDiscard();
+void OpenEPT_ED_Platform_TxProtect();
+
+/*
+ * Event ring and thread buffer drain (OPENEPT_ED_CONF_EVENT_RING_SLOTS, _THREAD_BUFFERS).
+ * OpenEPT_ED_Platform_DrainRequest is called by the producer, thread or interrupt, after it
+ * queued an event; ports wake the task that drains the default context with OpenEPT_ED_Poll.
+ * It must not block. OpenEPT_ED_Platform_Yield is called while a control function waits for
+ * the transport used by another thread. The weak defaults do nothing: queued events wait for
+ * the next poll, and waiting only spins.
+ */
+void OpenEPT_ED_Platform_DrainRequest();
+void OpenEPT_ED_Platform_Yield();
+
+/*
+ * Thread-local pointer to the event buffer of the calling thread (OpenEPT_ED_AttachThread),
+ * NULL if it has none. The weak defaults keep a single pointer, which suits ports without
+ * threads; threaded ports keep it in thread-local storage.
+ */
+void* OpenEPT_ED_Platform_GetThreadBuffer();
+void OpenEPT_ED_Platform_SetThreadBuffer(void* buffer);
+
+/* State of a 32 bit counter extended to 64 bits, zero initialized */
+typedef struct
+{
+    uint64_t    value;          /* Extended value at last update */
+    uint32_t    counter;        /* Counter at last update */
+    uint32_t    tickMs;         /* Millisecond tick at last update */
+}OpenEPT_ED_CounterExtender;
+
+/*
+ * Extend free running 32 bit counter (e.g. DWT CYCCNT) to 64 bits. Wraps between updates are
+ * counted from the elapsed millisecond tick, so the counter may be left unread for any time
+ * shorter than the tick period. Not reentrant, ports serialize calls (e.g. mask interrupts).
+ */
+uint64_t OpenEPT_ED_ExtendCounter(OpenEPT_ED_CounterExtender* extender, uint32_t counter, uint32_t tickMs, uint32_t frequency);
 #ifdef __cplusplus
 }
 #endif
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,198 @@
+/**
+ * @file platform_default.c
+ * @brief Default implementations of optional OpenEPT ED platform functions.
+ *
+ * Every function in this file is declared weak, so a platform port overrides it simply
+ * by providing its own definition. Ports that only know how to send one character keep
+ * working unchanged, while ports with a faster buffer oriented transport implement
+ * OpenEPT_ED_Platform_SendBuffer (and optionally OpenEPT_ED_Platform_SendSegments).
+ *
+ * @date November 3, 2024
+ * @author Dimitrije Lilic, Haris Turkmanovic
+ */
+
+#include "platform.h"
+
+
+/**
+ * @brief Default single character send.
+ *
+ * Only used when the port implements neither of the send functions.
+ *
+ * @param character The character to be transmitted.
+ * @return OPEN_EPT_STATUS_ERROR.
+ */
+OPENEPT_ED_PLATFORM_WEAK int OpenEPT_ED_Platform_Send(char character)
+{
+    (void)character;
+    return OPEN_EPT_STATUS_ERROR;
+}
+
+/**
+ * @brief Default buffer send, implemented over OpenEPT_ED_Platform_Send.
+ *
+ * @param buffer Pointer to the data to be transmitted.
+ * @param size Number of bytes to transmit.
+ * @return OPEN_EPT_STATUS_OK on successful transmission,
+ *         OPEN_EPT_STATUS_ERROR on transmission error.
+ */
+OPENEPT_ED_PLATFORM_WEAK int OpenEPT_ED_Platform_SendBuffer(const uint8_t* buffer, uint32_t size)
+{
+    uint32_t cnt = 0;
+    while(cnt < size)
+    {
+        if(OpenEPT_ED_Platform_Send((char)buffer[cnt]) != 0) return OPEN_EPT_STATUS_ERROR;
+        cnt++;
+    }
+    return OPEN_EPT_STATUS_OK;
+}
+
+/**
+ * @brief Default scatter send, implemented over OpenEPT_ED_Platform_SendBuffer.
+ *
+ * @param segments Array of frame segments to transmit in order.
+ * @param count Number of segments.
+ * @return OPEN_EPT_STATUS_OK on successful transmission,
+ *         OPEN_EPT_STATUS_ERROR on transmission error.
+ */
+OPENEPT_ED_PLATFORM_WEAK int OpenEPT_ED_Platform_SendSegments(const OpenEPT_ED_Platform_Segment* segments, uint32_t count)
+{
+    uint32_t cnt = 0;
+    while(cnt < count)
+    {
+        if(OpenEPT_ED_Platform_SendBuffer(segments[cnt].data, segments[cnt].size) != 0) return OPEN_EPT_STATUS_ERROR;
+        cnt++;
+    }
+    return OPEN_EPT_STATUS_OK;
+}
+
+/**
+ * @brief Default flush, for ports whose send functions return only after data is sent.
+ *
+ * @return OPEN_EPT_STATUS_OK.
+ */
+OPENEPT_ED_PLATFORM_WEAK int OpenEPT_ED_Platform_Flush()
+{
+    return OPEN_EPT_STATUS_OK;
+}
+
+/**
+ * @brief Default non-blocking read, implemented over blocking OpenEPT_ED_Platform_Read.
+ *
+ * @param character Read character.
+ * @return OPEN_EPT_STATUS_OK if character is read,
+ *         OPEN_EPT_STATUS_ERROR otherwise.
+ */
+OPENEPT_ED_PLATFORM_WEAK int OpenEPT_ED_Platform_TryRead(char* character)
+{
+    return OpenEPT_ED_Platform_Read(character);
+}
+
+/**
+ * @brief Default millisecond tick for ports without time source.
+ *
+ * Advances by one on every call, so handshake timeouts are counted in
+ * OpenEPT_ED_Poll calls instead of milliseconds and still expire.
+ *
+ * @return Number of calls so far.
+ */
+OPENEPT_ED_PLATFORM_WEAK uint32_t OpenEPT_ED_Platform_GetTickMs()
+{
+    static uint32_t tick;
+    return tick++;
+}
+
+/**
+ * @brief Default reconfigure for ports with fixed baud rate.
+ *
+ * @param baudrate Requested baud rate.
+ * @return OPEN_EPT_STATUS_ERROR.
+ */
+OPENEPT_ED_PLATFORM_WEAK int OpenEPT_ED_Platform_Reconfigure(uint32_t baudrate)
+{
+    (void)baudrate;
+    return OPEN_EPT_STATUS_ERROR;
+}
+
+/**
+ * @brief Default timestamp for ports without timestamp source.
+ *
+ * @return 0.
+ */
+OPENEPT_ED_PLATFORM_WEAK uint64_t OpenEPT_ED_Platform_GetTimestamp()
+{
+    return 0;
+}
+
+/**
+ * @brief Default timestamp frequency, disables event timestamps.
+ *
+ * @return 0.
+ */
+OPENEPT_ED_PLATFORM_WEAK uint32_t OpenEPT_ED_Platform_GetTimestampFrequency()
+{
+    return 0;
+}
+
+/**
+ * @brief Default transmit queue space for unbuffered ports, queue is never full.
+ *
+ * @return 0xFFFFFFFF.
+ */
+OPENEPT_ED_PLATFORM_WEAK uint32_t OpenEPT_ED_Platform_TxSpace()
+{
+    return 0xFFFFFFFF;
+}
+
+/**
+ * @brief Default discard for unbuffered ports, nothing is queued.
+ *
+ * @return OPEN_EPT_STATUS_ERROR.
+ */
+OPENEPT_ED_PLATFORM_WEAK int OpenEPT_ED_Platform_TxDiscard()
+{
+    return OPEN_EPT_STATUS_ERROR;
+}
+
+/**
+ * @brief Default protection for unbuffered ports, nothing is ever discarded.
+ */
+OPENEPT_ED_PLATFORM_WEAK void OpenEPT_ED_Platform_TxProtect()
+{
+}
+
+/**
+ * @brief Default drain request, queued events wait for the next OpenEPT_ED_Poll.
+ */
+OPENEPT_ED_PLATFORM_WEAK void OpenEPT_ED_Platform_DrainRequest()
+{
+}
+
+/**
+ * @brief Default yield for ports without threads, waiting spins.
+ */
+OPENEPT_ED_PLATFORM_WEAK void OpenEPT_ED_Platform_Yield()
+{
+}
+
+static void* OPENEPT_ED_PLATFORM_THREAD_BUFFER;
+
+/**
+ * @brief Default thread buffer lookup for ports without threads.
+ *
+ * @return Buffer set last with OpenEPT_ED_Platform_SetThreadBuffer.
+ */
+OPENEPT_ED_PLATFORM_WEAK void* OpenEPT_ED_Platform_GetThreadBuffer()
+{
+    return OPENEPT_ED_PLATFORM_THREAD_BUFFER;
+}
+
+/**
+ * @brief Default thread buffer store for ports without threads.
+ *
+ * @param buffer Event buffer.
+ */
+OPENEPT_ED_PLATFORM_WEAK void OpenEPT_ED_Platform_SetThreadBuffer(void* buffer)
+{
+    OPENEPT_ED_PLATFORM_THREAD_BUFFER = buffer;
+}
@@ -0,0 +1,404 @@
+/**
+ * @file protocol.c
+ * @brief Binary EP link protocol encoding.
+ *
+ * @date November 3, 2024
+ * @author Dimitrije Lilic, Haris Turkmanovic
+ */
+
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include "protocol.h"
+
+/* printf conversion specification without length modifier and conversion, e.g. "%-08.3" */
+#define OPENEPT_PROTOCOL_SPEC_SIZE      16
+
+
+/* CRC-16/CCITT-FALSE, one nibble per step to keep the table small */
+static const uint16_t OPENEPT_CRC16_TABLE[16] =
+{
+    0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+    0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF
+};
+
+uint16_t OpenEPT_ED_Protocol_Crc16(uint16_t crc, const uint8_t* data, uint32_t size)
+{
+    while(size-- > 0)
+    {
+        crc = (uint16_t)((crc << 4) ^ OPENEPT_CRC16_TABLE[(crc >> 12) ^ (*data >> 4)]);
+        crc = (uint16_t)((crc << 4) ^ OPENEPT_CRC16_TABLE[(crc >> 12) ^ (*data & 0x0F)]);
+        data++;
+    }
+    return crc;
+}
+
+uint32_t OpenEPT_ED_Protocol_PutVarint(uint8_t* buffer, uint32_t value)
+{
+    uint32_t size = 0;
+    while(value >= 0x80)
+    {
+        buffer[size++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    buffer[size++] = (uint8_t)value;
+    return size;
+}
+
+uint32_t OpenEPT_ED_Protocol_GetVarint(const uint8_t* buffer, uint32_t size, uint32_t* value)
+{
+    uint32_t result = 0;
+    uint32_t cnt;
+
+    for(cnt = 0; cnt < size && cnt < OPENEPT_ED_PROTOCOL_VARINT_MAX_SIZE; cnt++)
+    {
+        result |= (uint32_t)(buffer[cnt] & 0x7F) << (7 * cnt);
+        if((buffer[cnt] & 0x80) == 0)
+        {
+            *value = result;
+            return cnt + 1;
+        }
+    }
+    return 0;
+}
+
+uint32_t OpenEPT_ED_Protocol_PutVarint64(uint8_t* buffer, uint64_t value)
+{
+    uint32_t size = 0;
+    while(value >= 0x80)
+    {
+        buffer[size++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    buffer[size++] = (uint8_t)value;
+    return size;
+}
+
+uint32_t OpenEPT_ED_Protocol_GetVarint64(const uint8_t* buffer, uint32_t size, uint64_t* value)
+{
+    uint64_t result = 0;
+    uint32_t cnt;
+
+    for(cnt = 0; cnt < size && cnt < OPENEPT_ED_PROTOCOL_VARINT64_MAX_SIZE; cnt++)
+    {
+        result |= (uint64_t)(buffer[cnt] & 0x7F) << (7 * cnt);
+        if((buffer[cnt] & 0x80) == 0)
+        {
+            *value = result;
+            return cnt + 1;
+        }
+    }
+    return 0;
+}
+
+uint32_t OpenEPT_ED_Protocol_PutZigzag64(uint8_t* buffer, int64_t value)
+{
+    return OpenEPT_ED_Protocol_PutVarint64(buffer, ((uint64_t)value << 1) ^ (uint64_t)(value >> 63));
+}
+
+uint32_t OpenEPT_ED_Protocol_GetZigzag64(const uint8_t* buffer, uint32_t size, int64_t* value)
+{
+    uint64_t raw;
+    uint32_t used = OpenEPT_ED_Protocol_GetVarint64(buffer, size, &raw);
+    if(used != 0) *value = (int64_t)(raw >> 1) ^ -(int64_t)(raw & 1);
+    return used;
+}
+
+uint32_t OpenEPT_ED_Protocol_PutArgUnsigned(uint8_t* buffer, uint64_t value)
+{
+    buffer[0] = OPENEPT_ED_ARG_UNSIGNED;
+    return 1 + OpenEPT_ED_Protocol_PutVarint64(&buffer[1], value);
+}
+
+uint32_t OpenEPT_ED_Protocol_PutArgSigned(uint8_t* buffer, int64_t value)
+{
+    //Zigzag keeps small negative values short
+    buffer[0] = OPENEPT_ED_ARG_SIGNED;
+    return 1 + OpenEPT_ED_Protocol_PutZigzag64(&buffer[1], value);
+}
+
+uint32_t OpenEPT_ED_Protocol_PutArgFloat(uint8_t* buffer, float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    buffer[0] = OPENEPT_ED_ARG_FLOAT;
+    buffer[1] = (uint8_t)bits;
+    buffer[2] = (uint8_t)(bits >> 8);
+    buffer[3] = (uint8_t)(bits >> 16);
+    buffer[4] = (uint8_t)(bits >> 24);
+    return 5;
+}
+
+uint32_t OpenEPT_ED_Protocol_PutArgString(uint8_t* buffer, uint32_t size, const char* value)
+{
+    uint32_t length = value != NULL ? (uint32_t)strlen(value) : 0;
+
+    //One byte size, strings longer than fit are cut
+    if(length > size - 2) length = size - 2;
+    if(length > 0x7F) length = 0x7F;
+    buffer[0] = OPENEPT_ED_ARG_STRING;
+    buffer[1] = (uint8_t)length;
+    if(length != 0) memcpy(&buffer[2], value, length);
+    return 2 + length;
+}
+
+/*
+ * Parse conversion specification that starts after '%'. Flags, width and precision are
+ * copied into spec (if given) with leading '%'. Length modifier is returned as one
+ * character, 'H' for hh and 'q' for ll. Conversion is 0 for unsupported '*'. Returns
+ * position after the conversion.
+ */
+static const char* OpenEPT_ED_Protocol_ParseConversion(const char* format, char* spec, char* length, char* conversion)
+{
+    uint32_t used = 1;
+    uint8_t star = 0;
+
+    while(*format != '\0' && strchr("-+ #0123456789.*", *format) != NULL)
+    {
+        if(*format == '*') star = 1;
+        if(spec != NULL && used < OPENEPT_PROTOCOL_SPEC_SIZE - 4) spec[used++] = *format;
+        format++;
+    }
+    if(spec != NULL)
+    {
+        spec[0] = '%';
+        spec[used] = '\0';
+    }
+    *length = 0;
+    if(format[0] == 'h' && format[1] == 'h')
+    {
+        *length = 'H';
+        format += 2;
+    }
+    else if(format[0] == 'l' && format[1] == 'l')
+    {
+        *length = 'q';
+        format += 2;
+    }
+    else if(*format != '\0' && strchr("hljztL", *format) != NULL)
+    {
+        *length = *format++;
+    }
+    *conversion = star ? 0 : *format;
+    return *format != '\0' ? format + 1 : format;
+}
+
+/*
+ * Complete parsed specification with length modifier and conversion.
+ */
+static const char* OpenEPT_ED_Protocol_Spec(char* spec, const char* length, char conversion)
+{
+    size_t used = strlen(spec);
+    while(*length != '\0') spec[used++] = *length++;
+    spec[used++] = conversion;
+    spec[used] = '\0';
+    return spec;
+}
+
+uint32_t OpenEPT_ED_Protocol_EncodeArgs(uint8_t* buffer, uint32_t size, const char* format, va_list args)
+{
+    uint32_t used = 0;
+    char length;
+    char conversion;
+
+    while(*format != '\0')
+    {
+        if(*format++ != '%') continue;
+        if(*format == '%')
+        {
+            format++;
+            continue;
+        }
+        format = OpenEPT_ED_Protocol_ParseConversion(format, NULL, &length, &conversion);
+        if(conversion == 's')
+        {
+            if(size - used < 2) break;
+            used += OpenEPT_ED_Protocol_PutArgString(&buffer[used], size - used, va_arg(args, const char*));
+            continue;
+        }
+        if(size - used < OPENEPT_ED_PROTOCOL_ARG_MAX_SIZE) break;
+        switch(conversion)
+        {
+        case 'd': case 'i':
+            if(length == 'l') used += OpenEPT_ED_Protocol_PutArgSigned(&buffer[used], va_arg(args, long));
+            else if(length == 'q') used += OpenEPT_ED_Protocol_PutArgSigned(&buffer[used], va_arg(args, long long));
+            else if(length == 'j') used += OpenEPT_ED_Protocol_PutArgSigned(&buffer[used], va_arg(args, intmax_t));
+            else if(length == 'z') used += OpenEPT_ED_Protocol_PutArgSigned(&buffer[used], (int64_t)va_arg(args, size_t));
+            else if(length == 't') used += OpenEPT_ED_Protocol_PutArgSigned(&buffer[used], va_arg(args, ptrdiff_t));
+            else used += OpenEPT_ED_Protocol_PutArgSigned(&buffer[used], va_arg(args, int));
+            break;
+        case 'u': case 'o': case 'x': case 'X':
+            if(length == 'l') used += OpenEPT_ED_Protocol_PutArgUnsigned(&buffer[used], va_arg(args, unsigned long));
+            else if(length == 'q') used += OpenEPT_ED_Protocol_PutArgUnsigned(&buffer[used], va_arg(args, unsigned long long));
+            else if(length == 'j') used += OpenEPT_ED_Protocol_PutArgUnsigned(&buffer[used], va_arg(args, uintmax_t));
+            else if(length == 'z') used += OpenEPT_ED_Protocol_PutArgUnsigned(&buffer[used], va_arg(args, size_t));
+            else if(length == 't') used += OpenEPT_ED_Protocol_PutArgUnsigned(&buffer[used], (uint64_t)va_arg(args, ptrdiff_t));
+            else used += OpenEPT_ED_Protocol_PutArgUnsigned(&buffer[used], va_arg(args, unsigned int));
+            break;
+        case 'c':
+            used += OpenEPT_ED_Protocol_PutArgUnsigned(&buffer[used], (uint8_t)va_arg(args, int));
+            break;
+        case 'p':
+            used += OpenEPT_ED_Protocol_PutArgUnsigned(&buffer[used], (uintptr_t)va_arg(args, void*));
+            break;
+        case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+            if(length == 'L') used += OpenEPT_ED_Protocol_PutArgFloat(&buffer[used], (float)va_arg(args, long double));
+            else used += OpenEPT_ED_Protocol_PutArgFloat(&buffer[used], (float)va_arg(args, double));
+            break;
+        default:
+            //Argument size is not known, the rest can not be read
+            return used;
+        }
+    }
+    return used;
+}
+
+uint32_t OpenEPT_ED_Protocol_FormatArgs(char* text, uint32_t size, const char* format, const uint8_t* args, uint32_t argsSize)
+{
+    char spec[OPENEPT_PROTOCOL_SPEC_SIZE];
+    char length;
+    char conversion;
+    const uint8_t* string = NULL;
+    uint32_t stringSize = 0;
+    uint32_t used = 0;
+    uint32_t pos = 0;
+    uint32_t read;
+    uint32_t bits;
+    uint64_t value = 0;
+    int64_t signedValue = 0;
+    double real = 0;
+    float single;
+    uint8_t valid;
+    int written;
+
+    if(size == 0) return 0;
+    while(*format != '\0' && used + 1 < size)
+    {
+        if(*format != '%' || format[1] == '%')
+        {
+            text[used++] = *format;
+            format += *format == '%' ? 2 : 1;
+            continue;
+        }
+        format = OpenEPT_ED_Protocol_ParseConversion(format + 1, spec, &length, &conversion);
+
+        //Decode next argument, every type is converted to what the conversion needs
+        valid = 0;
+        if(pos < argsSize)
+        {
+            switch(args[pos])
+            {
+            case OPENEPT_ED_ARG_UNSIGNED:
+            case OPENEPT_ED_ARG_SIGNED:
+                read = OpenEPT_ED_Protocol_GetVarint64(&args[pos + 1], argsSize - pos - 1, &value);
+                if(read == 0) break;
+                signedValue = args[pos] == OPENEPT_ED_ARG_SIGNED ? (int64_t)(value >> 1) ^ -(int64_t)(value & 1) : (int64_t)value;
+                if(args[pos] == OPENEPT_ED_ARG_SIGNED) value = (uint64_t)signedValue;
+                real = args[pos] == OPENEPT_ED_ARG_SIGNED ? (double)signedValue : (double)value;
+                pos += 1 + read;
+                valid = 1;
+                break;
+            case OPENEPT_ED_ARG_FLOAT:
+                if(argsSize - pos < 5) break;
+                bits = (uint32_t)args[pos + 1] | (uint32_t)args[pos + 2] << 8 | (uint32_t)args[pos + 3] << 16 | (uint32_t)args[pos + 4] << 24;
+                memcpy(&single, &bits, sizeof(single));
+                real = single;
+                signedValue = (int64_t)single;
+                value = (uint64_t)signedValue;
+                pos += 5;
+                valid = 1;
+                break;
+            case OPENEPT_ED_ARG_STRING:
+                read = OpenEPT_ED_Protocol_GetVarint(&args[pos + 1], argsSize - pos - 1, &stringSize);
+                if(read == 0 || stringSize > argsSize - pos - 1 - read) break;
+                string = &args[pos + 1 + read];
+                pos += 1 + read + stringSize;
+                valid = 2;
+                break;
+            default:
+                break;
+            }
+            //Unknown or broken argument, the rest can not be decoded
+            if(valid == 0) pos = argsSize;
+        }
+
+        written = 0;
+        if(valid == 2 && conversion == 's')
+        {
+            //Width and precision are ignored for strings, characters are copied as they are
+            for(read = 0; read < stringSize && used + 1 < size; read++) text[used++] = (char)string[read];
+        }
+        else if(valid == 1 && (conversion == 'd' || conversion == 'i'))
+        {
+            //long long only when needed, small printf implementations may lack it
+            if(signedValue == (long)signedValue) written = snprintf(&text[used], size - used, OpenEPT_ED_Protocol_Spec(spec, "l", conversion), (long)signedValue);
+            else written = snprintf(&text[used], size - used, OpenEPT_ED_Protocol_Spec(spec, "ll", conversion), (long long)signedValue);
+        }
+        else if(valid == 1 && conversion != 0 && strchr("uoxX", conversion) != NULL)
+        {
+            if(value == (unsigned long)value) written = snprintf(&text[used], size - used, OpenEPT_ED_Protocol_Spec(spec, "l", conversion), (unsigned long)value);
+            else written = snprintf(&text[used], size - used, OpenEPT_ED_Protocol_Spec(spec, "ll", conversion), (unsigned long long)value);
+        }
+        else if(valid == 1 && conversion == 'c')
+        {
+            written = snprintf(&text[used], size - used, OpenEPT_ED_Protocol_Spec(spec, "", conversion), (int)value);
+        }
+        else if(valid == 1 && conversion == 'p')
+        {
+            written = snprintf(&text[used], size - used, "0x%lx", (unsigned long)value);
+        }
+        else if(valid == 1 && conversion != 0 && strchr("fFeEgGaA", conversion) != NULL)
+        {
+            written = snprintf(&text[used], size - used, OpenEPT_ED_Protocol_Spec(spec, "", conversion), real);
+        }
+        else
+        {
+            text[used++] = '?';
+        }
+        if(written > 0) used += (uint32_t)written < size - used ? (uint32_t)written : size - used - 1;
+    }
+    text[used] = '\0';
+    return used;
+}
+
+uint32_t OpenEPT_ED_Protocol_CobsEncode(uint8_t* buffer, uint32_t size)
+{
+    uint32_t codePos = 0;
+    uint32_t out = 1;
+    uint32_t cnt;
+    uint8_t code = 1;
+
+    //Output never overtakes input because no block reaches 254 data bytes
+    for(cnt = 1; cnt <= size; cnt++)
+    {
+        if(buffer[cnt] == 0)
+        {
+            buffer[codePos] = code;
+            codePos = out++;
+            code = 1;
+            continue;
+        }
+        buffer[out++] = buffer[cnt];
+        code++;
+    }
+    buffer[codePos] = code;
+    buffer[out++] = 0;
+    return out;
+}
+
+uint32_t OpenEPT_ED_Protocol_CobsDecode(uint8_t* buffer, uint32_t size)
+{
+    uint32_t in = 0;
+    uint32_t out = 0;
+    uint8_t code;
+    uint8_t cnt;
+
+    while(in < size)
+    {
+        code = buffer[in++];
+        if(code == 0 || in + code - 1 > size) return 0;
+        for(cnt = 1; cnt < code; cnt++) buffer[out++] = buffer[in++];
+        if(code != 0xFF && in < size) buffer[out++] = 0;
+    }
+    return out;
+}
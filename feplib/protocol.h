@@ -0,0 +1,178 @@
+/**
+ * @file protocol.h
+ * @brief Binary EP link protocol encoding.
+ *
+ * Binary frames are COBS encoded and terminated with 0x00, so a receiver resynchronizes on
+ * the next 0x00 after a corrupted or lost byte. Decoded frame is a list of records
+ * followed by CRC-16/CCITT-FALSE (little endian) of the records:
+ *
+ *   record = <type> <varint size> <payload>
+ *
+ * Used by the library to encode frames and by host tools to decode them.
+ *
+ * @date November 3, 2024
+ * @author Dimitrije Lilic, Haris Turkmanovic
+ */
+
+#ifndef OPENEPT_ED_PROTOCOL_H_
+#define OPENEPT_ED_PROTOCOL_H_
+
+#include <stdarg.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Highest binary protocol version implemented, offered as "PROTO=<version>" in START */
+#define OPENEPT_ED_PROTOCOL_VERSION             1
+
+/* Record types, ASCII frame type digits use the same numbers */
+#define OPENEPT_ED_RECORD_CONTROL               0x00    /* Payload: control command */
+#define OPENEPT_ED_RECORD_EP_NAME               0x01    /* Payload: energy point name */
+#define OPENEPT_ED_RECORD_INFO                  0x02    /* Payload: info message */
+#define OPENEPT_ED_RECORD_EP_ID                 0x03    /* Payload: varint energy point ID */
+#define OPENEPT_ED_RECORD_EP_DEFINE             0x04    /* Payload: varint energy point ID, name */
+#define OPENEPT_ED_RECORD_EP_HASH               0x05    /* Payload: 32 bit FNV-1a hash of energy point name, little endian */
+#define OPENEPT_ED_RECORD_EP_OFFSET             0x06    /* Payload: varint offset of energy point name in firmware openept_eps section */
+#define OPENEPT_ED_RECORD_TIMESTAMP             0x07    /* Payload: varint time of the event record that follows it, in timebase ticks */
+#define OPENEPT_ED_RECORD_TIMEBASE              0x08    /* Payload: varint timestamp tick frequency in Hz, sent after START */
+#define OPENEPT_ED_RECORD_SEQUENCE              0x09    /* Payload: varint sequence number of the event record that follows it, 0 for the first event of a session;
+                                                           sent alone before STOP with the number the next event would get */
+#define OPENEPT_ED_RECORD_DROPPED               0x0A    /* Payload: varint number of frames dropped in the session so far */
+#define OPENEPT_ED_RECORD_EP_FORMAT             0x0B    /* Payload: 32 bit FNV-1a hash of format string, little endian, arguments */
+#define OPENEPT_ED_RECORD_REGION_BEGIN          0x0C    /* Payload: varint nesting depth (0 outermost), varint energy point ID */
+#define OPENEPT_ED_RECORD_REGION_END            0x0D    /* Payload: varint nesting depth of the region, varint energy point ID */
+#define OPENEPT_ED_RECORD_PING                  0x0E    /* Payload: varint DUT timestamp in timebase ticks; answered with "PONG <timestamp> <receive ns> <send ns>\r" */
+#define OPENEPT_ED_RECORD_CLOCK                 0x0F    /* Payload: varint DUT timestamp of the estimate, zigzag varint offset of Acquisition time to DUT time in ns,
+                                                           varint round trip time in ns, zigzag varint drift in ppb */
+#define OPENEPT_ED_RECORD_TASK                  0x10    /* Payload: varint task ID switched in at the event time, 0 for a task without ID */
+#define OPENEPT_ED_RECORD_TASK_DEFINE           0x11    /* Payload: varint task ID, task name */
+/* Set in record type when payload continues in the same record type of the next frame */
+#define OPENEPT_ED_RECORD_CONTINUED             0x80
+
+/* ASCII sessions have only single digit frame types, region ends are EP name frames with these prefixes */
+#define OPENEPT_ED_ASCII_REGION_BEGIN           "BEGIN "
+#define OPENEPT_ED_ASCII_REGION_END             "END "
+
+/* Argument types of format records, every argument is <type> <value> */
+#define OPENEPT_ED_ARG_UNSIGNED                 0x00    /* Value: varint */
+#define OPENEPT_ED_ARG_SIGNED                   0x01    /* Value: zigzag varint */
+#define OPENEPT_ED_ARG_FLOAT                    0x02    /* Value: IEEE 754 binary32, little endian */
+#define OPENEPT_ED_ARG_STRING                   0x03    /* Value: varint size, characters */
+
+/* Control commands */
+#define OPENEPT_ED_CONTROL_STOP                 0x01
+
+/* Longest record list (including CRC) encoded without COBS overhead byte of 254 byte blocks */
+#define OPENEPT_ED_PROTOCOL_MAX_RAW_SIZE        253
+/* Worst case size of varint encoded 32 bit value */
+#define OPENEPT_ED_PROTOCOL_VARINT_MAX_SIZE     5
+/* Worst case size of varint encoded 64 bit value */
+#define OPENEPT_ED_PROTOCOL_VARINT64_MAX_SIZE   10
+/* Worst case size of encoded numeric argument */
+#define OPENEPT_ED_PROTOCOL_ARG_MAX_SIZE        (1 + OPENEPT_ED_PROTOCOL_VARINT64_MAX_SIZE)
+
+/**
+ * @brief Update CRC-16/CCITT-FALSE (polynomial 0x1021, initial value 0xFFFF).
+ *
+ * @param crc CRC of preceding data, 0xFFFF at the start.
+ * @param data Data.
+ * @param size Number of bytes.
+ * @return Updated CRC.
+ */
+uint16_t OpenEPT_ED_Protocol_Crc16(uint16_t crc, const uint8_t* data, uint32_t size);
+
+/**
+ * @brief Store value as LEB128 varint (7 bits per byte, least significant first).
+ *
+ * @param buffer Destination, at least OPENEPT_ED_PROTOCOL_VARINT_MAX_SIZE bytes.
+ * @param value Value.
+ * @return Number of bytes written.
+ */
+uint32_t OpenEPT_ED_Protocol_PutVarint(uint8_t* buffer, uint32_t value);
+
+/**
+ * @brief Load LEB128 varint.
+ *
+ * @param buffer Source.
+ * @param size Number of bytes available in source.
+ * @param value Decoded value.
+ * @return Number of bytes consumed, 0 if varint is truncated or too long.
+ */
+uint32_t OpenEPT_ED_Protocol_GetVarint(const uint8_t* buffer, uint32_t size, uint32_t* value);
+
+/* 64 bit variants of the varint functions above, buffer holds OPENEPT_ED_PROTOCOL_VARINT64_MAX_SIZE bytes */
+uint32_t OpenEPT_ED_Protocol_PutVarint64(uint8_t* buffer, uint64_t value);
+uint32_t OpenEPT_ED_Protocol_GetVarint64(const uint8_t* buffer, uint32_t size, uint64_t* value);
+
+/* Signed values as zigzag varint (0, -1, 1, -2, ... encoded as 0, 1, 2, 3, ...) */
+uint32_t OpenEPT_ED_Protocol_PutZigzag64(uint8_t* buffer, int64_t value);
+uint32_t OpenEPT_ED_Protocol_GetZigzag64(const uint8_t* buffer, uint32_t size, int64_t* value);
+
+/*
+ * Format record arguments. Put functions store one argument and return its size; buffer
+ * holds OPENEPT_ED_PROTOCOL_ARG_MAX_SIZE bytes, string is cut to fit size bytes (at least 2).
+ */
+uint32_t OpenEPT_ED_Protocol_PutArgUnsigned(uint8_t* buffer, uint64_t value);
+uint32_t OpenEPT_ED_Protocol_PutArgSigned(uint8_t* buffer, int64_t value);
+uint32_t OpenEPT_ED_Protocol_PutArgFloat(uint8_t* buffer, float value);
+uint32_t OpenEPT_ED_Protocol_PutArgString(uint8_t* buffer, uint32_t size, const char* value);
+
+/**
+ * @brief Encode printf arguments as format record arguments.
+ *
+ * Argument types follow the conversions of format: d and i are signed, u, o, x, X, c and p
+ * unsigned, f, F, e, E, g, G, a and A float, s string. Width and precision given as '*'
+ * and the n conversion are not supported. Encoding stops at the first argument that does
+ * not fit.
+ *
+ * @param buffer Destination.
+ * @param size Destination size.
+ * @param format printf format.
+ * @param args Arguments.
+ * @return Number of bytes written.
+ */
+uint32_t OpenEPT_ED_Protocol_EncodeArgs(uint8_t* buffer, uint32_t size, const char* format, va_list args);
+
+/**
+ * @brief Format text from printf format and encoded arguments.
+ *
+ * Conversions without argument are written as '?'. Used by the host to expand format
+ * records and by the library in ASCII sessions.
+ *
+ * @param text Destination, always terminated.
+ * @param size Destination size.
+ * @param format printf format.
+ * @param args Encoded arguments.
+ * @param argsSize Size of encoded arguments.
+ * @return Text length.
+ */
+uint32_t OpenEPT_ED_Protocol_FormatArgs(char* text, uint32_t size, const char* format, const uint8_t* args, uint32_t argsSize);
+
+/**
+ * @brief COBS encode frame in place and append 0x00 delimiter.
+ *
+ * Raw data is expected at buffer[1]..buffer[size], encoded frame starts at buffer[0].
+ * Buffer must hold size + 2 bytes.
+ *
+ * @param buffer Frame buffer.
+ * @param size Raw size, at most OPENEPT_ED_PROTOCOL_MAX_RAW_SIZE.
+ * @return Encoded size including delimiter.
+ */
+uint32_t OpenEPT_ED_Protocol_CobsEncode(uint8_t* buffer, uint32_t size);
+
+/**
+ * @brief COBS decode frame in place.
+ *
+ * @param buffer Encoded frame without 0x00 delimiter, decoded data starts at buffer[0].
+ * @param size Encoded size.
+ * @return Decoded size, 0 if frame is not valid COBS.
+ */
+uint32_t OpenEPT_ED_Protocol_CobsDecode(uint8_t* buffer, uint32_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
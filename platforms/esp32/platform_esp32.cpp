@@ -11,27 +11,133 @@
 #include <Arduino.h>
 #include <stdint.h>
 #include "../../feplib/feplib.h"
+#include "../../feplib/platform.h"
 #include "string.h"
+#if defined(ARDUINO_ARCH_ESP8266)
+#include <Schedule.h>
+#endif
 
 
 
 #define SYNC_PIN 5
 
+/*
+ * Send EP link data over TX-only UART1 (GPIO2 on ESP8266) instead of Serial. Handshake
+ * responses are still received on the Serial RX line (GPIO3), and Serial TX shares its baud
+ * rate, so the library owns the Serial baud rate: application output on Serial TX runs at
+ * the link rate (OPENEPT_ESP_RX_BAUDRATE, then the negotiated one) and a console at any
+ * other rate can not read it.
+ */
+#ifndef OPENEPT_ESP_USE_UART1
+#define OPENEPT_ESP_USE_UART1       0
+#endif
+
+/* Baud rate of UART1 when OPENEPT_ESP_USE_UART1 is enabled */
+#ifndef OPENEPT_ESP_UART1_BAUDRATE
+#define OPENEPT_ESP_UART1_BAUDRATE  2000000
+#endif
+
+/* Baud rate used to receive responses from Acquisition device */
+#ifndef OPENEPT_ESP_RX_BAUDRATE
+#if OPENEPT_ESP_USE_UART1 == 1
+#define OPENEPT_ESP_RX_BAUDRATE     OPENEPT_ESP_UART1_BAUDRATE
+#else
+#define OPENEPT_ESP_RX_BAUDRATE     115200
+#endif
+#endif
+
+#if OPENEPT_ESP_USE_UART1 == 1
+#define OPENEPT_ESP_LINK            Serial1
+#else
+#define OPENEPT_ESP_LINK            Serial
+#endif
+
+/*
+ * Event timestamp source: 1 - CPU cycle counter (ccount) extended to 64 bits, 0 - micros().
+ * ESP32 cores have separate cycle counters, so it uses microseconds by default.
+ */
+#ifndef OPENEPT_ESP_TIMESTAMP_CYCLES
+#if defined(ARDUINO_ARCH_ESP8266)
+#define OPENEPT_ESP_TIMESTAMP_CYCLES 1
+#else
+#define OPENEPT_ESP_TIMESTAMP_CYCLES 0
+#endif
+#endif
+
+#define OPENEPT_ESP_TX_RING_MASK    (OPENEPT_ED_CONF_TX_RING_SIZE - 1)
+
+#if (OPENEPT_ED_CONF_TX_RING_SIZE & OPENEPT_ESP_TX_RING_MASK) != 0
+#error "OPENEPT_ED_CONF_TX_RING_SIZE must be a power of two"
+#endif
+
 static uint8_t  OPENEPT_SYNC_PIN_VALUE;
 
+/*
+ * Software transmit ring, holds frames that did not fit into UART TX FIFO. It is drained
+ * from loop/yield, so both sides always run in the same context.
+ */
+static uint8_t  OPENEPT_TX_RING[OPENEPT_ED_CONF_TX_RING_SIZE];
+static uint32_t OPENEPT_TX_HEAD;
+static uint32_t OPENEPT_TX_TAIL;
+/* Ring position up to which frames are never discarded */
+static uint32_t OPENEPT_TX_PROTECT;
+/* UART has taken the beginning of the frame at the tail */
+static uint8_t  OPENEPT_TX_CUT;
+/* Number of frames discarded because of OPENEPT_ED_TX_OVERFLOW_DROP policy */
+static uint32_t OPENEPT_TX_DROPPED;
+#if OPENEPT_ESP_TIMESTAMP_CYCLES == 1
+/* ccount extended to 64 bits */
+static OpenEPT_ED_CounterExtender OPENEPT_CYCLES;
+#endif
+
+
+/**
+ * @brief Moves queued data from software ring into UART TX FIFO.
+ *
+ * Writes only as much as the FIFO can take, so it never blocks. On ESP8266 it is
+ * scheduled to run from every loop/yield; on other targets the application calls it
+ * from loop().
+ */
+void OpenEPT_ED_Platform_ESP_Service()
+{
+    while(OPENEPT_TX_HEAD != OPENEPT_TX_TAIL)
+    {
+        uint32_t offset = OPENEPT_TX_TAIL & OPENEPT_ESP_TX_RING_MASK;
+        uint32_t size = OPENEPT_TX_HEAD - OPENEPT_TX_TAIL;
+        uint32_t room = (uint32_t)OPENEPT_ESP_LINK.availableForWrite();
+        if(size > OPENEPT_ED_CONF_TX_RING_SIZE - offset) size = OPENEPT_ED_CONF_TX_RING_SIZE - offset;
+        if(size > room) size = room;
+        if(size == 0) break;
+        OPENEPT_ESP_LINK.write(&OPENEPT_TX_RING[offset], size);
+        OPENEPT_TX_TAIL += size;
+        OPENEPT_TX_CUT = OPENEPT_TX_RING[(offset + size - 1) & OPENEPT_ESP_TX_RING_MASK] != 0x00;
+    }
+}
 
 int OpenEPT_ED_Platform_Init()
 {
     pinMode(SYNC_PIN, OUTPUT);
-    Serial.begin(115200);
+    Serial.begin(OPENEPT_ESP_RX_BAUDRATE);
+    Serial.setTimeout(OPENEPT_ED_CONF_READ_TIMEOUT_MS);
+#if OPENEPT_ESP_USE_UART1 == 1
+    Serial1.begin(OPENEPT_ESP_UART1_BAUDRATE);
+#endif
     OPENEPT_SYNC_PIN_VALUE = 0;
-    return 1;
+    OPENEPT_TX_HEAD = 0;
+    OPENEPT_TX_TAIL = 0;
+    OPENEPT_TX_PROTECT = 0;
+    OPENEPT_TX_CUT = 0;
+    OPENEPT_TX_DROPPED = 0;
+#if defined(ARDUINO_ARCH_ESP8266)
+    schedule_recurrent_function_us([]() { OpenEPT_ED_Platform_ESP_Service(); return true; }, 0);
+#endif
+    return OPEN_EPT_STATUS_OK;
 }
 
 /**
  * @brief Sends a single character over UART.
  *
- * This function sends one character through UART2 using the HAL library.
+ * This function queues one character the same way as OpenEPT_ED_Platform_SendBuffer.
  *
  * @param character The character to be transmitted.
  * @return OPEN_EPT_STATUS_OK on successful transmission,
@@ -39,15 +145,133 @@ int OpenEPT_ED_Platform_Init()
  */
 int OpenEPT_ED_Platform_Send(char character)
 {
-    Serial.print(character);
+    return OpenEPT_ED_Platform_SendBuffer((const uint8_t*)&character, 1);
+}
+
+/**
+ * @brief Sends a buffer over UART.
+ *
+ * This function hands the whole frame to the UART driver with a single write call when
+ * it fits into the TX FIFO and nothing is waiting before it. Otherwise the frame is
+ * appended to the software ring and sent by OpenEPT_ED_Platform_ESP_Service, so the
+ * caller never waits for the wire.
+ *
+ * @param buffer Pointer to the data to be transmitted.
+ * @param size Number of bytes to transmit.
+ * @return OPEN_EPT_STATUS_OK on successful transmission,
+ *         OPEN_EPT_STATUS_ERROR if frame is discarded.
+ */
+int OpenEPT_ED_Platform_SendBuffer(const uint8_t* buffer, uint32_t size)
+{
+    uint32_t offset;
+    uint32_t chunk;
+
+    if(OPENEPT_TX_HEAD == OPENEPT_TX_TAIL && (uint32_t)OPENEPT_ESP_LINK.availableForWrite() >= size)
+    {
+        if(OPENEPT_ESP_LINK.write(buffer, size) != size) return OPEN_EPT_STATUS_ERROR;
+        return OPEN_EPT_STATUS_OK;
+    }
+
+    if(size > OPENEPT_ED_CONF_TX_RING_SIZE) return OPEN_EPT_STATUS_ERROR;
+    while(OPENEPT_ED_CONF_TX_RING_SIZE - (OPENEPT_TX_HEAD - OPENEPT_TX_TAIL) < size)
+    {
+#if OPENEPT_ED_CONF_TX_OVERFLOW_POLICY == OPENEPT_ED_TX_OVERFLOW_DROP
+        OPENEPT_TX_DROPPED += 1;
+        return OPEN_EPT_STATUS_ERROR;
+#else
+        OpenEPT_ED_Platform_ESP_Service();
+        yield();
+#endif
+    }
+
+    while(size > 0)
+    {
+        offset = OPENEPT_TX_HEAD & OPENEPT_ESP_TX_RING_MASK;
+        chunk = OPENEPT_ED_CONF_TX_RING_SIZE - offset;
+        if(chunk > size) chunk = size;
+        memcpy(&OPENEPT_TX_RING[offset], buffer, chunk);
+        buffer += chunk;
+        size -= chunk;
+        OPENEPT_TX_HEAD += chunk;
+    }
     return OPEN_EPT_STATUS_OK;
 }
 
+/**
+ * @brief Waits until all queued data is transmitted.
+ *
+ * Drains the software ring into the UART and waits for the UART to finish, or until
+ * OPENEPT_ED_CONF_TX_FLUSH_TIMEOUT_MS expires.
+ *
+ * @return OPEN_EPT_STATUS_OK if everything is transmitted,
+ *         OPEN_EPT_STATUS_ERROR on timeout.
+ */
+int OpenEPT_ED_Platform_Flush()
+{
+    uint32_t start = millis();
+    while(OPENEPT_TX_HEAD != OPENEPT_TX_TAIL)
+    {
+        OpenEPT_ED_Platform_ESP_Service();
+        if(millis() - start > OPENEPT_ED_CONF_TX_FLUSH_TIMEOUT_MS) return OPEN_EPT_STATUS_ERROR;
+        yield();
+    }
+    OPENEPT_ESP_LINK.flush();
+    return OPEN_EPT_STATUS_OK;
+}
+
+/**
+ * @brief Returns free space in the software transmit ring.
+ *
+ * @return Number of free bytes.
+ */
+uint32_t OpenEPT_ED_Platform_TxSpace()
+{
+    OpenEPT_ED_Platform_ESP_Service();
+    return OPENEPT_ED_CONF_TX_RING_SIZE - (OPENEPT_TX_HEAD - OPENEPT_TX_TAIL);
+}
+
+/**
+ * @brief Discards the oldest frame in the software transmit ring.
+ *
+ * Data up to the next 0x00 delimiter is dropped, the delimiter too when a frame starts at
+ * the tail. When the UART already took the beginning of a frame, the delimiter is kept to end
+ * that partial frame, which the receiver rejects, so the partial frame is the one lost; a
+ * further discard drops the next frame and keeps its delimiter instead. Nothing is dropped
+ * while protected frames wait in the ring.
+ *
+ * @return OPEN_EPT_STATUS_OK if a frame is discarded,
+ *         OPEN_EPT_STATUS_ERROR if the ring holds no complete unprotected frame.
+ */
+int OpenEPT_ED_Platform_TxDiscard()
+{
+    uint32_t pos = OPENEPT_TX_TAIL;
+
+    if((int32_t)(OPENEPT_TX_PROTECT - OPENEPT_TX_TAIL) > 0) return OPEN_EPT_STATUS_ERROR;
+    //Delimiter already kept for the partial frame, drop the frame after it
+    if(OPENEPT_TX_CUT && pos != OPENEPT_TX_HEAD && OPENEPT_TX_RING[pos & OPENEPT_ESP_TX_RING_MASK] == 0x00) pos++;
+    for(; pos != OPENEPT_TX_HEAD; pos++)
+    {
+        if(OPENEPT_TX_RING[pos & OPENEPT_ESP_TX_RING_MASK] != 0x00) continue;
+        OPENEPT_TX_TAIL = OPENEPT_TX_CUT ? pos : pos + 1;
+        return OPEN_EPT_STATUS_OK;
+    }
+    return OPEN_EPT_STATUS_ERROR;
+}
+
+/**
+ * @brief Protects frames queued so far from OpenEPT_ED_Platform_TxDiscard.
+ */
+void OpenEPT_ED_Platform_TxProtect()
+{
+    OPENEPT_TX_PROTECT = OPENEPT_TX_HEAD;
+}
+
 
 /**
  * @brief Read a single character over UART.
  *
- * This function Read one character through UART2 using the HAL library.
+ * This function reads one character from Serial, waiting for up to
+ * OPENEPT_ED_CONF_READ_TIMEOUT_MS (timeout is configured once in init).
  *
  * @param character Read character.
  * @return OPEN_EPT_STATUS_OK on successful transmission,
@@ -56,12 +280,92 @@ int OpenEPT_ED_Platform_Send(char character)
 int OpenEPT_ED_Platform_Read(char* character)
 {
     int ret = 0;
-    Serial.setTimeout(1000);
     ret = Serial.readBytes(character, 1);
     if(ret <= 0) return OPEN_EPT_STATUS_ERROR;
     return OPEN_EPT_STATUS_OK;
 }
 
+/**
+ * @brief Read a single character over UART if one is available.
+ *
+ * @param character Read character.
+ * @return OPEN_EPT_STATUS_OK if character is read,
+ *         OPEN_EPT_STATUS_ERROR if nothing is received.
+ */
+int OpenEPT_ED_Platform_TryRead(char* character)
+{
+    int data = Serial.read();
+    if(data < 0) return OPEN_EPT_STATUS_ERROR;
+    *character = (char)data;
+    return OPEN_EPT_STATUS_OK;
+}
+
+/**
+ * @brief Changes link baud rate.
+ *
+ * Receive side (Serial) and, when used, transmit side (UART1) are switched together. Serial
+ * TX follows the Serial RX rate, also with UART1.
+ *
+ * @param baudrate New baud rate, 0 restores rates set by OpenEPT_ED_Platform_Init.
+ * @return OPEN_EPT_STATUS_OK.
+ */
+int OpenEPT_ED_Platform_Reconfigure(uint32_t baudrate)
+{
+    OPENEPT_ESP_LINK.flush();
+#if OPENEPT_ESP_USE_UART1 == 1
+    Serial1.updateBaudRate(baudrate == 0 ? OPENEPT_ESP_UART1_BAUDRATE : baudrate);
+#endif
+    Serial.updateBaudRate(baudrate == 0 ? OPENEPT_ESP_RX_BAUDRATE : baudrate);
+    return OPEN_EPT_STATUS_OK;
+}
+
+/**
+ * @brief Millisecond tick.
+ *
+ * @return Arduino millis() counter.
+ */
+uint32_t OpenEPT_ED_Platform_GetTickMs()
+{
+    return millis();
+}
+
+/**
+ * @brief Event timestamp.
+ *
+ * CPU cycle counter extended to 64 bits, millis() resolves wraps; or microseconds when
+ * OPENEPT_ESP_TIMESTAMP_CYCLES is 0.
+ *
+ * @return Ticks of OpenEPT_ED_Platform_GetTimestampFrequency.
+ */
+uint64_t OpenEPT_ED_Platform_GetTimestamp()
+{
+#if OPENEPT_ESP_TIMESTAMP_CYCLES == 1
+    uint64_t timestamp;
+    noInterrupts();
+    timestamp = OpenEPT_ED_ExtendCounter(&OPENEPT_CYCLES, ESP.getCycleCount(), millis(), OpenEPT_ED_Platform_GetTimestampFrequency());
+    interrupts();
+    return timestamp;
+#elif defined(ARDUINO_ARCH_ESP8266)
+    return micros64();
+#else
+    return (uint64_t)esp_timer_get_time();
+#endif
+}
+
+/**
+ * @brief Event timestamp frequency.
+ *
+ * @return CPU clock or 1 MHz, depending on OPENEPT_ESP_TIMESTAMP_CYCLES.
+ */
+uint32_t OpenEPT_ED_Platform_GetTimestampFrequency()
+{
+#if OPENEPT_ESP_TIMESTAMP_CYCLES == 1
+    return ESP.getCpuFreqMHz() * 1000000u;
+#else
+    return 1000000u;
+#endif
+}
+
 /**
  * @brief Synchronizes up by setting GPIOA pin 5 to HIGH.
  *
@@ -106,4 +410,4 @@ int OpenEPT_ED_Platform_SyncToogle()
     OPENEPT_SYNC_PIN_VALUE = OPENEPT_SYNC_PIN_VALUE == 0 ? 1 : 0;
     digitalWrite(SYNC_PIN, OPENEPT_SYNC_PIN_VALUE);
     return OPEN_EPT_STATUS_OK;
-}
\ No newline at end of file
+}
@@ -0,0 +1,357 @@
+/**
+ * @file platform_freertos.c
+ * @brief FreeRTOS integration, events are sent by a low priority drain task.
+ *
+ * Tasks and interrupt handlers only copy their events into a FreeRTOS queue (the FromISR
+ * variant inside interrupts) and return; the drain task takes them and owns the transport.
+ * Start, stop, poll and other control calls of application tasks take a mutex shared with
+ * the drain task, so the transport of the underlying port (STM32, POSIX, ...) is never used
+ * by two tasks at once. Queue and mutex protect themselves with the kernel critical
+ * sections. Only one context is moved to a drain task. With platform_freertos_trace.h
+ * included in FreeRTOSConfig.h the drain task also sends a marker for every task switch.
+ *
+ * @date November 3, 2024
+ * @author Dimitrije Lilic, Haris Turkmanovic
+ */
+#include <string.h>
+#include "FreeRTOS.h"
+#include "task.h"
+#include "queue.h"
+#include "semphr.h"
+#include "../../feplib/feplib.h"
+#include "../../feplib/platform.h"
+#include "platform_freertos.h"
+
+
+/* Events waiting for the drain task */
+#ifndef OPENEPT_FREERTOS_QUEUE_LENGTH
+#define OPENEPT_FREERTOS_QUEUE_LENGTH       64
+#endif
+
+/* Drain task priority, idle so it only uses time no application task needs */
+#ifndef OPENEPT_FREERTOS_TASK_PRIORITY
+#define OPENEPT_FREERTOS_TASK_PRIORITY      tskIDLE_PRIORITY
+#endif
+
+/* Drain task stack (words) */
+#ifndef OPENEPT_FREERTOS_TASK_STACK
+#define OPENEPT_FREERTOS_TASK_STACK         (configMINIMAL_STACK_SIZE * 4)
+#endif
+
+/* Drain task polls the context (handshake, batch age, clock sync) at least this often */
+#ifndef OPENEPT_FREERTOS_POLL_MS
+#define OPENEPT_FREERTOS_POLL_MS            10
+#endif
+
+/* Longest wait of a control call (e.g. STOP) for events queued before it */
+#ifndef OPENEPT_FREERTOS_DRAIN_TIMEOUT_MS
+#define OPENEPT_FREERTOS_DRAIN_TIMEOUT_MS   100
+#endif
+
+/* Interrupt context check, for ports without xPortIsInsideInterrupt define it before building */
+#ifndef OPENEPT_FREERTOS_IN_ISR
+#define OPENEPT_FREERTOS_IN_ISR()           (xPortIsInsideInterrupt() != pdFALSE)
+#endif
+
+/* Task switch markers, set by platform_freertos_trace.h in FreeRTOSConfig.h */
+#ifndef OPENEPT_FREERTOS_TASK_SWITCHES
+#define OPENEPT_FREERTOS_TASK_SWITCHES      0
+#endif
+
+/* Task switches waiting for the drain task, power of two */
+#ifndef OPENEPT_FREERTOS_SWITCH_SLOTS
+#define OPENEPT_FREERTOS_SWITCH_SLOTS       128
+#endif
+
+/* Tasks with an ID and a name in the task table, later tasks are sent as ID 0 */
+#ifndef OPENEPT_FREERTOS_TASKS
+#define OPENEPT_FREERTOS_TASKS              32
+#endif
+
+/* Measure the task switch hook in cycles, see OpenEPT_ED_Platform_FreeRTOS_ProfileSwitches */
+#ifndef OPENEPT_FREERTOS_PROFILE
+#define OPENEPT_FREERTOS_PROFILE            0
+#endif
+
+/* Cycle counter read by the profile, e.g. DWT->CYCCNT on Cortex-M3 and newer */
+#if OPENEPT_FREERTOS_PROFILE == 1 && !defined(OPENEPT_FREERTOS_CYCLES)
+#error "OPENEPT_FREERTOS_PROFILE needs OPENEPT_FREERTOS_CYCLES() returning the CPU cycle counter"
+#endif
+
+#if (OPENEPT_FREERTOS_SWITCH_SLOTS & (OPENEPT_FREERTOS_SWITCH_SLOTS - 1)) != 0
+#error "OPENEPT_FREERTOS_SWITCH_SLOTS must be a power of two"
+#endif
+
+static OpenEPT_ED_TransportOps  OPENEPT_FREERTOS_OPS;
+static QueueHandle_t            OPENEPT_FREERTOS_QUEUE;
+static SemaphoreHandle_t        OPENEPT_FREERTOS_MUTEX;
+static TaskHandle_t             OPENEPT_FREERTOS_TASK;
+
+#if OPENEPT_FREERTOS_TASK_SWITCHES == 1
+typedef struct
+{
+    uint64_t    timestamp;
+    uint32_t    task;
+}OpenEPT_ED_Platform_FreeRTOS_Switch;
+
+/*
+ * Switch ring. Only the switch hook writes it, with the kernel in a critical section, and
+ * only the drain task reads it, so free running head and tail need no lock.
+ */
+static OpenEPT_ED_Platform_FreeRTOS_Switch  OPENEPT_FREERTOS_SWITCHES[OPENEPT_FREERTOS_SWITCH_SLOTS];
+static uint32_t                             OPENEPT_FREERTOS_SWITCH_HEAD;
+static uint32_t                             OPENEPT_FREERTOS_SWITCH_TAIL;
+static OpenEPT_ED_Context*                  OPENEPT_FREERTOS_CTX;
+
+/* Task table, task ID is index + 1 */
+static char                                 OPENEPT_FREERTOS_TASK_NAMES[OPENEPT_FREERTOS_TASKS][configMAX_TASK_NAME_LEN];
+static uint32_t                             OPENEPT_FREERTOS_TASK_COUNT;
+/* Task table entries sent in the session the context had when they were sent */
+static uint32_t                             OPENEPT_FREERTOS_TASKS_SENT;
+static uint32_t                             OPENEPT_FREERTOS_TASKS_SESSION;
+#if OPENEPT_FREERTOS_PROFILE == 1
+/* Cycles spent in the switch hook, written by the hook only */
+static uint64_t                             OPENEPT_FREERTOS_PROFILE_CYCLES;
+static uint32_t                             OPENEPT_FREERTOS_PROFILE_SWITCHES;
+static uint32_t                             OPENEPT_FREERTOS_PROFILE_MAX;
+#endif
+#endif
+
+
+
+static int OpenEPT_ED_Platform_FreeRTOS_QueueEvent(void* arg, const OpenEPT_ED_RingSlot* slot)
+{
+    BaseType_t woken = pdFALSE;
+    BaseType_t status;
+
+    (void)arg;
+    if(OPENEPT_FREERTOS_IN_ISR())
+    {
+        status = xQueueSendToBackFromISR(OPENEPT_FREERTOS_QUEUE, slot, &woken);
+        portYIELD_FROM_ISR(woken);
+    }
+    else
+    {
+        //Tasks never wait for the drain task, full queue drops the event
+        status = xQueueSendToBack(OPENEPT_FREERTOS_QUEUE, slot, 0);
+    }
+    return status == pdPASS ? OPEN_EPT_STATUS_OK : OPEN_EPT_STATUS_ERROR;
+}
+
+static void OpenEPT_ED_Platform_FreeRTOS_Lock(void* arg)
+{
+    TickType_t start;
+
+    (void)arg;
+    //Before the scheduler runs there is only one context of execution
+    if(xTaskGetSchedulerState() == taskSCHEDULER_NOT_STARTED) return;
+    if(xTaskGetCurrentTaskHandle() != OPENEPT_FREERTOS_TASK)
+    {
+        //Control frames of application tasks follow the events they queued before
+        start = xTaskGetTickCount();
+        while(uxQueueMessagesWaiting(OPENEPT_FREERTOS_QUEUE) != 0 && xTaskGetTickCount() - start < pdMS_TO_TICKS(OPENEPT_FREERTOS_DRAIN_TIMEOUT_MS))
+        {
+            vTaskDelay(1);
+        }
+    }
+    xSemaphoreTake(OPENEPT_FREERTOS_MUTEX, portMAX_DELAY);
+}
+
+static void OpenEPT_ED_Platform_FreeRTOS_Unlock(void* arg)
+{
+    (void)arg;
+    if(xTaskGetSchedulerState() == taskSCHEDULER_NOT_STARTED) return;
+    xSemaphoreGive(OPENEPT_FREERTOS_MUTEX);
+}
+
+#if OPENEPT_FREERTOS_TASK_SWITCHES == 1
+
+/**
+ * @brief traceTASK_CREATE hook, gives the task its ID and records its name.
+ *
+ * Runs inside the kernel critical section of task creation, so the table needs no lock.
+ *
+ * @param task Created task.
+ */
+void OpenEPT_ED_Platform_FreeRTOS_TaskCreated(void* task)
+{
+    uint32_t index = OPENEPT_FREERTOS_TASK_COUNT;
+
+    if(index >= OPENEPT_FREERTOS_TASKS) return;
+    strncpy(OPENEPT_FREERTOS_TASK_NAMES[index], pcTaskGetName((TaskHandle_t)task), configMAX_TASK_NAME_LEN - 1);
+    vTaskSetTaskNumber((TaskHandle_t)task, index + 1);
+    __atomic_store_n(&OPENEPT_FREERTOS_TASK_COUNT, index + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief traceTASK_SWITCHED_IN hook, stores timestamp and ID of the task switched in.
+ *
+ * Costs a timestamp read (OpenEPT_ED_Platform_GetTimestamp, called directly) and two
+ * stores into a reserved slot; nothing is recorded outside sessions with timestamps. A
+ * full ring drops the switch and counts it with the dropped frames. Switches to the drain
+ * task are recorded like any other, see OpenEPT_ED_Platform_FreeRTOS_Init.
+ *
+ * @param task Task switched in.
+ */
+void OpenEPT_ED_Platform_FreeRTOS_TaskSwitchedIn(void* task)
+{
+    OpenEPT_ED_Context* ctx = OPENEPT_FREERTOS_CTX;
+    OpenEPT_ED_Platform_FreeRTOS_Switch* slot;
+    uint32_t head = OPENEPT_FREERTOS_SWITCH_HEAD;
+#if OPENEPT_FREERTOS_PROFILE == 1
+    uint32_t start = OPENEPT_FREERTOS_CYCLES();
+    uint32_t cycles;
+#endif
+
+    if(ctx == NULL || ctx->timebase == 0) return;
+    if(head - __atomic_load_n(&OPENEPT_FREERTOS_SWITCH_TAIL, __ATOMIC_ACQUIRE) == OPENEPT_FREERTOS_SWITCH_SLOTS)
+    {
+        __atomic_fetch_add(&ctx->queueDropped, 1, __ATOMIC_RELAXED);
+        return;
+    }
+    slot = &OPENEPT_FREERTOS_SWITCHES[head & (OPENEPT_FREERTOS_SWITCH_SLOTS - 1)];
+    slot->timestamp = OpenEPT_ED_Platform_GetTimestamp();
+    slot->task = (uint32_t)uxTaskGetTaskNumber((TaskHandle_t)task);
+    __atomic_store_n(&OPENEPT_FREERTOS_SWITCH_HEAD, head + 1, __ATOMIC_RELEASE);
+#if OPENEPT_FREERTOS_PROFILE == 1
+    cycles = OPENEPT_FREERTOS_CYCLES() - start;
+    OPENEPT_FREERTOS_PROFILE_CYCLES += cycles;
+    OPENEPT_FREERTOS_PROFILE_SWITCHES += 1;
+    if(cycles > OPENEPT_FREERTOS_PROFILE_MAX) OPENEPT_FREERTOS_PROFILE_MAX = cycles;
+#endif
+}
+
+#if OPENEPT_FREERTOS_PROFILE == 1
+/**
+ * @brief Cost of the task switch hook since the previous call.
+ *
+ * Cycles are counted with OPENEPT_FREERTOS_CYCLES() from entry of the hook until the slot
+ * is published, for switches recorded in a session; the count includes one counter read.
+ *
+ * @param average Average cycles per recorded switch, 0 if none was recorded.
+ * @param maximum Largest cycles of one switch.
+ * @return Number of recorded switches.
+ */
+uint32_t OpenEPT_ED_Platform_FreeRTOS_ProfileSwitches(uint32_t* average, uint32_t* maximum)
+{
+    uint32_t switches;
+
+    //Hook runs from the kernel, keep it out while the totals are taken
+    taskENTER_CRITICAL();
+    switches = OPENEPT_FREERTOS_PROFILE_SWITCHES;
+    *average = switches != 0 ? (uint32_t)(OPENEPT_FREERTOS_PROFILE_CYCLES / switches) : 0;
+    *maximum = OPENEPT_FREERTOS_PROFILE_MAX;
+    OPENEPT_FREERTOS_PROFILE_CYCLES = 0;
+    OPENEPT_FREERTOS_PROFILE_SWITCHES = 0;
+    OPENEPT_FREERTOS_PROFILE_MAX = 0;
+    taskEXIT_CRITICAL();
+    return switches;
+}
+#endif
+
+/*
+ * Send task table entries the current session has not seen, then task switches up to the
+ * given time, so switches and queued events reach the Acquisition device in time order.
+ */
+static void OpenEPT_ED_Platform_FreeRTOS_SendSwitches(OpenEPT_ED_Context* ctx, uint64_t until)
+{
+    uint32_t count = __atomic_load_n(&OPENEPT_FREERTOS_TASK_COUNT, __ATOMIC_ACQUIRE);
+    uint32_t head = __atomic_load_n(&OPENEPT_FREERTOS_SWITCH_HEAD, __ATOMIC_ACQUIRE);
+    uint32_t tail = OPENEPT_FREERTOS_SWITCH_TAIL;
+    OpenEPT_ED_Platform_FreeRTOS_Switch* slot;
+
+    if(OPENEPT_FREERTOS_TASKS_SESSION != ctx->session)
+    {
+        OPENEPT_FREERTOS_TASKS_SESSION = ctx->session;
+        OPENEPT_FREERTOS_TASKS_SENT = 0;
+    }
+    for(; OPENEPT_FREERTOS_TASKS_SENT < count; OPENEPT_FREERTOS_TASKS_SENT++)
+    {
+        OpenEPT_ED_Ctx_DefineTask(ctx, OPENEPT_FREERTOS_TASKS_SENT + 1, OPENEPT_FREERTOS_TASK_NAMES[OPENEPT_FREERTOS_TASKS_SENT]);
+    }
+    for(; tail != head; tail++)
+    {
+        slot = &OPENEPT_FREERTOS_SWITCHES[tail & (OPENEPT_FREERTOS_SWITCH_SLOTS - 1)];
+        if(slot->timestamp > until) break;
+        OpenEPT_ED_Ctx_SendTask(ctx, slot->timestamp, slot->task);
+        __atomic_store_n(&OPENEPT_FREERTOS_SWITCH_TAIL, tail + 1, __ATOMIC_RELEASE);
+    }
+}
+
+#endif /* OPENEPT_FREERTOS_TASK_SWITCHES == 1 */
+
+static void OpenEPT_ED_Platform_FreeRTOS_DrainTask(void* param)
+{
+    OpenEPT_ED_Context* ctx = (OpenEPT_ED_Context*)param;
+    OpenEPT_ED_RingSlot slot;
+    TickType_t lastPoll = xTaskGetTickCount();
+
+    for(;;)
+    {
+        if(xQueuePeek(OPENEPT_FREERTOS_QUEUE, &slot, pdMS_TO_TICKS(OPENEPT_FREERTOS_POLL_MS)) == pdPASS)
+        {
+#if OPENEPT_FREERTOS_TASK_SWITCHES == 1
+            OpenEPT_ED_Platform_FreeRTOS_SendSwitches(ctx, slot.timestamp);
+#endif
+            OpenEPT_ED_Ctx_SendQueued(ctx, &slot);
+            //Event leaves the queue once sent, so control calls waiting for an empty queue follow it
+            xQueueReceive(OPENEPT_FREERTOS_QUEUE, &slot, 0);
+        }
+#if OPENEPT_FREERTOS_TASK_SWITCHES == 1
+        else
+        {
+            OpenEPT_ED_Platform_FreeRTOS_SendSwitches(ctx, UINT64_MAX);
+        }
+#endif
+        //Steady event stream must not starve handshake responses and batch age
+        if(xTaskGetTickCount() - lastPoll >= pdMS_TO_TICKS(OPENEPT_FREERTOS_POLL_MS))
+        {
+            OpenEPT_ED_Ctx_Poll(ctx);
+            lastPoll = xTaskGetTickCount();
+        }
+    }
+}
+
+/**
+ * @brief Moves transmission of the context to a drain task.
+ *
+ * Creates the event queue, the mutex and the drain task and installs a copy of the context
+ * transport operations with queueEvent, lock and unlock added.
+ *
+ * With task switch markers, switch timestamps are read with OpenEPT_ED_Platform_GetTimestamp,
+ * so the context must take event timestamps from the platform too. The drain task
+ * ("openept") is a task like any other there: every switch to it is recorded, and its time
+ * in the per-task split is the cost of sending the trace. Idle at the default priority, it
+ * still wakes every OPENEPT_FREERTOS_POLL_MS, which adds two switches per period.
+ *
+ * @param ctx Initialized context.
+ * @return OPEN_EPT_STATUS_OK on success,
+ *         OPEN_EPT_STATUS_ERROR if kernel objects can not be created, the context already
+ *         has a drain task or, with task switch markers, its timestamps do not come from
+ *         the platform.
+ */
+int OpenEPT_ED_Platform_FreeRTOS_Init(OpenEPT_ED_Context* ctx)
+{
+    if(ctx == NULL || ctx->ops == NULL || OPENEPT_FREERTOS_QUEUE != NULL) return OPEN_EPT_STATUS_ERROR;
+#if OPENEPT_FREERTOS_TASK_SWITCHES == 1
+    if(ctx->ops->getTimestamp != OpenEPT_ED_PlatformTransportOps.getTimestamp) return OPEN_EPT_STATUS_ERROR;
+#endif
+    OPENEPT_FREERTOS_QUEUE = xQueueCreate(OPENEPT_FREERTOS_QUEUE_LENGTH, sizeof(OpenEPT_ED_RingSlot));
+    OPENEPT_FREERTOS_MUTEX = xSemaphoreCreateMutex();
+    if(OPENEPT_FREERTOS_QUEUE == NULL || OPENEPT_FREERTOS_MUTEX == NULL) return OPEN_EPT_STATUS_ERROR;
+
+    OPENEPT_FREERTOS_OPS = *ctx->ops;
+    OPENEPT_FREERTOS_OPS.queueEvent = OpenEPT_ED_Platform_FreeRTOS_QueueEvent;
+    OPENEPT_FREERTOS_OPS.lock = OpenEPT_ED_Platform_FreeRTOS_Lock;
+    OPENEPT_FREERTOS_OPS.unlock = OpenEPT_ED_Platform_FreeRTOS_Unlock;
+    if(OpenEPT_ED_Ctx_SetTransport(ctx, &OPENEPT_FREERTOS_OPS, ctx->arg) != OPEN_EPT_STATUS_OK) return OPEN_EPT_STATUS_ERROR;
+#if OPENEPT_FREERTOS_TASK_SWITCHES == 1
+    OPENEPT_FREERTOS_CTX = ctx;
+#endif
+
+    if(xTaskCreate(OpenEPT_ED_Platform_FreeRTOS_DrainTask, "openept", OPENEPT_FREERTOS_TASK_STACK, ctx, OPENEPT_FREERTOS_TASK_PRIORITY, &OPENEPT_FREERTOS_TASK) != pdPASS)
+    {
+        return OPEN_EPT_STATUS_ERROR;
+    }
+    return OPEN_EPT_STATUS_OK;
+}
@@ -0,0 +1,27 @@
+#ifndef PLATFORM_FREERTOS_H_
+#define PLATFORM_FREERTOS_H_
+
+#include "../../feplib/feplib.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Move transmission of a context to a drain task. Call after the context is initialized
+ * (OpenEPT_ED_Init or OpenEPT_ED_Ctx_Init) and before the scheduler starts; the context
+ * keeps its transport, which from then on is used only with the context mutex held.
+ */
+int OpenEPT_ED_Platform_FreeRTOS_Init(OpenEPT_ED_Context* ctx);
+
+/*
+ * Average and largest cycles of the task switch hook since the previous call, returns the
+ * number of switches measured. Built with OPENEPT_FREERTOS_PROFILE set to 1 only.
+ */
+uint32_t OpenEPT_ED_Platform_FreeRTOS_ProfileSwitches(uint32_t* average, uint32_t* maximum);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
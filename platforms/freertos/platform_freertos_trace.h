@@ -0,0 +1,46 @@
+/**
+ * @file platform_freertos_trace.h
+ * @brief FreeRTOS trace hooks that mark every task switch on the EP link.
+ *
+ * Include at the end of FreeRTOSConfig.h. Task creation assigns the task a compact ID
+ * (vTaskSetTaskNumber) and records its name; every switch stores the timestamp and the ID
+ * of the task switched in into a reserved ring that the drain task of platform_freertos.c
+ * sends. The Acquisition device attributes the trace between two switches to the task
+ * switched in by the first one. Switches to the drain task itself ("openept") are recorded
+ * too, so its time shows as a task of its own rather than being charged to another one.
+ *
+ * @date November 3, 2024
+ * @author Dimitrije Lilic, Haris Turkmanovic
+ */
+#ifndef PLATFORM_FREERTOS_TRACE_H_
+#define PLATFORM_FREERTOS_TRACE_H_
+
+#if configUSE_TRACE_FACILITY != 1
+#error "Task switch markers need configUSE_TRACE_FACILITY set to 1"
+#endif
+
+#if defined(configNUMBER_OF_CORES) && configNUMBER_OF_CORES > 1
+#error "Task switch markers support single core kernels only"
+#endif
+
+/* Enables task switch markers in platform_freertos.c */
+#define OPENEPT_FREERTOS_TASK_SWITCHES      1
+
+#ifndef __ASSEMBLER__
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Called by the kernel with the task handle, never directly */
+void OpenEPT_ED_Platform_FreeRTOS_TaskCreated(void* task);
+void OpenEPT_ED_Platform_FreeRTOS_TaskSwitchedIn(void* task);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
+
+#define traceTASK_CREATE(pxNewTCB)          OpenEPT_ED_Platform_FreeRTOS_TaskCreated(pxNewTCB)
+#define traceTASK_SWITCHED_IN()             OpenEPT_ED_Platform_FreeRTOS_TaskSwitchedIn(pxCurrentTCB)
+
+#endif
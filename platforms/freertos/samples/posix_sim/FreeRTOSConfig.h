@@ -0,0 +1,64 @@
+/**
+ * @file FreeRTOSConfig.h
+ * @brief Kernel configuration of the OpenEPT sample for the FreeRTOS POSIX simulator port.
+ *
+ * Tasks are host threads of portable/ThirdParty/GCC/Posix, the EP link is the POSIX port of
+ * this repository. Task switch markers are enabled, so the sample also exercises
+ * platform_freertos_trace.h.
+ */
+#ifndef FREERTOS_CONFIG_H
+#define FREERTOS_CONFIG_H
+
+#define configUSE_PREEMPTION                        1
+#define configUSE_PORT_OPTIMISED_TASK_SELECTION     0
+#define configUSE_IDLE_HOOK                         0
+#define configUSE_TICK_HOOK                         0
+#define configUSE_DAEMON_TASK_STARTUP_HOOK          0
+#define configTICK_RATE_HZ                          1000
+#define configMAX_PRIORITIES                        8
+/* Words; tasks are host threads, printf and the link write need a host sized stack */
+#define configMINIMAL_STACK_SIZE                    4096
+#define configMAX_TASK_NAME_LEN                     16
+#define configUSE_16_BIT_TICKS                      0
+#define configIDLE_SHOULD_YIELD                     1
+#define configUSE_TASK_NOTIFICATIONS                1
+#define configUSE_MUTEXES                           1
+#define configUSE_RECURSIVE_MUTEXES                 0
+#define configUSE_COUNTING_SEMAPHORES               0
+#define configQUEUE_REGISTRY_SIZE                   0
+#define configUSE_TIMERS                            0
+#define configUSE_CO_ROUTINES                       0
+#define configCHECK_FOR_STACK_OVERFLOW              0
+#define configUSE_MALLOC_FAILED_HOOK                0
+#define configSUPPORT_DYNAMIC_ALLOCATION            1
+#define configSUPPORT_STATIC_ALLOCATION             0
+/* heap_3.c, kernel objects come from the host malloc */
+#define configTOTAL_HEAP_SIZE                       (256 * 1024)
+
+/* Task numbers and pxCurrentTCB for the task switch markers */
+#define configUSE_TRACE_FACILITY                    1
+#define configGENERATE_RUN_TIME_STATS               0
+
+#define INCLUDE_vTaskDelay                          1
+#define INCLUDE_vTaskDelete                         1
+#define INCLUDE_xTaskGetSchedulerState              1
+#define INCLUDE_xTaskGetCurrentTaskHandle           1
+
+#define configASSERT(x)                             do { if(!(x)) { vAssertCalled(__FILE__, __LINE__); } } while(0)
+
+#ifndef __ASSEMBLER__
+void vAssertCalled(const char* file, unsigned long line);
+#endif
+
+/* The simulator has no application interrupts, events only come from tasks */
+#define OPENEPT_FREERTOS_IN_ISR()                   0
+
+/* Task switch hook cost in time stamp counter ticks, the nearest the host has to CPU cycles */
+#if defined(__x86_64__) || defined(__i386__)
+#define OPENEPT_FREERTOS_PROFILE                    1
+#define OPENEPT_FREERTOS_CYCLES()                   ((uint32_t)__builtin_ia32_rdtsc())
+#endif
+
+#include "platform_freertos_trace.h"
+
+#endif
@@ -0,0 +1,120 @@
+/**
+ * @file main.c
+ * @brief Energy point markers from FreeRTOS tasks on the POSIX simulator port.
+ *
+ * Two worker tasks set MARKERS energy points each while the drain task of
+ * platform_freertos.c sends them over the POSIX port (OPENEPT_LINK) to openept_emu. The
+ * control task runs START and STOP and prints how long each marker call took, the dropped
+ * count and the STOP result. Task switch markers let openept_emu split the session per task;
+ * on x86 hosts the control task also prints the cost of the task switch hook in TSC ticks.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include "FreeRTOS.h"
+#include "task.h"
+#include "feplib.h"
+#include "platform.h"
+#include "platform_freertos.h"
+
+#define MARKERS             1000
+#define WORKERS             2
+#define WORKER_PRIORITY     (tskIDLE_PRIORITY + 2)
+#define CONTROL_PRIORITY    (tskIDLE_PRIORITY + 3)
+
+typedef struct
+{
+    TaskHandle_t    task;
+    uint64_t        min;
+    uint64_t        max;
+    uint64_t        sum;
+}OpenEPT_Sample_Worker;
+
+static OpenEPT_Sample_Worker    OPENEPT_SAMPLE_WORKERS[WORKERS];
+static TaskHandle_t             OPENEPT_SAMPLE_CONTROL;
+
+void vAssertCalled(const char* file, unsigned long line)
+{
+    printf("openept: assert %s:%lu\n", file, line);
+    abort();
+}
+
+static void OpenEPT_Sample_Worker_Run(void* param)
+{
+    OpenEPT_Sample_Worker* worker = (OpenEPT_Sample_Worker*)param;
+    uint64_t start;
+    uint64_t ns;
+    uint32_t cnt;
+
+    worker->min = UINT64_MAX;
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    for(cnt = 0; cnt < MARKERS; cnt++)
+    {
+        start = OpenEPT_ED_Platform_GetTimestamp();
+        if(worker == &OPENEPT_SAMPLE_WORKERS[0]) OPENEPT_EP("worker0");
+        else OPENEPT_EP("worker1");
+        ns = OpenEPT_ED_Platform_GetTimestamp() - start;
+        if(ns < worker->min) worker->min = ns;
+        if(ns > worker->max) worker->max = ns;
+        worker->sum += ns;
+        //Give the other worker and the drain task a chance, as an application would
+        if(cnt % 10 == 9) vTaskDelay(1);
+    }
+    xTaskNotifyGive(OPENEPT_SAMPLE_CONTROL);
+    vTaskDelete(NULL);
+}
+
+static void OpenEPT_Sample_Control_Run(void* param)
+{
+    uint32_t cnt;
+    int status;
+#if OPENEPT_FREERTOS_PROFILE == 1
+    uint32_t average;
+    uint32_t maximum;
+    uint32_t switches;
+#endif
+
+    (void)param;
+    //Wait for the Acquisition side (openept_emu) to attach to the link
+    while(OpenEPT_ED_Start() != OPEN_EPT_STATUS_OK) printf("openept: waiting for Acquisition device\n");
+    for(cnt = 0; cnt < WORKERS; cnt++) xTaskNotifyGive(OPENEPT_SAMPLE_WORKERS[cnt].task);
+    for(cnt = 0; cnt < WORKERS; cnt++) ulTaskNotifyTake(pdFALSE, portMAX_DELAY);
+
+    for(cnt = 0; cnt < WORKERS; cnt++)
+    {
+        printf("openept: worker%u %u markers, ns min %llu avg %llu max %llu\n", (unsigned)cnt, MARKERS,
+               (unsigned long long)OPENEPT_SAMPLE_WORKERS[cnt].min, (unsigned long long)(OPENEPT_SAMPLE_WORKERS[cnt].sum / MARKERS),
+               (unsigned long long)OPENEPT_SAMPLE_WORKERS[cnt].max);
+    }
+#if OPENEPT_FREERTOS_PROFILE == 1
+    switches = OpenEPT_ED_Platform_FreeRTOS_ProfileSwitches(&average, &maximum);
+    printf("openept: %u task switches, hook cycles avg %u max %u\n", (unsigned)switches, (unsigned)average, (unsigned)maximum);
+#endif
+    status = OpenEPT_ED_Stop();
+    printf("openept: %u dropped, stop %d\n", OpenEPT_ED_GetDropped(), status);
+    exit(status == OPEN_EPT_STATUS_OK ? 0 : 1);
+}
+
+int main(void)
+{
+    uint32_t cnt;
+    char name[configMAX_TASK_NAME_LEN];
+
+    if(OpenEPT_ED_Init() != OPEN_EPT_STATUS_OK)
+    {
+        printf("openept: link init failed, set OPENEPT_LINK\n");
+        return 1;
+    }
+    if(OpenEPT_ED_Platform_FreeRTOS_Init(OpenEPT_ED_GetDefaultContext()) != OPEN_EPT_STATUS_OK)
+    {
+        printf("openept: drain task not created\n");
+        return 1;
+    }
+    xTaskCreate(OpenEPT_Sample_Control_Run, "control", configMINIMAL_STACK_SIZE, NULL, CONTROL_PRIORITY, &OPENEPT_SAMPLE_CONTROL);
+    for(cnt = 0; cnt < WORKERS; cnt++)
+    {
+        snprintf(name, sizeof(name), "worker%u", (unsigned)cnt);
+        xTaskCreate(OpenEPT_Sample_Worker_Run, name, configMINIMAL_STACK_SIZE, &OPENEPT_SAMPLE_WORKERS[cnt], WORKER_PRIORITY, &OPENEPT_SAMPLE_WORKERS[cnt].task);
+    }
+    vTaskStartScheduler();
+    return 1;
+}
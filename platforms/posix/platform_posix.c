@@ -0,0 +1,404 @@
+/**
+ * @file platform_posix.c
+ * @brief Platform-specific implementation for POSIX hosts.
+ *
+ * This file implements the OpenEPT Embedded Device (ED) platform functions over a file
+ * descriptor (pty, serial tty, UNIX socket or pipe pair). SYNC pin edges are written as
+ * timestamped records to a side channel descriptor instead of driving a GPIO.
+ *
+ * @date November 3, 2024
+ * @author Dimitrije Lilic, Haris Turkmanovic
+ */
+#ifndef _DEFAULT_SOURCE
+#define _DEFAULT_SOURCE
+#endif
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#include "../../feplib/feplib.h"
+#include "../../feplib/platform.h"
+#include "platform_posix.h"
+
+
+/* Environment variable with path of the EP link device, used when no descriptor is set */
+#ifndef OPENEPT_POSIX_LINK_ENV
+#define OPENEPT_POSIX_LINK_ENV      "OPENEPT_LINK"
+#endif
+
+/* Environment variable with path of the SYNC side channel, used when no descriptor is set */
+#ifndef OPENEPT_POSIX_SYNC_ENV
+#define OPENEPT_POSIX_SYNC_ENV      "OPENEPT_SYNC"
+#endif
+
+/* Initial baud rate when the link is a serial tty */
+#ifndef OPENEPT_POSIX_BAUDRATE
+#define OPENEPT_POSIX_BAUDRATE      115200
+#endif
+
+/* Maximum number of segments passed to one writev call */
+#define OPENEPT_POSIX_MAX_SEGMENTS  8
+
+static int      OPENEPT_LINK_TX_FD = -1;
+static int      OPENEPT_LINK_RX_FD = -1;
+static int      OPENEPT_SYNC_FD = -1;
+static uint8_t  OPENEPT_SYNC_PIN_VALUE;
+static __thread void* OPENEPT_THREAD_BUFFER;
+
+
+/**
+ * @brief Sets descriptors used for the EP link.
+ *
+ * Must be called before OpenEPT_ED_Init. The same descriptor may be used for both
+ * directions (pty, tty, socket); with pipes pass the write end as txFd and read end as rxFd.
+ * Descriptors stay owned by the caller.
+ *
+ * @param txFd Descriptor frames are written to.
+ * @param rxFd Descriptor responses are read from, -1 if responses are not expected.
+ */
+void OpenEPT_ED_Platform_POSIX_SetLinkFd(int txFd, int rxFd)
+{
+    OPENEPT_LINK_TX_FD = txFd;
+    OPENEPT_LINK_RX_FD = rxFd;
+}
+
+/**
+ * @brief Sets descriptor SYNC edges are recorded to.
+ *
+ * Every edge is written as one text line "<CLOCK_MONOTONIC ns> <level>\n". Pass -1 to
+ * disable recording.
+ *
+ * @param fd Side channel descriptor.
+ */
+void OpenEPT_ED_Platform_POSIX_SetSyncFd(int fd)
+{
+    OPENEPT_SYNC_FD = fd;
+}
+
+static uint64_t OpenEPT_ED_Platform_POSIX_NowNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static speed_t OpenEPT_ED_Platform_POSIX_Speed(uint32_t baudrate)
+{
+    switch(baudrate)
+    {
+    case 9600:      return B9600;
+    case 19200:     return B19200;
+    case 38400:     return B38400;
+    case 57600:     return B57600;
+    case 115200:    return B115200;
+    case 230400:    return B230400;
+#ifdef B460800
+    case 460800:    return B460800;
+#endif
+#ifdef B921600
+    case 921600:    return B921600;
+#endif
+#ifdef B1000000
+    case 1000000:   return B1000000;
+#endif
+#ifdef B2000000
+    case 2000000:   return B2000000;
+#endif
+#ifdef B4000000
+    case 4000000:   return B4000000;
+#endif
+    default:        return B0;
+    }
+}
+
+static int OpenEPT_ED_Platform_POSIX_SetTty(int fd, uint32_t baudrate)
+{
+    struct termios tio;
+    speed_t speed = OpenEPT_ED_Platform_POSIX_Speed(baudrate);
+
+    if(speed == B0) return OPEN_EPT_STATUS_ERROR;
+    if(tcgetattr(fd, &tio) != 0) return OPEN_EPT_STATUS_ERROR;
+    cfmakeraw(&tio);
+    cfsetispeed(&tio, speed);
+    cfsetospeed(&tio, speed);
+    if(tcsetattr(fd, TCSANOW, &tio) != 0) return OPEN_EPT_STATUS_ERROR;
+    return OPEN_EPT_STATUS_OK;
+}
+
+/*
+ * Wait until descriptor is ready for given events. Returns 1 if ready, 0 on timeout, -1 on error.
+ */
+static int OpenEPT_ED_Platform_POSIX_Wait(int fd, short events, int timeoutMs)
+{
+    struct pollfd pfd;
+    uint32_t start = OpenEPT_ED_Platform_GetTickMs();
+    int remaining = timeoutMs;
+    int status;
+
+    pfd.fd = fd;
+    pfd.events = events;
+    for(;;)
+    {
+        status = poll(&pfd, 1, remaining);
+        if(status >= 0) break;
+        if(errno != EINTR) return -1;
+        if(timeoutMs < 0) continue;
+        //Interrupted by a signal, wait only for the rest of timeout
+        remaining = timeoutMs - (int)(OpenEPT_ED_Platform_GetTickMs() - start);
+        if(remaining < 0) remaining = 0;
+    }
+    if(status == 0) return 0;
+    if(pfd.revents & (POLLERR | POLLNVAL)) return -1;
+    return 1;
+}
+
+static int OpenEPT_ED_Platform_POSIX_SyncRecord(uint8_t level)
+{
+    char record[32];
+    int size;
+
+    if(OPENEPT_SYNC_FD < 0) return OPEN_EPT_STATUS_OK;
+    size = snprintf(record, sizeof(record), "%llu %u\n", (unsigned long long)OpenEPT_ED_Platform_POSIX_NowNs(), level);
+    //Record is shorter than PIPE_BUF, so it is written atomically
+    if(write(OPENEPT_SYNC_FD, record, (size_t)size) != size) return OPEN_EPT_STATUS_ERROR;
+    return OPEN_EPT_STATUS_OK;
+}
+
+
+/**
+ * @brief Initializes POSIX platform.
+ *
+ * Uses descriptors set with OpenEPT_ED_Platform_POSIX_SetLinkFd/SetSyncFd. If none is set,
+ * opens the paths from OPENEPT_LINK and OPENEPT_SYNC environment variables. A tty link is
+ * switched to raw mode at OPENEPT_POSIX_BAUDRATE.
+ *
+ * @return OPEN_EPT_STATUS_OK on success, OPEN_EPT_STATUS_ERROR if link can not be opened.
+ */
+int OpenEPT_ED_Platform_Init()
+{
+    const char* path;
+
+    if(OPENEPT_LINK_TX_FD < 0)
+    {
+        path = getenv(OPENEPT_POSIX_LINK_ENV);
+        if(path == NULL) return OPEN_EPT_STATUS_ERROR;
+        OPENEPT_LINK_TX_FD = open(path, O_RDWR | O_NOCTTY | O_CLOEXEC);
+        if(OPENEPT_LINK_TX_FD < 0) return OPEN_EPT_STATUS_ERROR;
+        OPENEPT_LINK_RX_FD = OPENEPT_LINK_TX_FD;
+    }
+    if(OPENEPT_SYNC_FD < 0)
+    {
+        path = getenv(OPENEPT_POSIX_SYNC_ENV);
+        if(path != NULL) OPENEPT_SYNC_FD = open(path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    }
+    if(isatty(OPENEPT_LINK_TX_FD) && OpenEPT_ED_Platform_POSIX_SetTty(OPENEPT_LINK_TX_FD, OPENEPT_POSIX_BAUDRATE) != 0)
+    {
+        return OPEN_EPT_STATUS_ERROR;
+    }
+    __atomic_store_n(&OPENEPT_SYNC_PIN_VALUE, 0, __ATOMIC_RELAXED);
+    return OPEN_EPT_STATUS_OK;
+}
+
+/**
+ * @brief Writes buffer to the link.
+ *
+ * Blocks until all bytes are accepted by the descriptor; non-blocking descriptors are
+ * waited on with poll(2).
+ *
+ * @param buffer Data to send.
+ * @param size Number of bytes.
+ * @return OPEN_EPT_STATUS_OK on success, OPEN_EPT_STATUS_ERROR on failure.
+ */
+int OpenEPT_ED_Platform_SendBuffer(const uint8_t* buffer, uint32_t size)
+{
+    ssize_t written;
+
+    while(size > 0)
+    {
+        written = write(OPENEPT_LINK_TX_FD, buffer, size);
+        if(written < 0)
+        {
+            if(errno == EINTR) continue;
+            if(errno != EAGAIN && errno != EWOULDBLOCK) return OPEN_EPT_STATUS_ERROR;
+            if(OpenEPT_ED_Platform_POSIX_Wait(OPENEPT_LINK_TX_FD, POLLOUT, -1) < 0) return OPEN_EPT_STATUS_ERROR;
+            continue;
+        }
+        buffer += written;
+        size -= (uint32_t)written;
+    }
+    return OPEN_EPT_STATUS_OK;
+}
+
+/**
+ * @brief Writes frame segments to the link with a single writev call when possible.
+ *
+ * @param segments Frame segments.
+ * @param count Number of segments.
+ * @return OPEN_EPT_STATUS_OK on success, OPEN_EPT_STATUS_ERROR on failure.
+ */
+int OpenEPT_ED_Platform_SendSegments(const OpenEPT_ED_Platform_Segment* segments, uint32_t count)
+{
+    struct iovec iov[OPENEPT_POSIX_MAX_SEGMENTS];
+    ssize_t written;
+    ssize_t total = 0;
+    uint32_t cnt;
+
+    if(count > OPENEPT_POSIX_MAX_SEGMENTS)
+    {
+        for(cnt = 0; cnt < count; cnt++)
+        {
+            if(OpenEPT_ED_Platform_SendBuffer(segments[cnt].data, segments[cnt].size) != 0) return OPEN_EPT_STATUS_ERROR;
+        }
+        return OPEN_EPT_STATUS_OK;
+    }
+    for(cnt = 0; cnt < count; cnt++)
+    {
+        iov[cnt].iov_base = (void*)segments[cnt].data;
+        iov[cnt].iov_len = segments[cnt].size;
+        total += (ssize_t)segments[cnt].size;
+    }
+    do
+    {
+        written = writev(OPENEPT_LINK_TX_FD, iov, (int)count);
+    }while(written < 0 && errno == EINTR);
+    if(written == total) return OPEN_EPT_STATUS_OK;
+    if(written < 0 && errno != EAGAIN && errno != EWOULDBLOCK) return OPEN_EPT_STATUS_ERROR;
+    if(written < 0) written = 0;
+
+    //Partial write, send the rest segment by segment
+    for(cnt = 0; cnt < count; cnt++)
+    {
+        if((size_t)written >= segments[cnt].size)
+        {
+            written -= (ssize_t)segments[cnt].size;
+            continue;
+        }
+        if(OpenEPT_ED_Platform_SendBuffer(segments[cnt].data + written, segments[cnt].size - (uint32_t)written) != 0) return OPEN_EPT_STATUS_ERROR;
+        written = 0;
+    }
+    return OPEN_EPT_STATUS_OK;
+}
+
+int OpenEPT_ED_Platform_Send(char character)
+{
+    return OpenEPT_ED_Platform_SendBuffer((const uint8_t*)&character, 1);
+}
+
+/**
+ * @brief Waits until written data is transmitted. Only a tty buffers data on this side.
+ */
+int OpenEPT_ED_Platform_Flush()
+{
+    if(!isatty(OPENEPT_LINK_TX_FD)) return OPEN_EPT_STATUS_OK;
+    if(tcdrain(OPENEPT_LINK_TX_FD) != 0) return OPEN_EPT_STATUS_ERROR;
+    return OPEN_EPT_STATUS_OK;
+}
+
+static int OpenEPT_ED_Platform_POSIX_Read(char* character, int timeoutMs)
+{
+    ssize_t status;
+
+    if(OPENEPT_LINK_RX_FD < 0) return OPEN_EPT_STATUS_ERROR;
+    if(OpenEPT_ED_Platform_POSIX_Wait(OPENEPT_LINK_RX_FD, POLLIN, timeoutMs) != 1) return OPEN_EPT_STATUS_ERROR;
+    do
+    {
+        status = read(OPENEPT_LINK_RX_FD, character, 1);
+    }while(status < 0 && errno == EINTR);
+    //0 means peer closed the link
+    if(status != 1) return OPEN_EPT_STATUS_ERROR;
+    return OPEN_EPT_STATUS_OK;
+}
+
+/**
+ * @brief Reads one character, waiting for up to OPENEPT_ED_CONF_READ_TIMEOUT_MS.
+ */
+int OpenEPT_ED_Platform_Read(char* character)
+{
+    return OpenEPT_ED_Platform_POSIX_Read(character, OPENEPT_ED_CONF_READ_TIMEOUT_MS);
+}
+
+/**
+ * @brief Reads one character only if it is already received.
+ */
+int OpenEPT_ED_Platform_TryRead(char* character)
+{
+    return OpenEPT_ED_Platform_POSIX_Read(character, 0);
+}
+
+uint32_t OpenEPT_ED_Platform_GetTickMs()
+{
+    return (uint32_t)(OpenEPT_ED_Platform_POSIX_NowNs() / 1000000ull);
+}
+
+/**
+ * @brief Event timestamp, CLOCK_MONOTONIC in nanoseconds (same clock as SYNC side channel).
+ */
+uint64_t OpenEPT_ED_Platform_GetTimestamp()
+{
+    return OpenEPT_ED_Platform_POSIX_NowNs();
+}
+
+uint32_t OpenEPT_ED_Platform_GetTimestampFrequency()
+{
+    return 1000000000u;
+}
+
+/**
+ * @brief Changes tty baud rate. Other descriptors have no line rate, so any rate is accepted.
+ */
+int OpenEPT_ED_Platform_Reconfigure(uint32_t baudrate)
+{
+    if(!isatty(OPENEPT_LINK_TX_FD)) return OPEN_EPT_STATUS_OK;
+    if(baudrate == 0) baudrate = OPENEPT_POSIX_BAUDRATE;
+    return OpenEPT_ED_Platform_POSIX_SetTty(OPENEPT_LINK_TX_FD, baudrate);
+}
+
+int OpenEPT_ED_Platform_SyncUp()
+{
+    __atomic_store_n(&OPENEPT_SYNC_PIN_VALUE, 1, __ATOMIC_RELAXED);
+    return OpenEPT_ED_Platform_POSIX_SyncRecord(1);
+}
+
+int OpenEPT_ED_Platform_SyncDown()
+{
+    __atomic_store_n(&OPENEPT_SYNC_PIN_VALUE, 0, __ATOMIC_RELAXED);
+    return OpenEPT_ED_Platform_POSIX_SyncRecord(0);
+}
+
+/**
+ * @brief Toggle SYNC level. Energy points of several threads toggle it concurrently, like a
+ * GPIO toggle register every edge is recorded.
+ */
+int OpenEPT_ED_Platform_SyncToogle()
+{
+    return OpenEPT_ED_Platform_POSIX_SyncRecord(__atomic_xor_fetch(&OPENEPT_SYNC_PIN_VALUE, 1, __ATOMIC_RELAXED));
+}
+
+/**
+ * @brief Event buffer of the calling thread, kept in thread-local storage.
+ */
+void* OpenEPT_ED_Platform_GetThreadBuffer()
+{
+    return OPENEPT_THREAD_BUFFER;
+}
+
+void OpenEPT_ED_Platform_SetThreadBuffer(void* buffer)
+{
+    OPENEPT_THREAD_BUFFER = buffer;
+}
+
+/**
+ * @brief Let other threads run while a control function waits for the transport.
+ */
+void OpenEPT_ED_Platform_Yield()
+{
+    sched_yield();
+}
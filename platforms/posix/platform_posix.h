@@ -0,0 +1,19 @@
+#ifndef PLATFORM_POSIX_H_
+#define PLATFORM_POSIX_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Descriptors used by POSIX port, set before OpenEPT_ED_Init. Without them the port opens
+ * paths given in OPENEPT_LINK and OPENEPT_SYNC environment variables.
+ */
+void OpenEPT_ED_Platform_POSIX_SetLinkFd(int txFd, int rxFd);
+void OpenEPT_ED_Platform_POSIX_SetSyncFd(int fd);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -8,24 +8,201 @@
  * @date November 3, 2024
  * @author Dimitrije Lilic, Haris Turkmanovic
  */
-#include <strings.h>
-#include "../../feplib.h"
+#include <string.h>
+#include "../../../feplib/feplib.h"
+#include "../../../feplib/platform.h"
 #include "stm32h7xx.h"
+#include "stm32h7xx_ll_usart.h"
+#include "platform_stm32h755ziq.h"
+
+/*
+ * USART2 transport backend:
+ * OPENEPT_STM32_TRANSPORT_DMA      - transmit ring drained by DMA, circular DMA reception
+ * OPENEPT_STM32_TRANSPORT_LL_FIFO  - frames are written directly into USART TX FIFO, no DMA
+ */
+#define OPENEPT_STM32_TRANSPORT_DMA         0
+#define OPENEPT_STM32_TRANSPORT_LL_FIFO     1
+
+#ifndef OPENEPT_STM32_TRANSPORT
+#define OPENEPT_STM32_TRANSPORT             OPENEPT_STM32_TRANSPORT_DMA
+#endif
+
+/* Provide OpenEPT_ED_Platform_ProfileSetEPFast that measures OpenEPT_ED_SetEPFast with DWT cycle counter */
+#ifndef OPENEPT_STM32_PROFILE
+#define OPENEPT_STM32_PROFILE               0
+#endif
+
+/* Initial USART2 baud rate, restored after negotiated session ends */
+#ifndef OPENEPT_STM32_BAUDRATE
+#define OPENEPT_STM32_BAUDRATE              115200
+#endif
+
+/* Depth of USART hardware TX FIFO */
+#define OPENEPT_STM32_TX_FIFO_SIZE          16
+
+/* Define USART2 and DMA1 stream interrupt handlers here. Set to 0 if application already provides them */
+#ifndef OPENEPT_STM32_DEFINE_IRQ_HANDLERS
+#define OPENEPT_STM32_DEFINE_IRQ_HANDLERS   1
+#endif
+
+/*
+ * Define HAL_UART_TxCpltCallback, HAL_UART_ErrorCallback and HAL_UARTEx_RxEventCallback here.
+ * Set to 0 if application defines them for its own UARTs; they must then forward to the
+ * OpenEPT_ED_Platform_STM32_Uart* callbacks. With USE_HAL_UART_REGISTER_CALLBACKS the
+ * callbacks are registered on huart2 instead and this has no effect.
+ */
+#ifndef OPENEPT_STM32_DEFINE_UART_CALLBACKS
+#define OPENEPT_STM32_DEFINE_UART_CALLBACKS 1
+#endif
+
+/* Attributes of buffers accessed by DMA. DMA1 can not reach DTCM, so place them in AXI or D2 SRAM */
+#ifndef OPENEPT_STM32_DMA_BUFFER_ATTR
+#define OPENEPT_STM32_DMA_BUFFER_ATTR       __attribute__((aligned(32)))
+#endif
+
+/* Size of circular DMA receive buffer (multiple of 32 bytes, D-Cache line size) */
+#ifndef OPENEPT_STM32_RX_DMA_SIZE
+#define OPENEPT_STM32_RX_DMA_SIZE           64
+#endif
 
 UART_HandleTypeDef huart2;
 
+/* DWT CYCCNT extended to 64 bits, event timestamp source */
+static OpenEPT_ED_CounterExtender OPENEPT_CYCLES;
+
+/*
+ * Enable DWT cycle counter, it keeps running once enabled.
+ */
+static void OpenEPT_ED_Platform_CycleCounterEnable()
+{
+    if((DWT->CTRL & DWT_CTRL_CYCCNTENA_Msk) != 0) return;
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->LAR = 0xC5ACCE55; // Unlock DWT registers
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+#if OPENEPT_STM32_TRANSPORT == OPENEPT_STM32_TRANSPORT_DMA
+
+#define OPENEPT_STM32_TX_RING_MASK          (OPENEPT_ED_CONF_TX_RING_SIZE - 1)
+
+#if (OPENEPT_ED_CONF_TX_RING_SIZE & OPENEPT_STM32_TX_RING_MASK) != 0
+#error "OPENEPT_ED_CONF_TX_RING_SIZE must be a power of two"
+#endif
+
+DMA_HandleTypeDef  hdma_usart2_tx;
+DMA_HandleTypeDef  hdma_usart2_rx;
+
+/*
+ * Transmit ring. Head is advanced by the producer (OpenEPT API), tail by the DMA transfer
+ * complete callback. Indexes are free running and masked on access.
+ */
+static uint8_t              OPENEPT_TX_RING[OPENEPT_ED_CONF_TX_RING_SIZE] OPENEPT_STM32_DMA_BUFFER_ATTR;
+static volatile uint32_t    OPENEPT_TX_HEAD;
+static volatile uint32_t    OPENEPT_TX_TAIL;
+static volatile uint32_t    OPENEPT_TX_INFLIGHT;
+/* Discarded bytes right after the segment in flight, released together with it */
+static volatile uint32_t    OPENEPT_TX_SKIP;
+/* Ring position up to which frames are never discarded */
+static volatile uint32_t    OPENEPT_TX_PROTECT;
+/* DMA has sent the beginning of the frame at the tail */
+static volatile uint8_t     OPENEPT_TX_CUT;
+/* Number of frames discarded because of OPENEPT_ED_TX_OVERFLOW_DROP policy */
+static volatile uint32_t    OPENEPT_TX_DROPPED;
+
+/*
+ * Receive ring. Circular DMA writes it, the reception event callback (half transfer,
+ * transfer complete and idle line) publishes DMA write position.
+ */
+static uint8_t              OPENEPT_RX_RING[OPENEPT_STM32_RX_DMA_SIZE] OPENEPT_STM32_DMA_BUFFER_ATTR;
+static volatile uint32_t    OPENEPT_RX_WRITE;
+static uint32_t             OPENEPT_RX_READ;
+
+
+/*
+ * Release sent or discarded data at the tail. Called with interrupts masked or from a UART
+ * callback, so the byte before the new tail is not reused before it is checked.
+ */
+static void OpenEPT_ED_Platform_TxAdvance(uint32_t size)
+{
+    if(size == 0) return;
+    OPENEPT_TX_TAIL += size;
+    OPENEPT_TX_CUT = OPENEPT_TX_RING[(OPENEPT_TX_TAIL - 1) & OPENEPT_STM32_TX_RING_MASK] != 0x00;
+}
+
+/*
+ * Start DMA transfer of the next contiguous part of the ring if DMA is idle.
+ * Called with interrupts masked or from the transfer complete callback.
+ */
+static void OpenEPT_ED_Platform_TxStartNext()
+{
+    uint32_t pending;
+    uint32_t offset;
+    uint32_t size;
+
+    if(OPENEPT_TX_INFLIGHT != 0) return;
+    OpenEPT_ED_Platform_TxAdvance(OPENEPT_TX_SKIP);
+    OPENEPT_TX_SKIP = 0;
+    pending = OPENEPT_TX_HEAD - OPENEPT_TX_TAIL;
+    if(pending == 0) return;
+
+    offset = OPENEPT_TX_TAIL & OPENEPT_STM32_TX_RING_MASK;
+    size = OPENEPT_ED_CONF_TX_RING_SIZE - offset;
+    if(size > pending) size = pending;
+    if(size > 0xFFFF) size = 0xFFFF;
+
+#if (__DCACHE_PRESENT == 1U)
+    //Make ring content visible to DMA
+    SCB_CleanDCache_by_Addr((uint32_t*)((uint32_t)&OPENEPT_TX_RING[offset] & ~31U),
+                            (int32_t)(size + ((uint32_t)&OPENEPT_TX_RING[offset] & 31U)));
+#endif
+    OPENEPT_TX_INFLIGHT = size;
+    if(HAL_UART_Transmit_DMA(&huart2, &OPENEPT_TX_RING[offset], (uint16_t)size) != HAL_OK)
+    {
+        OPENEPT_TX_INFLIGHT = 0;
+    }
+}
+
+/*
+ * Kick DMA from thread context. Interrupts are masked so the check for idle DMA can not
+ * race with transfer complete callback.
+ */
+static void OpenEPT_ED_Platform_TxKick()
+{
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    OpenEPT_ED_Platform_TxStartNext();
+    __set_PRIMASK(primask);
+}
+
+/*
+ * (Re)start circular DMA reception with idle line detection.
+ */
+static int OpenEPT_ED_Platform_RxStart()
+{
+    OPENEPT_RX_WRITE = 0;
+    OPENEPT_RX_READ = 0;
+    if(HAL_UARTEx_ReceiveToIdle_DMA(&huart2, OPENEPT_RX_RING, OPENEPT_STM32_RX_DMA_SIZE) != HAL_OK) return OPEN_EPT_STATUS_ERROR;
+    return OPEN_EPT_STATUS_OK;
+}
+
+#endif /* OPENEPT_STM32_TRANSPORT == OPENEPT_STM32_TRANSPORT_DMA */
+
 /**
  * @brief Initializes the platform-specific peripherals for OpenEPT ED.
  *
  * This function initializes the GPIO and UART peripherals on the NUCLEO-H755ZI-Q.
  * It configures GPIOA and GPIOD pins for UART communication and sets up GPIOA for
- * general-purpose output (used for synchronization).
+ * general-purpose output (used for synchronization). With DMA transport USART2 transmit
+ * and receive are served by DMA1 Stream1 and Stream0 and reception runs continuously in
+ * circular mode. With LL FIFO transport USART2 FIFO mode is enabled instead.
  *
  * @return OPEN_EPT_STATUS_OK if initialization is successful,
  *         OPEN_EPT_STATUS_ERROR if an error occurs during UART initialization.
  */
 int OpenEPT_ED_Platform_Init()
 {
+    OpenEPT_ED_Platform_CycleCounterEnable();
      __HAL_RCC_GPIOA_CLK_ENABLE(); // Enable clock for GPIOA (change as needed)
     GPIO_InitTypeDef GPIO_InitStruct = {0};
 
@@ -59,7 +236,7 @@ int OpenEPT_ED_Platform_Init()
 
     // UART2 configuration
     huart2.Instance = USART2; // Select USART2
-    huart2.Init.BaudRate = 115200; // Baud rate
+    huart2.Init.BaudRate = OPENEPT_STM32_BAUDRATE; // Baud rate
     huart2.Init.WordLength = UART_WORDLENGTH_8B; // 8 data bits
     huart2.Init.StopBits = UART_STOPBITS_1; // 1 stop bit
     huart2.Init.Parity = UART_PARITY_NONE; // No parity
@@ -71,13 +248,82 @@ int OpenEPT_ED_Platform_Init()
         // Initialization error
         return OPEN_EPT_STATUS_ERROR;
     }
+
+#if OPENEPT_STM32_TRANSPORT == OPENEPT_STM32_TRANSPORT_LL_FIFO
+    // UART2 FIFO configuration
+    LL_USART_Disable(USART2); // FIFO mode can be changed only while USART is disabled
+    LL_USART_SetTXFIFOThreshold(USART2, LL_USART_FIFOTHRESHOLD_1_8);
+    LL_USART_EnableFIFO(USART2);
+    LL_USART_Enable(USART2);
+    while(!LL_USART_IsActiveFlag_TEACK(USART2) || !LL_USART_IsActiveFlag_REACK(USART2));
     return OPEN_EPT_STATUS_OK;
+#else
+    // UART2 TX DMA configuration
+    __HAL_RCC_DMA1_CLK_ENABLE(); // Enable clock for DMA1
+    hdma_usart2_tx.Instance = DMA1_Stream1; // Select DMA1 Stream1
+    hdma_usart2_tx.Init.Request = DMA_REQUEST_USART2_TX; // USART2 TX request
+    hdma_usart2_tx.Init.Direction = DMA_MEMORY_TO_PERIPH; // Memory to UART
+    hdma_usart2_tx.Init.PeriphInc = DMA_PINC_DISABLE; // Fixed TDR address
+    hdma_usart2_tx.Init.MemInc = DMA_MINC_ENABLE; // Walk through ring
+    hdma_usart2_tx.Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE; // Byte access
+    hdma_usart2_tx.Init.MemDataAlignment = DMA_MDATAALIGN_BYTE; // Byte access
+    hdma_usart2_tx.Init.Mode = DMA_NORMAL; // One segment per transfer
+    hdma_usart2_tx.Init.Priority = DMA_PRIORITY_LOW; // Low priority
+    hdma_usart2_tx.Init.FIFOMode = DMA_FIFOMODE_DISABLE; // Direct mode
+    if (HAL_DMA_Init(&hdma_usart2_tx) != HAL_OK) {
+        // Initialization error
+        return OPEN_EPT_STATUS_ERROR;
+    }
+    __HAL_LINKDMA(&huart2, hdmatx, hdma_usart2_tx);
+
+    // UART2 RX DMA configuration
+    hdma_usart2_rx.Instance = DMA1_Stream0; // Select DMA1 Stream0
+    hdma_usart2_rx.Init.Request = DMA_REQUEST_USART2_RX; // USART2 RX request
+    hdma_usart2_rx.Init.Direction = DMA_PERIPH_TO_MEMORY; // UART to memory
+    hdma_usart2_rx.Init.PeriphInc = DMA_PINC_DISABLE; // Fixed RDR address
+    hdma_usart2_rx.Init.MemInc = DMA_MINC_ENABLE; // Walk through ring
+    hdma_usart2_rx.Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE; // Byte access
+    hdma_usart2_rx.Init.MemDataAlignment = DMA_MDATAALIGN_BYTE; // Byte access
+    hdma_usart2_rx.Init.Mode = DMA_CIRCULAR; // Never stop receiving
+    hdma_usart2_rx.Init.Priority = DMA_PRIORITY_LOW; // Low priority
+    hdma_usart2_rx.Init.FIFOMode = DMA_FIFOMODE_DISABLE; // Direct mode
+    if (HAL_DMA_Init(&hdma_usart2_rx) != HAL_OK) {
+        // Initialization error
+        return OPEN_EPT_STATUS_ERROR;
+    }
+    __HAL_LINKDMA(&huart2, hdmarx, hdma_usart2_rx);
+
+#if (USE_HAL_UART_REGISTER_CALLBACKS == 1)
+    // UART2 callbacks, other UARTs keep theirs
+    if (HAL_UART_RegisterCallback(&huart2, HAL_UART_TX_COMPLETE_CB_ID, OpenEPT_ED_Platform_STM32_UartTxCplt) != HAL_OK ||
+        HAL_UART_RegisterCallback(&huart2, HAL_UART_ERROR_CB_ID, OpenEPT_ED_Platform_STM32_UartError) != HAL_OK ||
+        HAL_UART_RegisterRxEventCallback(&huart2, OpenEPT_ED_Platform_STM32_UartRxEvent) != HAL_OK) {
+        return OPEN_EPT_STATUS_ERROR;
+    }
+#endif
+
+    HAL_NVIC_SetPriority(DMA1_Stream1_IRQn, 15, 0); // Lowest priority, transmit is background work
+    HAL_NVIC_EnableIRQ(DMA1_Stream1_IRQn);
+    HAL_NVIC_SetPriority(DMA1_Stream0_IRQn, 15, 0);
+    HAL_NVIC_EnableIRQ(DMA1_Stream0_IRQn);
+    HAL_NVIC_SetPriority(USART2_IRQn, 15, 0);
+    HAL_NVIC_EnableIRQ(USART2_IRQn);
+
+    OPENEPT_TX_HEAD = 0;
+    OPENEPT_TX_TAIL = 0;
+    OPENEPT_TX_INFLIGHT = 0;
+    OPENEPT_TX_SKIP = 0;
+    OPENEPT_TX_PROTECT = 0;
+    OPENEPT_TX_CUT = 0;
+    OPENEPT_TX_DROPPED = 0;
+    return OpenEPT_ED_Platform_RxStart();
+#endif
 }
 
 /**
  * @brief Sends a single character over UART.
  *
- * This function sends one character through UART2 using the HAL library.
+ * This function queues one character into the transmit ring.
  *
  * @param character The character to be transmitted.
  * @return OPEN_EPT_STATUS_OK on successful transmission,
@@ -85,10 +331,501 @@ int OpenEPT_ED_Platform_Init()
  */
 int OpenEPT_ED_Platform_Send(char character)
 {
-    if(HAL_UART_Transmit(&huart2, (uint8_t*)&character, 1, HAL_MAX_DELAY) != HAL_OK) return OPEN_EPT_STATUS_ERROR;
+    return OpenEPT_ED_Platform_SendBuffer((const uint8_t*)&character, 1);
+}
+
+/**
+ * @brief Sends a buffer over UART.
+ *
+ * This function queues the whole buffer into the transmit ring.
+ *
+ * @param buffer Pointer to the data to be transmitted.
+ * @param size Number of bytes to transmit.
+ * @return OPEN_EPT_STATUS_OK on successful transmission,
+ *         OPEN_EPT_STATUS_ERROR on transmission error.
+ */
+int OpenEPT_ED_Platform_SendBuffer(const uint8_t* buffer, uint32_t size)
+{
+    OpenEPT_ED_Platform_Segment segment;
+    segment.data = buffer;
+    segment.size = size;
+    return OpenEPT_ED_Platform_SendSegments(&segment, 1);
+}
+
+#if OPENEPT_STM32_TRANSPORT == OPENEPT_STM32_TRANSPORT_LL_FIFO
+
+/**
+ * @brief Sends a frame made of several segments over UART.
+ *
+ * The frame is written directly into USART2 TDR, bypassing HAL locking and state
+ * handling. A frame that fits into an empty TX FIFO is written without checking any
+ * flag; otherwise every character waits only for free room in the FIFO. The function
+ * returns as soon as the last character is in the FIFO.
+ *
+ * @param segments Array of frame segments to transmit in order.
+ * @param count Number of segments.
+ * @return OPEN_EPT_STATUS_OK.
+ */
+int OpenEPT_ED_Platform_SendSegments(const OpenEPT_ED_Platform_Segment* segments, uint32_t count)
+{
+    uint32_t total = 0;
+    uint32_t cnt;
+    uint32_t pos;
+
+    for(cnt = 0; cnt < count; cnt++) total += segments[cnt].size;
+
+    if(total <= OPENEPT_STM32_TX_FIFO_SIZE && LL_USART_IsActiveFlag_TXFE(USART2))
+    {
+        //Whole frame fits into empty FIFO
+        for(cnt = 0; cnt < count; cnt++)
+        {
+            for(pos = 0; pos < segments[cnt].size; pos++) LL_USART_TransmitData8(USART2, segments[cnt].data[pos]);
+        }
+        return OPEN_EPT_STATUS_OK;
+    }
+
+    for(cnt = 0; cnt < count; cnt++)
+    {
+        for(pos = 0; pos < segments[cnt].size; pos++)
+        {
+            while(!LL_USART_IsActiveFlag_TXE_TXFNF(USART2));
+            LL_USART_TransmitData8(USART2, segments[cnt].data[pos]);
+        }
+    }
+    return OPEN_EPT_STATUS_OK;
+}
+
+/**
+ * @brief Waits until all queued data is transmitted.
+ *
+ * This function blocks until the TX FIFO is empty and the last character has left the
+ * USART2 shift register, or until OPENEPT_ED_CONF_TX_FLUSH_TIMEOUT_MS expires.
+ *
+ * @return OPEN_EPT_STATUS_OK if everything is transmitted,
+ *         OPEN_EPT_STATUS_ERROR on timeout.
+ */
+int OpenEPT_ED_Platform_Flush()
+{
+    uint32_t start = HAL_GetTick();
+    while(!LL_USART_IsActiveFlag_TC(USART2))
+    {
+        if(HAL_GetTick() - start > OPENEPT_ED_CONF_TX_FLUSH_TIMEOUT_MS) return OPEN_EPT_STATUS_ERROR;
+    }
+    return OPEN_EPT_STATUS_OK;
+}
+
+/**
+ * @brief Read a single character over UART.
+ *
+ * This function takes one character from USART2 RX FIFO, waiting for up to
+ * OPENEPT_ED_CONF_READ_TIMEOUT_MS. The 16 character hardware FIFO holds a complete
+ * handshake response, so no interrupt is needed.
+ *
+ * @param character Read character.
+ * @return OPEN_EPT_STATUS_OK if character is read,
+ *         OPEN_EPT_STATUS_ERROR on timeout.
+ */
+int OpenEPT_ED_Platform_Read(char* character)
+{
+    uint32_t start = HAL_GetTick();
+    if(LL_USART_IsActiveFlag_ORE(USART2)) LL_USART_ClearFlag_ORE(USART2);
+    while(!LL_USART_IsActiveFlag_RXNE_RXFNE(USART2))
+    {
+        if(HAL_GetTick() - start > OPENEPT_ED_CONF_READ_TIMEOUT_MS) return OPEN_EPT_STATUS_ERROR;
+    }
+    *character = (char)LL_USART_ReceiveData8(USART2);
+    return OPEN_EPT_STATUS_OK;
+}
+
+/**
+ * @brief Read a single character over UART if one is available.
+ *
+ * @param character Read character.
+ * @return OPEN_EPT_STATUS_OK if character is read,
+ *         OPEN_EPT_STATUS_ERROR if RX FIFO is empty.
+ */
+int OpenEPT_ED_Platform_TryRead(char* character)
+{
+    if(LL_USART_IsActiveFlag_ORE(USART2)) LL_USART_ClearFlag_ORE(USART2);
+    if(!LL_USART_IsActiveFlag_RXNE_RXFNE(USART2)) return OPEN_EPT_STATUS_ERROR;
+    *character = (char)LL_USART_ReceiveData8(USART2);
+    return OPEN_EPT_STATUS_OK;
+}
+
+#else
+
+/**
+ * @brief Sends a frame made of several segments over UART.
+ *
+ * The frame is copied into the transmit ring as a whole and the function returns
+ * immediately; USART2 TX DMA drains the ring in the background, chaining the next
+ * contiguous part of the ring from the transfer complete callback. When the frame
+ * does not fit, OPENEPT_ED_CONF_TX_OVERFLOW_POLICY decides whether to wait for
+ * free space or to discard the frame.
+ *
+ * @param segments Array of frame segments to transmit in order.
+ * @param count Number of segments.
+ * @return OPEN_EPT_STATUS_OK if frame is queued,
+ *         OPEN_EPT_STATUS_ERROR if frame is discarded.
+ */
+int OpenEPT_ED_Platform_SendSegments(const OpenEPT_ED_Platform_Segment* segments, uint32_t count)
+{
+    uint32_t total = 0;
+    uint32_t head;
+    uint32_t offset;
+    uint32_t chunk;
+    uint32_t cnt;
+
+    for(cnt = 0; cnt < count; cnt++) total += segments[cnt].size;
+    if(total > OPENEPT_ED_CONF_TX_RING_SIZE) return OPEN_EPT_STATUS_ERROR;
+
+    //Check is there enough space in the ring
+    while(OPENEPT_ED_CONF_TX_RING_SIZE - (OPENEPT_TX_HEAD - OPENEPT_TX_TAIL) < total)
+    {
+        //Discarded data is released when the segment in flight completes
+        if(OpenEPT_ED_Platform_TxSpace() >= total) continue;
+#if OPENEPT_ED_CONF_TX_OVERFLOW_POLICY == OPENEPT_ED_TX_OVERFLOW_DROP
+        OPENEPT_TX_DROPPED += 1;
+        return OPEN_EPT_STATUS_ERROR;
+#else
+        OpenEPT_ED_Platform_TxKick();
+#endif
+    }
+
+    //Copy frame into the ring
+    head = OPENEPT_TX_HEAD;
+    for(cnt = 0; cnt < count; cnt++)
+    {
+        const uint8_t* data = segments[cnt].data;
+        uint32_t size = segments[cnt].size;
+        while(size > 0)
+        {
+            offset = head & OPENEPT_STM32_TX_RING_MASK;
+            chunk = OPENEPT_ED_CONF_TX_RING_SIZE - offset;
+            if(chunk > size) chunk = size;
+            memcpy(&OPENEPT_TX_RING[offset], data, chunk);
+            data += chunk;
+            size -= chunk;
+            head += chunk;
+        }
+    }
+    __DMB();
+    OPENEPT_TX_HEAD = head;
+
+    OpenEPT_ED_Platform_TxKick();
+    return OPEN_EPT_STATUS_OK;
+}
+
+/**
+ * @brief Waits until all queued data is transmitted.
+ *
+ * This function blocks until the transmit ring is empty and the last character has
+ * left the USART2 shift register, or until OPENEPT_ED_CONF_TX_FLUSH_TIMEOUT_MS expires.
+ *
+ * @return OPEN_EPT_STATUS_OK if everything is transmitted,
+ *         OPEN_EPT_STATUS_ERROR on timeout.
+ */
+int OpenEPT_ED_Platform_Flush()
+{
+    uint32_t start = HAL_GetTick();
+    while((OPENEPT_TX_HEAD != OPENEPT_TX_TAIL) || (__HAL_UART_GET_FLAG(&huart2, UART_FLAG_TC) == RESET))
+    {
+        OpenEPT_ED_Platform_TxKick();
+        if(HAL_GetTick() - start > OPENEPT_ED_CONF_TX_FLUSH_TIMEOUT_MS) return OPEN_EPT_STATUS_ERROR;
+    }
+    return OPEN_EPT_STATUS_OK;
+}
+
+/**
+ * @brief Returns free space in the transmit ring.
+ *
+ * Discarded data that waits for the segment in flight to complete counts as free.
+ *
+ * @return Number of free bytes.
+ */
+uint32_t OpenEPT_ED_Platform_TxSpace()
+{
+    uint32_t primask = __get_PRIMASK();
+    uint32_t used;
+
+    __disable_irq();
+    OpenEPT_ED_Platform_TxStartNext();
+    used = OPENEPT_TX_HEAD - OPENEPT_TX_TAIL - OPENEPT_TX_SKIP;
+    __set_PRIMASK(primask);
+    return OPENEPT_ED_CONF_TX_RING_SIZE - used;
+}
+
+/**
+ * @brief Discards the oldest frame in the transmit ring that DMA has not taken yet.
+ *
+ * Data after the segment in flight is dropped up to the next 0x00 delimiter, which is
+ * dropped too when a frame starts there. When DMA has already sent the beginning of a
+ * frame, the delimiter is kept to end that partial frame, which the receiver rejects, so
+ * the partial frame is the one lost; a further discard drops the next frame and keeps its
+ * delimiter instead. Nothing is dropped while protected frames wait for DMA.
+ *
+ * @return OPEN_EPT_STATUS_OK if a frame is discarded,
+ *         OPEN_EPT_STATUS_ERROR if no complete unprotected frame waits for DMA.
+ */
+int OpenEPT_ED_Platform_TxDiscard()
+{
+    uint32_t primask = __get_PRIMASK();
+    uint32_t start;
+    uint32_t pos;
+    uint8_t cut;
+    int result = OPEN_EPT_STATUS_ERROR;
+
+    __disable_irq();
+    start = OPENEPT_TX_TAIL + OPENEPT_TX_INFLIGHT + OPENEPT_TX_SKIP;
+    cut = start != OPENEPT_TX_TAIL ? OPENEPT_TX_RING[(start - 1) & OPENEPT_STM32_TX_RING_MASK] != 0x00 : OPENEPT_TX_CUT;
+    pos = start;
+    //Protected position not reached by DMA yet
+    if((int32_t)(OPENEPT_TX_PROTECT - start) > 0) pos = OPENEPT_TX_HEAD;
+    //Delimiter already kept for the partial frame, drop the frame after it
+    else if(cut && pos != OPENEPT_TX_HEAD && OPENEPT_TX_RING[pos & OPENEPT_STM32_TX_RING_MASK] == 0x00) pos++;
+    for(; pos != OPENEPT_TX_HEAD; pos++)
+    {
+        if(OPENEPT_TX_RING[pos & OPENEPT_STM32_TX_RING_MASK] != 0x00) continue;
+        OPENEPT_TX_SKIP += (cut ? pos : pos + 1) - start;
+        OpenEPT_ED_Platform_TxStartNext();
+        result = OPEN_EPT_STATUS_OK;
+        break;
+    }
+    __set_PRIMASK(primask);
+    return result;
+}
+
+/**
+ * @brief Protects frames queued so far from OpenEPT_ED_Platform_TxDiscard.
+ */
+void OpenEPT_ED_Platform_TxProtect()
+{
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    OPENEPT_TX_PROTECT = OPENEPT_TX_HEAD;
+    __set_PRIMASK(primask);
+}
+
+/**
+ * @brief Read a single character over UART.
+ *
+ * This function takes one character from the receive ring filled by circular DMA.
+ * If the ring is empty it waits for up to OPENEPT_ED_CONF_READ_TIMEOUT_MS for the
+ * reception event callback to publish new data.
+ *
+ * @param character Read character.
+ * @return OPEN_EPT_STATUS_OK if character is read,
+ *         OPEN_EPT_STATUS_ERROR on timeout.
+ */
+int OpenEPT_ED_Platform_Read(char* character)
+{
+    uint32_t start = HAL_GetTick();
+    while(OpenEPT_ED_Platform_TryRead(character) != OPEN_EPT_STATUS_OK)
+    {
+        if(HAL_GetTick() - start > OPENEPT_ED_CONF_READ_TIMEOUT_MS) return OPEN_EPT_STATUS_ERROR;
+    }
+    return OPEN_EPT_STATUS_OK;
+}
+
+/**
+ * @brief Read a single character over UART if one is available.
+ *
+ * @param character Read character.
+ * @return OPEN_EPT_STATUS_OK if character is read,
+ *         OPEN_EPT_STATUS_ERROR if receive ring is empty.
+ */
+int OpenEPT_ED_Platform_TryRead(char* character)
+{
+    if(OPENEPT_RX_READ == OPENEPT_RX_WRITE) return OPEN_EPT_STATUS_ERROR;
+#if (__DCACHE_PRESENT == 1U)
+    //Drop stale cache lines, ring is written by DMA only
+    SCB_InvalidateDCache_by_Addr((uint32_t*)OPENEPT_RX_RING, OPENEPT_STM32_RX_DMA_SIZE);
+#endif
+    *character = (char)OPENEPT_RX_RING[OPENEPT_RX_READ];
+    OPENEPT_RX_READ = OPENEPT_RX_READ + 1 == OPENEPT_STM32_RX_DMA_SIZE ? 0 : OPENEPT_RX_READ + 1;
+    return OPEN_EPT_STATUS_OK;
+}
+
+/**
+ * @brief USART reception event callback.
+ *
+ * Called for USART2 from HAL_UARTEx_RxEventCallback, events of other UARTs are ignored.
+ * Called on half transfer, transfer complete and idle line events of the circular
+ * receive DMA. Publishes position up to which DMA has written the receive ring.
+ *
+ * @param huart UART handle.
+ * @param Size Position of the last received character within the receive ring.
+ */
+void OpenEPT_ED_Platform_STM32_UartRxEvent(UART_HandleTypeDef *huart, uint16_t Size)
+{
+    if(huart->Instance != USART2) return;
+    OPENEPT_RX_WRITE = Size == OPENEPT_STM32_RX_DMA_SIZE ? 0 : Size;
+}
+
+/**
+ * @brief USART transfer complete callback.
+ *
+ * Called for USART2 from HAL_UART_TxCpltCallback, events of other UARTs are ignored.
+ * Releases the segment that was just sent and chains DMA transfer of the next one.
+ *
+ * @param huart UART handle.
+ */
+void OpenEPT_ED_Platform_STM32_UartTxCplt(UART_HandleTypeDef *huart)
+{
+    if(huart->Instance != USART2) return;
+    OpenEPT_ED_Platform_TxAdvance(OPENEPT_TX_INFLIGHT);
+    OPENEPT_TX_INFLIGHT = 0;
+    OpenEPT_ED_Platform_TxStartNext();
+}
+
+/**
+ * @brief USART error callback.
+ *
+ * Called for USART2 from HAL_UART_ErrorCallback, events of other UARTs are ignored.
+ * Drops the segment in flight so the ring does not stall after a transmit error and
+ * restarts reception if it was aborted.
+ *
+ * @param huart UART handle.
+ */
+void OpenEPT_ED_Platform_STM32_UartError(UART_HandleTypeDef *huart)
+{
+    if(huart->Instance != USART2) return;
+    if(OPENEPT_TX_INFLIGHT != 0 && huart->gState == HAL_UART_STATE_READY)
+    {
+        OpenEPT_ED_Platform_TxAdvance(OPENEPT_TX_INFLIGHT);
+        OPENEPT_TX_INFLIGHT = 0;
+        OpenEPT_ED_Platform_TxStartNext();
+    }
+    //Reception is aborted on overrun/framing errors, start it again
+    if(huart->RxState == HAL_UART_STATE_READY) OpenEPT_ED_Platform_RxStart();
+}
+
+#if (USE_HAL_UART_REGISTER_CALLBACKS != 1) && (OPENEPT_STM32_DEFINE_UART_CALLBACKS == 1)
+void HAL_UARTEx_RxEventCallback(UART_HandleTypeDef *huart, uint16_t Size)
+{
+    OpenEPT_ED_Platform_STM32_UartRxEvent(huart, Size);
+}
+
+void HAL_UART_TxCpltCallback(UART_HandleTypeDef *huart)
+{
+    OpenEPT_ED_Platform_STM32_UartTxCplt(huart);
+}
+
+void HAL_UART_ErrorCallback(UART_HandleTypeDef *huart)
+{
+    OpenEPT_ED_Platform_STM32_UartError(huart);
+}
+#endif
+
+#if OPENEPT_STM32_DEFINE_IRQ_HANDLERS == 1
+void DMA1_Stream0_IRQHandler(void)
+{
+    HAL_DMA_IRQHandler(&hdma_usart2_rx);
+}
+
+void DMA1_Stream1_IRQHandler(void)
+{
+    HAL_DMA_IRQHandler(&hdma_usart2_tx);
+}
+
+void USART2_IRQHandler(void)
+{
+    HAL_UART_IRQHandler(&huart2);
+}
+#endif
+
+#endif /* OPENEPT_STM32_TRANSPORT */
+
+/**
+ * @brief Changes USART2 baud rate.
+ *
+ * Waits for the last character to leave the shift register and reprograms BRR while
+ * USART2 is disabled. DMA and FIFO configuration stay in place, so circular reception
+ * continues at the new rate.
+ *
+ * @param baudrate New baud rate, 0 restores OPENEPT_STM32_BAUDRATE.
+ * @return OPEN_EPT_STATUS_OK if baud rate is changed,
+ *         OPEN_EPT_STATUS_ERROR if transmission does not complete.
+ */
+int OpenEPT_ED_Platform_Reconfigure(uint32_t baudrate)
+{
+    uint32_t start = HAL_GetTick();
+    if(baudrate == 0) baudrate = OPENEPT_STM32_BAUDRATE;
+    while(!LL_USART_IsActiveFlag_TC(USART2))
+    {
+        if(HAL_GetTick() - start > OPENEPT_ED_CONF_TX_FLUSH_TIMEOUT_MS) return OPEN_EPT_STATUS_ERROR;
+    }
+    LL_USART_Disable(USART2);
+    LL_USART_SetBaudRate(USART2, HAL_RCCEx_GetPeriphCLKFreq(RCC_PERIPHCLK_USART2), LL_USART_PRESCALER_DIV1,
+                         LL_USART_OVERSAMPLING_16, baudrate);
+    LL_USART_Enable(USART2);
+    huart2.Init.BaudRate = baudrate;
     return OPEN_EPT_STATUS_OK;
 }
 
+/**
+ * @brief Millisecond tick.
+ *
+ * @return HAL tick counter.
+ */
+uint32_t OpenEPT_ED_Platform_GetTickMs()
+{
+    return HAL_GetTick();
+}
+
+/**
+ * @brief Event timestamp.
+ *
+ * DWT cycle counter extended to 64 bits; HAL tick resolves wraps, so the counter may stay
+ * unread for any time. Interrupts are masked while the extension state is updated, so
+ * energy points may also be set from interrupt handlers.
+ *
+ * @return CPU cycles.
+ */
+uint64_t OpenEPT_ED_Platform_GetTimestamp()
+{
+    uint32_t primask = __get_PRIMASK();
+    uint64_t timestamp;
+    __disable_irq();
+    timestamp = OpenEPT_ED_ExtendCounter(&OPENEPT_CYCLES, DWT->CYCCNT, HAL_GetTick(), SystemCoreClock);
+    __set_PRIMASK(primask);
+    return timestamp;
+}
+
+/**
+ * @brief Event timestamp frequency.
+ *
+ * @return CPU clock in Hz.
+ */
+uint32_t OpenEPT_ED_Platform_GetTimestampFrequency()
+{
+    return SystemCoreClock;
+}
+
+#if OPENEPT_STM32_PROFILE == 1
+/**
+ * @brief Measures duration of OpenEPT_ED_SetEPFast call.
+ *
+ * Enables DWT cycle counter on first use and returns number of CPU cycles spent
+ * in OpenEPT_ED_SetEPFast for the given energy point name.
+ *
+ * @param epName Pointer to the name of the energy point.
+ * @param epNameSize Size of the energy point name in bytes.
+ * @return Number of CPU cycles.
+ */
+uint32_t OpenEPT_ED_Platform_ProfileSetEPFast(uint8_t* epName, uint32_t epNameSize)
+{
+    uint32_t start;
+    uint32_t end;
+
+    OpenEPT_ED_Platform_CycleCounterEnable();
+    start = DWT->CYCCNT;
+    OpenEPT_ED_SetEPFast(epName, epNameSize);
+    end = DWT->CYCCNT;
+    return end - start;
+}
+#endif
+
 /**
  * @brief Synchronizes up by setting GPIOA pin 5 to HIGH.
  *
@@ -122,18 +859,17 @@ int OpenEPT_ED_Platform_SyncDown()
 }
 
 /**
- * @brief Synchronizes down by setting GPIOA pin 5 to LOW.
+ * @brief Toggles GPIOA pin 5.
  *
- * This function sets GPIOA pin 5 to LOW and verifies the pin state
- * to confirm the operation.
+ * This function inverts GPIOA pin 5 with a single BSRR write, it is called on every
+ * energy point so it avoids HAL calls.
  *
- * @return OPEN_EPT_STATUS_OK if the pin is reset successfully,
- *         OPEN_EPT_STATUS_ERROR if the pin state is incorrect.
+ * @return OPEN_EPT_STATUS_OK.
  */
 int OpenEPT_ED_Platform_SyncToogle()
 {
-    HAL_GPIO_WritePin(GPIOA, GPIO_PIN_5, GPIO_PIN_RESET);
-    GPIO_PinState state = HAL_GPIO_ReadPin(GPIOA, GPIO_PIN_5);
-    return (state == GPIO_PIN_RESET) ? OPEN_EPT_STATUS_OK : OPEN_EPT_STATUS_ERROR;
+    uint32_t odr = GPIOA->ODR;
+    GPIOA->BSRR = ((odr & GPIO_PIN_5) << 16) | (~odr & GPIO_PIN_5);
+    return OPEN_EPT_STATUS_OK;
 }
 
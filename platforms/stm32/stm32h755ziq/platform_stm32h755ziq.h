@@ -0,0 +1,24 @@
+#ifndef PLATFORM_STM32H755ZIQ_H_
+#define PLATFORM_STM32H755ZIQ_H_
+
+#include "stm32h7xx.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * USART2 callbacks of the DMA transport. Applications that define the HAL UART callbacks
+ * themselves (OPENEPT_STM32_DEFINE_UART_CALLBACKS set to 0) call them from
+ * HAL_UARTEx_RxEventCallback, HAL_UART_TxCpltCallback and HAL_UART_ErrorCallback with
+ * the same arguments; events of other UARTs are ignored.
+ */
+void OpenEPT_ED_Platform_STM32_UartRxEvent(UART_HandleTypeDef *huart, uint16_t Size);
+void OpenEPT_ED_Platform_STM32_UartTxCplt(UART_HandleTypeDef *huart);
+void OpenEPT_ED_Platform_STM32_UartError(UART_HandleTypeDef *huart);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
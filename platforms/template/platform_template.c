@@ -24,12 +24,83 @@
      return OPEN_EPT_STATUS_OK;
  }
 
- int OpenEPT_ED_Platform_Read(char character)
+ /*OPENEPT: Optional. Remove this function if the platform can only send one character at a time */
+ int OpenEPT_ED_Platform_SendBuffer(const uint8_t* buffer, uint32_t size)
+ {
+    /* OPENEPT: Code that sends whole buffer through SERIAL interface should be implemented here */
+     return OPEN_EPT_STATUS_OK;
+ }
+
+ int OpenEPT_ED_Platform_Read(char* character)
  {
     /* OPENEPT: Code that read one character from SERIAL interface should be implemented here */
      return OPEN_EPT_STATUS_OK;
  }
  
+ /*OPENEPT: Optional. Remove this function if the platform can only read with blocking call */
+ int OpenEPT_ED_Platform_TryRead(char* character)
+ {
+    /* OPENEPT: Code that read one already received character from SERIAL interface should be implemented here */
+     return OPEN_EPT_STATUS_ERROR;
+ }
+
+ uint32_t OpenEPT_ED_Platform_GetTickMs()
+ {
+    /* OPENEPT: Code that returns millisecond tick should be implemented here */
+     return 0;
+ }
+
+ /*OPENEPT: Optional. Remove both functions if the platform has no timestamp source */
+ uint64_t OpenEPT_ED_Platform_GetTimestamp()
+ {
+    /* OPENEPT: Code that returns free running 64 bit counter should be implemented here (see OpenEPT_ED_ExtendCounter) */
+     return 0;
+ }
+
+ uint32_t OpenEPT_ED_Platform_GetTimestampFrequency()
+ {
+    /* OPENEPT: Frequency of the counter returned by OpenEPT_ED_Platform_GetTimestamp in Hz */
+     return 0;
+ }
+
+ /*OPENEPT: Optional. Remove these three functions if the platform sends without a transmit queue */
+ uint32_t OpenEPT_ED_Platform_TxSpace()
+ {
+    /* OPENEPT: Code that returns free bytes in the transmit queue should be implemented here */
+     return 0;
+ }
+
+ int OpenEPT_ED_Platform_TxDiscard()
+ {
+    /* OPENEPT: Code that drops the oldest queued frame (up to its 0x00 delimiter) not being sent yet should be implemented here */
+    /* OPENEPT: Keep the delimiter of a frame whose beginning is already sent, it ends the partial frame */
+    /* OPENEPT: Frames queued before the last OpenEPT_ED_Platform_TxProtect call must not be dropped */
+     return OPEN_EPT_STATUS_ERROR;
+ }
+
+ void OpenEPT_ED_Platform_TxProtect()
+ {
+    /* OPENEPT: Code that remembers the queue position reached so far should be implemented here */
+ }
+
+ /*OPENEPT: Optional. Remove these two functions if the event ring (OPENEPT_ED_CONF_EVENT_RING_SLOTS) is not used */
+ void OpenEPT_ED_Platform_DrainRequest()
+ {
+    /* OPENEPT: Code that wakes the task calling OpenEPT_ED_Poll should be implemented here; called from interrupts too, must not block */
+ }
+
+ void OpenEPT_ED_Platform_Yield()
+ {
+    /* OPENEPT: Code that lets other threads run (e.g. RTOS yield or delay) should be implemented here */
+ }
+
+ /*OPENEPT: Optional. Remove this function if the platform does not support baud rate negotiation */
+ int OpenEPT_ED_Platform_Reconfigure(uint32_t baudrate)
+ {
+    /* OPENEPT: Code that changes SERIAL interface baud rate should be implemented here (0 restores initial rate) */
+     return OPEN_EPT_STATUS_OK;
+ }
+
  int OpenEPT_ED_Platform_SyncUp()
  {
     /* OPENEPT: Code that set SYNC pin high should be implemented here */
@@ -0,0 +1,678 @@
+/**
+ * @file platform_zephyr.c
+ * @brief Platform-specific implementation for Zephyr RTOS.
+ *
+ * This file implements the OpenEPT Embedded Device (ED) platform functions over the UART
+ * selected with the "openept,uart" devicetree chosen property. Frames are copied into a
+ * transmit ring and a work item drains it with the UART async API (uart_tx) or, with
+ * CONFIG_OPENEPT_TRANSPORT_POLL, with uart_poll_out, so setting an energy point costs
+ * only the copy. The optional SYNC pin is the "openept-sync" devicetree alias.
+ *
+ * @date November 3, 2024
+ * @author Dimitrije Lilic, Haris Turkmanovic
+ */
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/device.h>
+#include <zephyr/devicetree.h>
+#include <zephyr/drivers/gpio.h>
+#include <zephyr/drivers/uart.h>
+#include "../../feplib/feplib.h"
+#include "../../feplib/platform.h"
+
+#if !DT_HAS_CHOSEN(openept_uart)
+#error "Select the EP link UART with the openept,uart chosen property"
+#endif
+
+#define OPENEPT_ZEPHYR_TX_RING_MASK         (CONFIG_OPENEPT_TX_RING_SIZE - 1)
+
+#if (CONFIG_OPENEPT_TX_RING_SIZE & OPENEPT_ZEPHYR_TX_RING_MASK) != 0
+#error "CONFIG_OPENEPT_TX_RING_SIZE must be a power of two"
+#endif
+
+/* Size of the receive ring between the UART callback and OpenEPT_ED_Platform_TryRead, power of two */
+#define OPENEPT_ZEPHYR_RX_RING_SIZE         64
+
+/* Inactivity after which received bytes are reported, in microseconds */
+#define OPENEPT_ZEPHYR_RX_TIMEOUT_US        1000
+
+#ifdef CONFIG_OPENEPT_WORKQUEUE
+#define OPENEPT_ZEPHYR_WORKQUEUE            (&OPENEPT_WORKQUEUE)
+#else
+#define OPENEPT_ZEPHYR_WORKQUEUE            (&k_sys_work_q)
+#endif
+
+static const struct device* const OPENEPT_UART = DEVICE_DT_GET(DT_CHOSEN(openept_uart));
+
+#if DT_NODE_EXISTS(DT_ALIAS(openept_sync))
+static const struct gpio_dt_spec OPENEPT_SYNC = GPIO_DT_SPEC_GET(DT_ALIAS(openept_sync), gpios);
+#endif
+
+#ifdef CONFIG_OPENEPT_WORKQUEUE
+K_THREAD_STACK_DEFINE(OPENEPT_WORKQUEUE_STACK, CONFIG_OPENEPT_WORKQUEUE_STACK_SIZE);
+static struct k_work_q      OPENEPT_WORKQUEUE;
+#endif
+
+/*
+ * Transmit ring. A producer (OpenEPT API, thread or interrupt handler) reserves space by
+ * advancing reserve under the lock, copies its frame outside of it and the last producer
+ * to finish publishes everything reserved by advancing head, so frames of producers that
+ * interrupt each other never overlap and the drain only sees complete frames. Tail is
+ * advanced when the drain work item (poll transport) or the UART callback (async
+ * transport) has sent a segment. Indexes are free running and masked on access; the lock
+ * guards all of them.
+ */
+static uint8_t              OPENEPT_TX_RING[CONFIG_OPENEPT_TX_RING_SIZE];
+static volatile uint32_t    OPENEPT_TX_HEAD;
+static volatile uint32_t    OPENEPT_TX_RESERVE;
+/* Producers copying into their reserved space */
+static uint32_t             OPENEPT_TX_WRITERS;
+static volatile uint32_t    OPENEPT_TX_TAIL;
+static uint32_t             OPENEPT_TX_INFLIGHT;
+/* Discarded bytes right after the segment in flight, released together with it */
+static uint32_t             OPENEPT_TX_SKIP;
+/* Ring position up to which frames are never discarded */
+static uint32_t             OPENEPT_TX_PROTECT;
+/* The UART has sent the beginning of the frame at the tail */
+static uint8_t              OPENEPT_TX_CUT;
+/* Number of frames discarded because the ring was full */
+static uint32_t             OPENEPT_TX_DROPPED;
+static struct k_spinlock    OPENEPT_TX_LOCK;
+static struct k_work        OPENEPT_TX_WORK;
+/* Sends events queued to the event ring and thread buffers of the default context */
+static struct k_work        OPENEPT_DRAIN_WORK;
+
+#ifdef CONFIG_OPENEPT_TRANSPORT_ASYNC
+/*
+ * Receive ring. The UART callback copies received bytes in, OpenEPT_ED_Platform_TryRead
+ * takes them out. Reception alternates between two buffers handed to the driver.
+ */
+static uint8_t              OPENEPT_RX_RING[OPENEPT_ZEPHYR_RX_RING_SIZE];
+static volatile uint32_t    OPENEPT_RX_WRITE;
+static uint32_t             OPENEPT_RX_READ;
+static uint8_t              OPENEPT_RX_BUFFERS[2][CONFIG_OPENEPT_RX_BUFFER_SIZE];
+static uint32_t             OPENEPT_RX_NEXT;
+#endif
+
+/* Baud rate at initialization, restored after a negotiated session ends */
+static uint32_t             OPENEPT_BAUDRATE;
+
+#ifndef CONFIG_TIMER_HAS_64BIT_CYCLE_COUNTER
+/* Hardware cycle counter extended to 64 bits, event timestamp source */
+static OpenEPT_ED_CounterExtender   OPENEPT_CYCLES;
+static struct k_spinlock            OPENEPT_CYCLES_LOCK;
+#endif
+
+#ifdef CONFIG_THREAD_LOCAL_STORAGE
+static __thread void*       OPENEPT_THREAD_BUFFER;
+#endif
+
+
+/*
+ * Release sent or discarded data at the tail. Called with the lock held, so the byte before
+ * the new tail is not reused before it is checked.
+ */
+static void OpenEPT_ED_Platform_TxAdvance(uint32_t size)
+{
+    if(size == 0) return;
+    OPENEPT_TX_TAIL += size;
+    OPENEPT_TX_CUT = OPENEPT_TX_RING[(OPENEPT_TX_TAIL - 1) & OPENEPT_ZEPHYR_TX_RING_MASK] != 0x00;
+}
+
+/*
+ * Take the next contiguous part of the ring for sending if no segment is in flight.
+ * Returns its size, 0 if the ring is empty or a segment is already in flight.
+ */
+static uint32_t OpenEPT_ED_Platform_TxClaim(uint32_t* offset)
+{
+    k_spinlock_key_t key = k_spin_lock(&OPENEPT_TX_LOCK);
+    uint32_t pending;
+    uint32_t size = 0;
+
+    if(OPENEPT_TX_INFLIGHT == 0)
+    {
+        OpenEPT_ED_Platform_TxAdvance(OPENEPT_TX_SKIP);
+        OPENEPT_TX_SKIP = 0;
+        pending = OPENEPT_TX_HEAD - OPENEPT_TX_TAIL;
+        *offset = OPENEPT_TX_TAIL & OPENEPT_ZEPHYR_TX_RING_MASK;
+        size = CONFIG_OPENEPT_TX_RING_SIZE - *offset;
+        if(size > pending) size = pending;
+        OPENEPT_TX_INFLIGHT = size;
+    }
+    k_spin_unlock(&OPENEPT_TX_LOCK, key);
+    return size;
+}
+
+/*
+ * Release the segment in flight. Sent data is dropped from the ring, otherwise the
+ * segment is offered again on the next claim.
+ */
+static void OpenEPT_ED_Platform_TxRelease(int sent)
+{
+    k_spinlock_key_t key = k_spin_lock(&OPENEPT_TX_LOCK);
+    if(sent) OpenEPT_ED_Platform_TxAdvance(OPENEPT_TX_INFLIGHT);
+    OPENEPT_TX_INFLIGHT = 0;
+    k_spin_unlock(&OPENEPT_TX_LOCK, key);
+}
+
+/*
+ * Drain work item. The async transport starts transfer of one segment and is submitted
+ * again by the UART callback when it completes; the poll transport writes the whole
+ * ring. Also called directly by threads waiting for ring space, so waiting does not
+ * depend on the workqueue getting the CPU.
+ */
+static void OpenEPT_ED_Platform_TxWork(struct k_work* work)
+{
+    uint32_t offset;
+    uint32_t size;
+#ifndef CONFIG_OPENEPT_TRANSPORT_ASYNC
+    uint32_t cnt;
+#endif
+
+    ARG_UNUSED(work);
+#ifdef CONFIG_OPENEPT_TRANSPORT_ASYNC
+    size = OpenEPT_ED_Platform_TxClaim(&offset);
+    if(size == 0) return;
+    if(uart_tx(OPENEPT_UART, &OPENEPT_TX_RING[offset], size, SYS_FOREVER_US) != 0)
+    {
+        OpenEPT_ED_Platform_TxRelease(0);
+    }
+#else
+    while((size = OpenEPT_ED_Platform_TxClaim(&offset)) != 0)
+    {
+        for(cnt = 0; cnt < size; cnt++) uart_poll_out(OPENEPT_UART, OPENEPT_TX_RING[offset + cnt]);
+        OpenEPT_ED_Platform_TxRelease(1);
+    }
+#endif
+}
+
+static void OpenEPT_ED_Platform_TxSubmit()
+{
+    k_work_submit_to_queue(OPENEPT_ZEPHYR_WORKQUEUE, &OPENEPT_TX_WORK);
+}
+
+/*
+ * Event drain work item, submitted by OpenEPT_ED_Platform_DrainRequest.
+ */
+static void OpenEPT_ED_Platform_DrainWork(struct k_work* work)
+{
+    ARG_UNUSED(work);
+    OpenEPT_ED_Poll();
+}
+
+#ifdef CONFIG_OPENEPT_TRANSPORT_ASYNC
+
+static int OpenEPT_ED_Platform_RxStart()
+{
+    OPENEPT_RX_NEXT = 1;
+    return uart_rx_enable(OPENEPT_UART, OPENEPT_RX_BUFFERS[0], CONFIG_OPENEPT_RX_BUFFER_SIZE, OPENEPT_ZEPHYR_RX_TIMEOUT_US);
+}
+
+/**
+ * @brief UART async API callback.
+ *
+ * Releases the segment that was just sent and submits the drain work item for the next
+ * one, copies received bytes into the receive ring and keeps reception running.
+ *
+ * @param dev UART device.
+ * @param evt UART event.
+ * @param user_data Unused.
+ */
+static void OpenEPT_ED_Platform_UartCallback(const struct device* dev, struct uart_event* evt, void* user_data)
+{
+    uint32_t cnt;
+
+    ARG_UNUSED(user_data);
+    switch(evt->type)
+    {
+    case UART_TX_DONE:
+    case UART_TX_ABORTED:
+        //Aborted segment is dropped too, the ring must not stall on a transmit error
+        OpenEPT_ED_Platform_TxRelease(1);
+        OpenEPT_ED_Platform_TxSubmit();
+        break;
+    case UART_RX_RDY:
+        for(cnt = 0; cnt < evt->data.rx.len; cnt++)
+        {
+            //Bytes that do not fit are lost, responses are read long before the ring fills
+            if(OPENEPT_RX_WRITE - OPENEPT_RX_READ == OPENEPT_ZEPHYR_RX_RING_SIZE) break;
+            OPENEPT_RX_RING[OPENEPT_RX_WRITE & (OPENEPT_ZEPHYR_RX_RING_SIZE - 1)] = evt->data.rx.buf[evt->data.rx.offset + cnt];
+            OPENEPT_RX_WRITE = OPENEPT_RX_WRITE + 1;
+        }
+        break;
+    case UART_RX_BUF_REQUEST:
+        uart_rx_buf_rsp(dev, OPENEPT_RX_BUFFERS[OPENEPT_RX_NEXT], CONFIG_OPENEPT_RX_BUFFER_SIZE);
+        OPENEPT_RX_NEXT ^= 1;
+        break;
+    case UART_RX_DISABLED:
+        //Reception stops on line errors, start it again
+        OpenEPT_ED_Platform_RxStart();
+        break;
+    default:
+        break;
+    }
+}
+
+#endif /* CONFIG_OPENEPT_TRANSPORT_ASYNC */
+
+/**
+ * @brief Initializes the platform-specific peripherals for OpenEPT ED.
+ *
+ * This function checks the EP link UART, configures the SYNC pin if the board has one
+ * and, on the first call, starts the drain workqueue and reception.
+ *
+ * @return OPEN_EPT_STATUS_OK if initialization is successful,
+ *         OPEN_EPT_STATUS_ERROR if a device is not ready or reception can not start.
+ */
+int OpenEPT_ED_Platform_Init()
+{
+    static bool started;
+#ifdef CONFIG_UART_USE_RUNTIME_CONFIGURE
+    struct uart_config config;
+#endif
+
+    if(!device_is_ready(OPENEPT_UART)) return OPEN_EPT_STATUS_ERROR;
+#if DT_NODE_EXISTS(DT_ALIAS(openept_sync))
+    if(!gpio_is_ready_dt(&OPENEPT_SYNC)) return OPEN_EPT_STATUS_ERROR;
+    if(gpio_pin_configure_dt(&OPENEPT_SYNC, GPIO_OUTPUT_INACTIVE) != 0) return OPEN_EPT_STATUS_ERROR;
+#endif
+    if(started) return OPEN_EPT_STATUS_OK;
+
+#ifdef CONFIG_UART_USE_RUNTIME_CONFIGURE
+    if(uart_config_get(OPENEPT_UART, &config) == 0) OPENEPT_BAUDRATE = config.baudrate;
+#endif
+    k_work_init(&OPENEPT_TX_WORK, OpenEPT_ED_Platform_TxWork);
+    k_work_init(&OPENEPT_DRAIN_WORK, OpenEPT_ED_Platform_DrainWork);
+#ifdef CONFIG_OPENEPT_WORKQUEUE
+    k_work_queue_start(&OPENEPT_WORKQUEUE, OPENEPT_WORKQUEUE_STACK, K_THREAD_STACK_SIZEOF(OPENEPT_WORKQUEUE_STACK),
+                       CONFIG_OPENEPT_WORKQUEUE_PRIORITY, NULL);
+    k_thread_name_set(&OPENEPT_WORKQUEUE.thread, "openept");
+#endif
+#ifdef CONFIG_OPENEPT_TRANSPORT_ASYNC
+    if(uart_callback_set(OPENEPT_UART, OpenEPT_ED_Platform_UartCallback, NULL) != 0) return OPEN_EPT_STATUS_ERROR;
+    if(OpenEPT_ED_Platform_RxStart() != 0) return OPEN_EPT_STATUS_ERROR;
+#endif
+    started = true;
+    return OPEN_EPT_STATUS_OK;
+}
+
+/**
+ * @brief Sends a single character over UART.
+ *
+ * This function queues one character into the transmit ring.
+ *
+ * @param character The character to be transmitted.
+ * @return OPEN_EPT_STATUS_OK if character is queued,
+ *         OPEN_EPT_STATUS_ERROR if it is discarded.
+ */
+int OpenEPT_ED_Platform_Send(char character)
+{
+    return OpenEPT_ED_Platform_SendBuffer((const uint8_t*)&character, 1);
+}
+
+/**
+ * @brief Sends a buffer over UART.
+ *
+ * This function queues the whole buffer into the transmit ring.
+ *
+ * @param buffer Pointer to the data to be transmitted.
+ * @param size Number of bytes to transmit.
+ * @return OPEN_EPT_STATUS_OK if buffer is queued,
+ *         OPEN_EPT_STATUS_ERROR if it is discarded.
+ */
+int OpenEPT_ED_Platform_SendBuffer(const uint8_t* buffer, uint32_t size)
+{
+    OpenEPT_ED_Platform_Segment segment;
+    segment.data = buffer;
+    segment.size = size;
+    return OpenEPT_ED_Platform_SendSegments(&segment, 1);
+}
+
+/**
+ * @brief Sends a frame made of several segments over UART.
+ *
+ * The frame is copied into the transmit ring as a whole and the drain work item is
+ * submitted; the function returns without touching the UART. Threads and interrupt
+ * handlers may call it concurrently. When the frame does not fit, a thread waits for the
+ * ring to drain, unless CONFIG_OPENEPT_TX_OVERFLOW_DROP is set. Frames from interrupt
+ * handlers never wait and are discarded instead.
+ *
+ * @param segments Array of frame segments to transmit in order.
+ * @param count Number of segments.
+ * @return OPEN_EPT_STATUS_OK if frame is queued,
+ *         OPEN_EPT_STATUS_ERROR if frame is discarded.
+ */
+int OpenEPT_ED_Platform_SendSegments(const OpenEPT_ED_Platform_Segment* segments, uint32_t count)
+{
+    k_spinlock_key_t key;
+    uint32_t total = 0;
+    uint32_t head;
+    uint32_t offset;
+    uint32_t chunk;
+    uint32_t cnt;
+
+    for(cnt = 0; cnt < count; cnt++) total += segments[cnt].size;
+    if(total > CONFIG_OPENEPT_TX_RING_SIZE) return OPEN_EPT_STATUS_ERROR;
+
+    //Reserve space in the ring
+    for(;;)
+    {
+        key = k_spin_lock(&OPENEPT_TX_LOCK);
+        if(CONFIG_OPENEPT_TX_RING_SIZE - (OPENEPT_TX_RESERVE - OPENEPT_TX_TAIL) >= total) break;
+        if(OPENEPT_ED_CONF_TX_OVERFLOW_POLICY == OPENEPT_ED_TX_OVERFLOW_DROP || k_is_in_isr())
+        {
+            OPENEPT_TX_DROPPED += 1;
+            k_spin_unlock(&OPENEPT_TX_LOCK, key);
+            return OPEN_EPT_STATUS_ERROR;
+        }
+        k_spin_unlock(&OPENEPT_TX_LOCK, key);
+        OpenEPT_ED_Platform_TxWork(NULL);
+        k_sleep(K_TICKS(1));
+    }
+    head = OPENEPT_TX_RESERVE;
+    OPENEPT_TX_RESERVE += total;
+    OPENEPT_TX_WRITERS += 1;
+    k_spin_unlock(&OPENEPT_TX_LOCK, key);
+
+    //Copy frame into the reserved space
+    for(cnt = 0; cnt < count; cnt++)
+    {
+        const uint8_t* data = segments[cnt].data;
+        uint32_t size = segments[cnt].size;
+        while(size > 0)
+        {
+            offset = head & OPENEPT_ZEPHYR_TX_RING_MASK;
+            chunk = CONFIG_OPENEPT_TX_RING_SIZE - offset;
+            if(chunk > size) chunk = size;
+            memcpy(&OPENEPT_TX_RING[offset], data, chunk);
+            data += chunk;
+            size -= chunk;
+            head += chunk;
+        }
+    }
+
+    //Producer interrupted in its copy publishes this frame together with its own
+    key = k_spin_lock(&OPENEPT_TX_LOCK);
+    OPENEPT_TX_WRITERS -= 1;
+    if(OPENEPT_TX_WRITERS == 0) OPENEPT_TX_HEAD = OPENEPT_TX_RESERVE;
+    k_spin_unlock(&OPENEPT_TX_LOCK, key);
+
+    OpenEPT_ED_Platform_TxSubmit();
+    return OPEN_EPT_STATUS_OK;
+}
+
+/**
+ * @brief Requests sending of queued events.
+ *
+ * Called by threads and interrupt handlers after they queued an event to the event ring
+ * (CONFIG_OPENEPT_EVENT_RING_SLOTS) or a thread buffer; submits the event drain work item
+ * to the drain workqueue. A submitted item is not queued twice, so bursts cost one poll.
+ */
+void OpenEPT_ED_Platform_DrainRequest()
+{
+    k_work_submit_to_queue(OPENEPT_ZEPHYR_WORKQUEUE, &OPENEPT_DRAIN_WORK);
+}
+
+/**
+ * @brief Waits while another thread uses the transport.
+ *
+ * Sleeps a tick rather than yielding, so a lower priority thread holding the transport
+ * gets the CPU to release it.
+ */
+void OpenEPT_ED_Platform_Yield()
+{
+    k_sleep(K_TICKS(1));
+}
+
+/**
+ * @brief Waits until all queued data is transmitted.
+ *
+ * This function blocks until the transmit ring is empty and no segment is in flight,
+ * or until OPENEPT_ED_CONF_TX_FLUSH_TIMEOUT_MS expires.
+ *
+ * @return OPEN_EPT_STATUS_OK if everything is transmitted,
+ *         OPEN_EPT_STATUS_ERROR on timeout.
+ */
+int OpenEPT_ED_Platform_Flush()
+{
+    uint32_t start = k_uptime_get_32();
+    //Frames reserved by producers that are still copying them are waited for too
+    while(OPENEPT_TX_RESERVE != OPENEPT_TX_TAIL + OPENEPT_TX_SKIP || OPENEPT_TX_INFLIGHT != 0)
+    {
+        OpenEPT_ED_Platform_TxWork(NULL);
+        if(k_uptime_get_32() - start > OPENEPT_ED_CONF_TX_FLUSH_TIMEOUT_MS) return OPEN_EPT_STATUS_ERROR;
+        k_sleep(K_TICKS(1));
+    }
+    return OPEN_EPT_STATUS_OK;
+}
+
+/**
+ * @brief Returns free space in the transmit ring.
+ *
+ * Discarded data that waits for the segment in flight to complete counts as free.
+ *
+ * @return Number of free bytes.
+ */
+uint32_t OpenEPT_ED_Platform_TxSpace()
+{
+    k_spinlock_key_t key = k_spin_lock(&OPENEPT_TX_LOCK);
+    uint32_t used = OPENEPT_TX_RESERVE - OPENEPT_TX_TAIL - OPENEPT_TX_SKIP;
+    k_spin_unlock(&OPENEPT_TX_LOCK, key);
+    return CONFIG_OPENEPT_TX_RING_SIZE - used;
+}
+
+/**
+ * @brief Discards the oldest frame in the transmit ring that is not in flight yet.
+ *
+ * Data after the segment in flight is dropped up to the next 0x00 delimiter, which is
+ * dropped too when a frame starts there. When the UART has already sent the beginning of
+ * a frame, the delimiter is kept to end that partial frame, which the receiver rejects, so
+ * the partial frame is the one lost; a further discard drops the next frame and keeps its
+ * delimiter instead. Nothing is dropped while protected frames wait in the ring.
+ *
+ * @return OPEN_EPT_STATUS_OK if a frame is discarded,
+ *         OPEN_EPT_STATUS_ERROR if no complete unprotected frame waits in the ring.
+ */
+int OpenEPT_ED_Platform_TxDiscard()
+{
+    k_spinlock_key_t key = k_spin_lock(&OPENEPT_TX_LOCK);
+    uint32_t start = OPENEPT_TX_TAIL + OPENEPT_TX_INFLIGHT + OPENEPT_TX_SKIP;
+    uint32_t pos = start;
+    uint8_t cut;
+    int result = OPEN_EPT_STATUS_ERROR;
+
+    cut = start != OPENEPT_TX_TAIL ? OPENEPT_TX_RING[(start - 1) & OPENEPT_ZEPHYR_TX_RING_MASK] != 0x00 : OPENEPT_TX_CUT;
+    //Protected position not reached by the UART yet
+    if((int32_t)(OPENEPT_TX_PROTECT - start) > 0) pos = OPENEPT_TX_HEAD;
+    //Delimiter already kept for the partial frame, drop the frame after it
+    else if(cut && pos != OPENEPT_TX_HEAD && OPENEPT_TX_RING[pos & OPENEPT_ZEPHYR_TX_RING_MASK] == 0x00) pos++;
+    for(; pos != OPENEPT_TX_HEAD; pos++)
+    {
+        if(OPENEPT_TX_RING[pos & OPENEPT_ZEPHYR_TX_RING_MASK] != 0x00) continue;
+        OPENEPT_TX_SKIP += (cut ? pos : pos + 1) - start;
+        result = OPEN_EPT_STATUS_OK;
+        break;
+    }
+    k_spin_unlock(&OPENEPT_TX_LOCK, key);
+    return result;
+}
+
+/**
+ * @brief Protects frames queued so far from OpenEPT_ED_Platform_TxDiscard.
+ */
+void OpenEPT_ED_Platform_TxProtect()
+{
+    k_spinlock_key_t key = k_spin_lock(&OPENEPT_TX_LOCK);
+    //Frames still being copied by interrupted producers are covered too
+    OPENEPT_TX_PROTECT = OPENEPT_TX_RESERVE;
+    k_spin_unlock(&OPENEPT_TX_LOCK, key);
+}
+
+/**
+ * @brief Read a single character over UART.
+ *
+ * This function waits for up to OPENEPT_ED_CONF_READ_TIMEOUT_MS for a character,
+ * sleeping a tick between attempts.
+ *
+ * @param character Read character.
+ * @return OPEN_EPT_STATUS_OK if character is read,
+ *         OPEN_EPT_STATUS_ERROR on timeout.
+ */
+int OpenEPT_ED_Platform_Read(char* character)
+{
+    uint32_t start = k_uptime_get_32();
+    while(OpenEPT_ED_Platform_TryRead(character) != OPEN_EPT_STATUS_OK)
+    {
+        if(k_uptime_get_32() - start > OPENEPT_ED_CONF_READ_TIMEOUT_MS) return OPEN_EPT_STATUS_ERROR;
+        k_sleep(K_TICKS(1));
+    }
+    return OPEN_EPT_STATUS_OK;
+}
+
+/**
+ * @brief Read a single character over UART if one is available.
+ *
+ * @param character Read character.
+ * @return OPEN_EPT_STATUS_OK if character is read,
+ *         OPEN_EPT_STATUS_ERROR if nothing is received.
+ */
+int OpenEPT_ED_Platform_TryRead(char* character)
+{
+#ifdef CONFIG_OPENEPT_TRANSPORT_ASYNC
+    if(OPENEPT_RX_READ == OPENEPT_RX_WRITE) return OPEN_EPT_STATUS_ERROR;
+    *character = (char)OPENEPT_RX_RING[OPENEPT_RX_READ & (OPENEPT_ZEPHYR_RX_RING_SIZE - 1)];
+    OPENEPT_RX_READ++;
+    return OPEN_EPT_STATUS_OK;
+#else
+    return uart_poll_in(OPENEPT_UART, (unsigned char*)character) == 0 ? OPEN_EPT_STATUS_OK : OPEN_EPT_STATUS_ERROR;
+#endif
+}
+
+/**
+ * @brief Changes UART baud rate.
+ *
+ * Waits for the transmit ring to drain and reconfigures the UART. Needs
+ * CONFIG_UART_USE_RUNTIME_CONFIGURE and a driver that supports it, otherwise only
+ * the initial rate is accepted.
+ *
+ * @param baudrate New baud rate, 0 restores the rate at initialization.
+ * @return OPEN_EPT_STATUS_OK if baud rate is changed,
+ *         OPEN_EPT_STATUS_ERROR if transmission does not complete or the driver refuses it.
+ */
+int OpenEPT_ED_Platform_Reconfigure(uint32_t baudrate)
+{
+#ifdef CONFIG_UART_USE_RUNTIME_CONFIGURE
+    struct uart_config config;
+
+    if(baudrate == 0) baudrate = OPENEPT_BAUDRATE;
+    if(OpenEPT_ED_Platform_Flush() != OPEN_EPT_STATUS_OK) return OPEN_EPT_STATUS_ERROR;
+    if(uart_config_get(OPENEPT_UART, &config) != 0) return OPEN_EPT_STATUS_ERROR;
+    if(config.baudrate == baudrate) return OPEN_EPT_STATUS_OK;
+    config.baudrate = baudrate;
+    return uart_configure(OPENEPT_UART, &config) == 0 ? OPEN_EPT_STATUS_OK : OPEN_EPT_STATUS_ERROR;
+#else
+    return (baudrate == 0 || baudrate == OPENEPT_BAUDRATE) ? OPEN_EPT_STATUS_OK : OPEN_EPT_STATUS_ERROR;
+#endif
+}
+
+/**
+ * @brief Millisecond tick.
+ *
+ * @return Kernel uptime in milliseconds.
+ */
+uint32_t OpenEPT_ED_Platform_GetTickMs()
+{
+    return k_uptime_get_32();
+}
+
+/**
+ * @brief Event timestamp.
+ *
+ * Hardware cycle counter, extended to 64 bits with the kernel uptime when the timer
+ * driver only has 32 bits. The extension state is updated under a spinlock, so energy
+ * points may also be set from interrupt handlers.
+ *
+ * @return Hardware clock cycles.
+ */
+uint64_t OpenEPT_ED_Platform_GetTimestamp()
+{
+#ifdef CONFIG_TIMER_HAS_64BIT_CYCLE_COUNTER
+    return k_cycle_get_64();
+#else
+    k_spinlock_key_t key = k_spin_lock(&OPENEPT_CYCLES_LOCK);
+    uint64_t timestamp = OpenEPT_ED_ExtendCounter(&OPENEPT_CYCLES, k_cycle_get_32(), k_uptime_get_32(),
+                                                  (uint32_t)sys_clock_hw_cycles_per_sec());
+    k_spin_unlock(&OPENEPT_CYCLES_LOCK, key);
+    return timestamp;
+#endif
+}
+
+/**
+ * @brief Event timestamp frequency.
+ *
+ * @return Hardware clock cycles per second.
+ */
+uint32_t OpenEPT_ED_Platform_GetTimestampFrequency()
+{
+    return (uint32_t)sys_clock_hw_cycles_per_sec();
+}
+
+#ifdef CONFIG_THREAD_LOCAL_STORAGE
+/*
+ * Event buffer of the calling thread, kept in thread-local storage.
+ */
+void* OpenEPT_ED_Platform_GetThreadBuffer()
+{
+    return OPENEPT_THREAD_BUFFER;
+}
+
+void OpenEPT_ED_Platform_SetThreadBuffer(void* buffer)
+{
+    OPENEPT_THREAD_BUFFER = buffer;
+}
+#endif
+
+/**
+ * @brief Synchronizes up by setting the SYNC pin active.
+ *
+ * @return OPEN_EPT_STATUS_OK if the pin is set or the board has no SYNC pin,
+ *         OPEN_EPT_STATUS_ERROR if the GPIO driver fails.
+ */
+int OpenEPT_ED_Platform_SyncUp()
+{
+#if DT_NODE_EXISTS(DT_ALIAS(openept_sync))
+    return gpio_pin_set_dt(&OPENEPT_SYNC, 1) == 0 ? OPEN_EPT_STATUS_OK : OPEN_EPT_STATUS_ERROR;
+#else
+    return OPEN_EPT_STATUS_OK;
+#endif
+}
+
+/**
+ * @brief Synchronizes down by setting the SYNC pin inactive.
+ *
+ * @return OPEN_EPT_STATUS_OK if the pin is set or the board has no SYNC pin,
+ *         OPEN_EPT_STATUS_ERROR if the GPIO driver fails.
+ */
+int OpenEPT_ED_Platform_SyncDown()
+{
+#if DT_NODE_EXISTS(DT_ALIAS(openept_sync))
+    return gpio_pin_set_dt(&OPENEPT_SYNC, 0) == 0 ? OPEN_EPT_STATUS_OK : OPEN_EPT_STATUS_ERROR;
+#else
+    return OPEN_EPT_STATUS_OK;
+#endif
+}
+
+/**
+ * @brief Toggles the SYNC pin.
+ *
+ * @return OPEN_EPT_STATUS_OK if the pin is toggled or the board has no SYNC pin,
+ *         OPEN_EPT_STATUS_ERROR if the GPIO driver fails.
+ */
+int OpenEPT_ED_Platform_SyncToogle()
+{
+#if DT_NODE_EXISTS(DT_ALIAS(openept_sync))
+    return gpio_pin_toggle_dt(&OPENEPT_SYNC) == 0 ? OPEN_EPT_STATUS_OK : OPEN_EPT_STATUS_ERROR;
+#else
+    return OPEN_EPT_STATUS_OK;
+#endif
+}
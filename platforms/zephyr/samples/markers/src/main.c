@@ -0,0 +1,45 @@
+/**
+ * @file main.c
+ * @brief Energy point markers on Zephyr.
+ *
+ * Sets MARKERS energy points and prints how many hardware clock cycles each call took,
+ * so the cost of the whole path up to the transmit ring is visible on native_sim.
+ */
+#include <zephyr/kernel.h>
+#include <zephyr/sys/printk.h>
+#include "feplib.h"
+
+#define MARKERS     1000
+
+int main(void)
+{
+    uint32_t start;
+    uint32_t cycles;
+    uint32_t min = UINT32_MAX;
+    uint32_t max = 0;
+    uint64_t sum = 0;
+    uint32_t cnt;
+
+    if(OpenEPT_ED_Init() != OPEN_EPT_STATUS_OK)
+    {
+        printk("openept: EP link UART is not ready\n");
+        return 0;
+    }
+    //Wait for the Acquisition side (openept_emu) to attach to the pty
+    while(OpenEPT_ED_Start() != OPEN_EPT_STATUS_OK) printk("openept: waiting for Acquisition device\n");
+    for(cnt = 0; cnt < MARKERS; cnt++)
+    {
+        start = k_cycle_get_32();
+        OPENEPT_EP("marker");
+        cycles = k_cycle_get_32() - start;
+        if(cycles < min) min = cycles;
+        if(cycles > max) max = cycles;
+        sum += cycles;
+        //Let the drain workqueue run, as an application would between markers
+        k_sleep(K_USEC(100));
+    }
+    printk("openept: %u markers, cycles min %u avg %u max %u at %u Hz, %u dropped\n", MARKERS, min,
+           (uint32_t)(sum / MARKERS), max, (uint32_t)sys_clock_hw_cycles_per_sec(), OpenEPT_ED_GetDropped());
+    printk("openept: stop %d\n", OpenEPT_ED_Stop());
+    return 0;
+}
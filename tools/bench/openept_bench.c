@@ -0,0 +1,353 @@
+/**
+ * @file openept_bench.c
+ * @brief Event throughput of the shared event ring against per-thread buffers.
+ *
+ * For 1..N producer threads, every thread sets energy points as fast as it can for a fixed
+ * time, either into the shared event ring or into its own thread buffer
+ * (OpenEPT_ED_Ctx_AttachThread). One drain thread is woken by the drainRequest operation
+ * and sends with OpenEPT_ED_Ctx_Poll, the same way in both modes. The transport only counts
+ * frames, so the numbers show the cost of the library and not of a link; it answers the
+ * START handshake itself so events are timestamped binary frames as in a real session.
+ *
+ * Merge mode isolates the drain: one thread fills every thread buffer, events interleaved
+ * by timestamp across buffers, and times the flush that merges and sends them.
+ *
+ * Built with both queues enabled, e.g.
+ * -DOPENEPT_ED_CONF_EVENT_RING_SLOTS=256 -DOPENEPT_ED_CONF_THREAD_BUFFERS=32.
+ */
+#ifndef _DEFAULT_SOURCE
+#define _DEFAULT_SOURCE
+#endif
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "../../feplib/feplib.h"
+#include "../../feplib/platform.h"
+
+#if OPENEPT_CONF_EVENT_RING_SLOTS == 0 || OPENEPT_CONF_THREAD_BUFFERS == 0
+#error "openept_bench compares event ring and thread buffers, build with -DOPENEPT_ED_CONF_EVENT_RING_SLOTS=<slots> -DOPENEPT_ED_CONF_THREAD_BUFFERS=<threads>"
+#endif
+
+#define OPENEPT_BENCH_THREADS_MAX   OPENEPT_CONF_THREAD_BUFFERS
+#define OPENEPT_BENCH_REPLY         "OK PROTO=1\r"
+
+/* Benchmark modes */
+#define OPENEPT_BENCH_MODE_RING     0
+#define OPENEPT_BENCH_MODE_THREAD   1
+#define OPENEPT_BENCH_MODE_MERGE    2
+
+static const char* const OPENEPT_BENCH_MODE_NAMES[] = { "ring", "thread", "merge" };
+
+typedef struct
+{
+    pthread_t               thread;
+    uint32_t                epId;
+    char                    name[16];
+    OpenEPT_ED_ThreadBuffer buffer;
+    uint64_t                queued;        /* Calls that returned OK */
+    uint64_t                failed;        /* Calls that returned an error, queue was full */
+}OpenEPT_Bench_Producer;
+
+/*
+ * Null sink transport: counts frames, answers START with OPENEPT_BENCH_REPLY.
+ */
+typedef struct
+{
+    uint64_t    frames;
+    uint64_t    bytes;
+    const char* reply;
+}OpenEPT_Bench_Sink;
+
+static struct
+{
+    uint32_t    threads;
+    uint32_t    durationMs;
+    int         mode;
+}OPENEPT_BENCH_CONF;
+
+static OpenEPT_ED_Context       OPENEPT_BENCH_CTX;
+static OpenEPT_Bench_Sink       OPENEPT_BENCH_SINK;
+static OpenEPT_Bench_Producer   OPENEPT_BENCH_PRODUCERS[OPENEPT_BENCH_THREADS_MAX];
+static sem_t                    OPENEPT_BENCH_DRAIN;
+static uint32_t                 OPENEPT_BENCH_RUN;
+static pthread_barrier_t        OPENEPT_BENCH_GO;
+
+static uint64_t OpenEPT_Bench_NowNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static int OpenEPT_Bench_SendBuffer(void* arg, const uint8_t* buffer, uint32_t size)
+{
+    OpenEPT_Bench_Sink* sink = (OpenEPT_Bench_Sink*)arg;
+    uint32_t cnt;
+
+    if(size >= 7 && memcmp(buffer, "0:START", 7) == 0) sink->reply = OPENEPT_BENCH_REPLY;
+    for(cnt = 0; cnt < size; cnt++)
+    {
+        if(buffer[cnt] == 0x00) sink->frames++;
+    }
+    sink->bytes += size;
+    return 0;
+}
+
+static int OpenEPT_Bench_TryRead(void* arg, char* character)
+{
+    OpenEPT_Bench_Sink* sink = (OpenEPT_Bench_Sink*)arg;
+
+    if(sink->reply == NULL || *sink->reply == '\0') return 1;
+    *character = *sink->reply++;
+    return 0;
+}
+
+static uint32_t OpenEPT_Bench_GetTickMs(void* arg)
+{
+    (void)arg;
+    return (uint32_t)(OpenEPT_Bench_NowNs() / 1000000ull);
+}
+
+static uint64_t OpenEPT_Bench_GetTimestamp(void* arg)
+{
+    (void)arg;
+    return OpenEPT_Bench_NowNs();
+}
+
+static uint32_t OpenEPT_Bench_GetTimestampFrequency(void* arg)
+{
+    (void)arg;
+    return 1000000000u;
+}
+
+/*
+ * Wake the drain thread; one pending wake is enough, it sends everything queued so far.
+ */
+static void OpenEPT_Bench_DrainRequest(void* arg)
+{
+    int value;
+
+    (void)arg;
+    if(sem_getvalue(&OPENEPT_BENCH_DRAIN, &value) == 0 && value > 0) return;
+    sem_post(&OPENEPT_BENCH_DRAIN);
+}
+
+static const OpenEPT_ED_TransportOps OPENEPT_BENCH_OPS =
+{
+    NULL,
+    OpenEPT_Bench_SendBuffer,
+    NULL,
+    NULL,
+    OpenEPT_Bench_TryRead,
+    NULL,
+    NULL,
+    OpenEPT_Bench_GetTickMs,
+    OpenEPT_Bench_GetTimestamp,
+    OpenEPT_Bench_GetTimestampFrequency,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    OpenEPT_Bench_DrainRequest,
+    NULL,
+    NULL
+};
+
+static void* OpenEPT_Bench_Producer_Run(void* arg)
+{
+    OpenEPT_Bench_Producer* producer = (OpenEPT_Bench_Producer*)arg;
+
+    if(OPENEPT_BENCH_CONF.mode == OPENEPT_BENCH_MODE_THREAD) OpenEPT_ED_Ctx_AttachThread(&OPENEPT_BENCH_CTX, &producer->buffer);
+    pthread_barrier_wait(&OPENEPT_BENCH_GO);
+    while(__atomic_load_n(&OPENEPT_BENCH_RUN, __ATOMIC_RELAXED))
+    {
+        if(OpenEPT_ED_Ctx_SetEP(&OPENEPT_BENCH_CTX, producer->epId) == OPEN_EPT_STATUS_OK) producer->queued++;
+        else producer->failed++;
+    }
+    return NULL;
+}
+
+static void* OpenEPT_Bench_Drain_Run(void* arg)
+{
+    (void)arg;
+    while(__atomic_load_n(&OPENEPT_BENCH_RUN, __ATOMIC_ACQUIRE))
+    {
+        sem_wait(&OPENEPT_BENCH_DRAIN);
+        OpenEPT_ED_Ctx_Poll(&OPENEPT_BENCH_CTX);
+    }
+    return NULL;
+}
+
+/*
+ * Fresh context and session with one registered EP per producer.
+ */
+static int OpenEPT_Bench_Begin(uint32_t threads)
+{
+    uint32_t cnt;
+
+    memset(&OPENEPT_BENCH_SINK, 0, sizeof(OPENEPT_BENCH_SINK));
+    memset(OPENEPT_BENCH_PRODUCERS, 0, sizeof(OPENEPT_BENCH_PRODUCERS));
+    if(OpenEPT_ED_Ctx_Init(&OPENEPT_BENCH_CTX, &OPENEPT_BENCH_OPS, &OPENEPT_BENCH_SINK) != OPEN_EPT_STATUS_OK) return 1;
+    for(cnt = 0; cnt < threads; cnt++)
+    {
+        snprintf(OPENEPT_BENCH_PRODUCERS[cnt].name, sizeof(OPENEPT_BENCH_PRODUCERS[cnt].name), "T%u", cnt);
+        OpenEPT_ED_Ctx_RegisterEP(&OPENEPT_BENCH_CTX, OPENEPT_BENCH_PRODUCERS[cnt].name, &OPENEPT_BENCH_PRODUCERS[cnt].epId);
+    }
+    if(OpenEPT_ED_Ctx_Start(&OPENEPT_BENCH_CTX) != OPEN_EPT_STATUS_OK)
+    {
+        fprintf(stderr, "openept_bench: START failed\n");
+        return 1;
+    }
+    //Dictionary and timebase sent after START may still wait in the batch, keep them out of the measurement
+    OpenEPT_ED_Ctx_Flush(&OPENEPT_BENCH_CTX);
+    return 0;
+}
+
+/*
+ * One throughput measurement: threads producers for the configured time in ring or thread mode.
+ */
+static int OpenEPT_Bench_Run(uint32_t threads)
+{
+    pthread_t drain;
+    uint64_t queued = 0;
+    uint64_t failed = 0;
+    uint64_t frames;
+    uint64_t startNs;
+    uint64_t elapsedNs;
+    uint32_t cnt;
+
+    if(OpenEPT_Bench_Begin(threads) != 0) return 1;
+    frames = OPENEPT_BENCH_SINK.frames;
+
+    pthread_barrier_init(&OPENEPT_BENCH_GO, NULL, threads + 1);
+    __atomic_store_n(&OPENEPT_BENCH_RUN, 1, __ATOMIC_RELEASE);
+    pthread_create(&drain, NULL, OpenEPT_Bench_Drain_Run, NULL);
+    for(cnt = 0; cnt < threads; cnt++)
+    {
+        pthread_create(&OPENEPT_BENCH_PRODUCERS[cnt].thread, NULL, OpenEPT_Bench_Producer_Run, &OPENEPT_BENCH_PRODUCERS[cnt]);
+    }
+    pthread_barrier_wait(&OPENEPT_BENCH_GO);
+    startNs = OpenEPT_Bench_NowNs();
+    usleep(OPENEPT_BENCH_CONF.durationMs * 1000u);
+    __atomic_store_n(&OPENEPT_BENCH_RUN, 0, __ATOMIC_RELEASE);
+    for(cnt = 0; cnt < threads; cnt++)
+    {
+        pthread_join(OPENEPT_BENCH_PRODUCERS[cnt].thread, NULL);
+        queued += OPENEPT_BENCH_PRODUCERS[cnt].queued;
+        failed += OPENEPT_BENCH_PRODUCERS[cnt].failed;
+    }
+    sem_post(&OPENEPT_BENCH_DRAIN);
+    pthread_join(drain, NULL);
+    //Whatever is still queued is part of the measurement
+    OpenEPT_ED_Ctx_Flush(&OPENEPT_BENCH_CTX);
+    elapsedNs = OpenEPT_Bench_NowNs() - startNs;
+    frames = OPENEPT_BENCH_SINK.frames - frames;
+    pthread_barrier_destroy(&OPENEPT_BENCH_GO);
+
+    printf("%-6s %7u %12.3f %12.3f %12llu %12llu\n", OPENEPT_BENCH_MODE_NAMES[OPENEPT_BENCH_CONF.mode], threads,
+           (double)(queued + failed) * 1000.0 / (double)elapsedNs, (double)queued * 1000.0 / (double)elapsedNs,
+           (unsigned long long)failed, (unsigned long long)frames);
+    return 0;
+}
+
+/*
+ * Drain cost of the timestamp merge: threads buffers filled round-robin by this thread, so
+ * consecutive timestamps are in different buffers, then merged and sent by one flush.
+ * Repeated for the configured time; only the flushes are timed.
+ */
+static int OpenEPT_Bench_Merge(uint32_t threads)
+{
+    uint64_t queued = 0;
+    uint64_t frames;
+    uint64_t startNs;
+    uint64_t drainNs = 0;
+    uint64_t endNs;
+    uint32_t slot;
+    uint32_t cnt;
+
+    if(OpenEPT_Bench_Begin(threads) != 0) return 1;
+    frames = OPENEPT_BENCH_SINK.frames;
+    for(cnt = 0; cnt < threads; cnt++) OpenEPT_ED_Ctx_AttachThread(&OPENEPT_BENCH_CTX, &OPENEPT_BENCH_PRODUCERS[cnt].buffer);
+    endNs = OpenEPT_Bench_NowNs() + (uint64_t)OPENEPT_BENCH_CONF.durationMs * 1000000ull;
+    while(OpenEPT_Bench_NowNs() < endNs)
+    {
+        for(slot = 0; slot < OPENEPT_CONF_THREAD_BUFFER_SLOTS; slot++)
+        {
+            for(cnt = 0; cnt < threads; cnt++)
+            {
+                OpenEPT_ED_Platform_SetThreadBuffer(&OPENEPT_BENCH_PRODUCERS[cnt].buffer);
+                if(OpenEPT_ED_Ctx_SetEP(&OPENEPT_BENCH_CTX, OPENEPT_BENCH_PRODUCERS[cnt].epId) == OPEN_EPT_STATUS_OK) queued++;
+            }
+        }
+        startNs = OpenEPT_Bench_NowNs();
+        OpenEPT_ED_Ctx_Flush(&OPENEPT_BENCH_CTX);
+        drainNs += OpenEPT_Bench_NowNs() - startNs;
+    }
+    OpenEPT_ED_Platform_SetThreadBuffer(NULL);
+    frames = OPENEPT_BENCH_SINK.frames - frames;
+
+    printf("%-6s %7u %12s %12.3f %12llu %12llu %8.1f ns/event\n", OPENEPT_BENCH_MODE_NAMES[OPENEPT_BENCH_CONF.mode], threads, "-",
+           (double)queued * 1000.0 / (double)drainNs, (unsigned long long)OpenEPT_ED_Ctx_GetDropped(&OPENEPT_BENCH_CTX),
+           (unsigned long long)frames, (double)drainNs / (double)queued);
+    return 0;
+}
+
+static void OpenEPT_Bench_Usage(const char* name)
+{
+    fprintf(stderr,
+            "usage: %s [options]\n"
+            "  -m mode       ring, thread, merge or all (default all)\n"
+            "  -t threads    run 1..threads producers (default 16, at most %u)\n"
+            "  -d ms         duration of one run (default 1000)\n", name, (unsigned)OPENEPT_BENCH_THREADS_MAX);
+}
+
+int main(int argc, char** argv)
+{
+    const char* mode = "all";
+    uint32_t threads;
+    int option;
+    int status;
+    int pass;
+
+    OPENEPT_BENCH_CONF.threads = 16;
+    OPENEPT_BENCH_CONF.durationMs = 1000;
+    while((option = getopt(argc, argv, "m:t:d:h")) != -1)
+    {
+        switch(option)
+        {
+        case 'm': mode = optarg; break;
+        case 't': OPENEPT_BENCH_CONF.threads = (uint32_t)strtoul(optarg, NULL, 10); break;
+        case 'd': OPENEPT_BENCH_CONF.durationMs = (uint32_t)strtoul(optarg, NULL, 10); break;
+        default:
+            OpenEPT_Bench_Usage(argv[0]);
+            return 1;
+        }
+    }
+    if(OPENEPT_BENCH_CONF.threads == 0 || OPENEPT_BENCH_CONF.threads > OPENEPT_BENCH_THREADS_MAX ||
+       (strcmp(mode, "ring") != 0 && strcmp(mode, "thread") != 0 && strcmp(mode, "merge") != 0 && strcmp(mode, "all") != 0))
+    {
+        OpenEPT_Bench_Usage(argv[0]);
+        return 1;
+    }
+
+    //Merge mode requests drains too, nobody waits for them there
+    sem_init(&OPENEPT_BENCH_DRAIN, 0, 0);
+    printf("%-6s %7s %12s %12s %12s %12s\n", "mode", "threads", "Mcalls/s", "Mevents/s", "dropped", "frames");
+    for(pass = OPENEPT_BENCH_MODE_RING; pass <= OPENEPT_BENCH_MODE_MERGE; pass++)
+    {
+        OPENEPT_BENCH_CONF.mode = pass;
+        if(strcmp(mode, "all") != 0 && strcmp(mode, OPENEPT_BENCH_MODE_NAMES[pass]) != 0) continue;
+        for(threads = 1; threads <= OPENEPT_BENCH_CONF.threads; threads *= 2)
+        {
+            if(pass == OPENEPT_BENCH_MODE_MERGE) status = OpenEPT_Bench_Merge(threads);
+            else status = OpenEPT_Bench_Run(threads);
+            if(status != 0) return 1;
+        }
+    }
+    return 0;
+}
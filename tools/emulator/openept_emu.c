@@ -0,0 +1,1038 @@
+/**
+ * @file openept_emu.c
+ * @brief OpenEPT Acquisition device emulator.
+ *
+ * Accepts the EP link stream over a pty or UNIX socket, answers control commands like the
+ * Acquisition device and writes every frame and SYNC edge with a CLOCK_MONOTONIC timestamp
+ * to a capture log. Peer behaviour can be degraded (slow, lossy, absent) to exercise the
+ * handshake timeouts and retries of the library.
+ *
+ * Capture log has one line per event: "<ns> <kind> <payload>", where kind is CTRL, EP, INFO,
+ * SYNC (payload "<level> <DUT ns>"), RAW for ASCII data that is not a known frame and CORRUPT
+ * for binary frames that fail CRC check.
+ */
+#ifndef _DEFAULT_SOURCE
+#define _DEFAULT_SOURCE
+#endif
+#ifndef _XOPEN_SOURCE
+#define _XOPEN_SOURCE 600
+#endif
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include "../../feplib/protocol.h"
+
+#define OPENEPT_EMU_FRAME_SIZE      4096
+#define OPENEPT_EMU_SYNC_SIZE       256
+#define OPENEPT_EMU_DICTIONARY_SIZE 4096
+#define OPENEPT_EMU_REGION_DEPTH    64
+#define OPENEPT_EMU_TASK_TABLE_SIZE 256
+
+typedef enum
+{
+    OPENEPT_EMU_MODE_NORMAL,
+    OPENEPT_EMU_MODE_SLOW,          /* Responses are delayed and stream is read at limited rate */
+    OPENEPT_EMU_MODE_LOSSY,         /* Responses and received frames are dropped at random */
+    OPENEPT_EMU_MODE_ABSENT         /* Stream is captured but nothing is ever answered */
+}OpenEPT_Emu_Mode;
+
+typedef struct
+{
+    uint64_t    frames;
+    uint64_t    bytes;
+    uint64_t    eps;
+    uint64_t    infos;
+    uint64_t    syncs;
+    uint64_t    lost;
+    uint64_t    corrupt;
+    uint64_t    replies;
+    uint64_t    sessionStartNs;
+    uint64_t    sessionEps;
+    uint64_t    sessionMissing;    /* Events missing from sequence number gaps */
+    uint32_t    sessionDropped;    /* Frames DUT reported as dropped */
+}OpenEPT_Emu_Stats;
+
+typedef struct
+{
+    uint32_t    key;
+    char*       name;
+}OpenEPT_Emu_NameEntry;
+
+/* Key to name table loaded from "<hex key> <name>" lines */
+typedef struct
+{
+    OpenEPT_Emu_NameEntry*  entries;
+    uint32_t                count;
+}OpenEPT_Emu_NameTable;
+
+/* Task of current session, time in DUT ns when events are timestamped, otherwise arrival ns */
+typedef struct
+{
+    char*       name;
+    uint64_t    ns;            /* Time from its switches in to the next switch */
+}OpenEPT_Emu_Task;
+
+/* Open region, times in DUT ns when events are timestamped, otherwise arrival ns */
+typedef struct
+{
+    uint64_t    beginNs;
+    uint64_t    nestedNs;      /* Inclusive time of regions nested directly in it */
+}OpenEPT_Emu_Region;
+
+static struct
+{
+    OpenEPT_Emu_Mode    mode;
+    uint32_t            delayMs;
+    uint32_t            rateBps;
+    uint32_t            lossPercent;
+    uint32_t            negotiateBaud;
+    uint32_t            protocol;
+    const char*         ptyLink;
+    const char*         socketPath;
+    const char*         devicePath;
+    const char*         syncPath;
+    const char*         logPath;
+    const char*         hashPath;
+    const char*         offsetPath;
+}OPENEPT_EMU_CONF;
+
+static volatile sig_atomic_t    OPENEPT_EMU_RUN = 1;
+static FILE*                    OPENEPT_EMU_LOG;
+static OpenEPT_Emu_Stats        OPENEPT_EMU_STATS;
+
+/* Frame assembled from the link stream */
+static char                     OPENEPT_EMU_FRAME[OPENEPT_EMU_FRAME_SIZE];
+static uint32_t                 OPENEPT_EMU_FRAME_USED;
+static uint64_t                 OPENEPT_EMU_FRAME_START_NS;
+
+/* Binary record payload joined from continued parts */
+static char                     OPENEPT_EMU_RECORD[OPENEPT_EMU_FRAME_SIZE];
+static uint32_t                 OPENEPT_EMU_RECORD_USED;
+
+/* Response waiting for its delay to pass */
+static char                     OPENEPT_EMU_REPLY[64];
+static uint32_t                 OPENEPT_EMU_REPLY_SIZE;
+static uint64_t                 OPENEPT_EMU_REPLY_DUE_NS;
+static int                      OPENEPT_EMU_REPLY_STAMP;  /* Send time is appended when reply is written (PONG) */
+
+/* EP names defined by DUT in current session, index is EP ID */
+static char*                    OPENEPT_EMU_DICTIONARY[OPENEPT_EMU_DICTIONARY_SIZE];
+
+/* DUT timebase of current session and timestamp of the next event, 0 when events are not timestamped */
+static uint32_t                 OPENEPT_EMU_TIMEBASE;
+static uint64_t                 OPENEPT_EMU_EVENT_TIME;
+static int                      OPENEPT_EMU_EVENT_TIME_VALID;
+
+/* Open regions of current session, index is nesting depth */
+static OpenEPT_Emu_Region       OPENEPT_EMU_REGIONS[OPENEPT_EMU_REGION_DEPTH];
+static uint32_t                 OPENEPT_EMU_REGION_DEPTH_USED;
+
+/* Tasks defined by DUT in current session, index is task ID, and the task switched in last */
+static OpenEPT_Emu_Task         OPENEPT_EMU_TASKS[OPENEPT_EMU_TASK_TABLE_SIZE];
+static uint32_t                 OPENEPT_EMU_TASK_CURRENT;
+static uint64_t                 OPENEPT_EMU_TASK_SINCE_NS;
+static int                      OPENEPT_EMU_TASK_VALID;
+
+/* Sequence number expected for the next event of current session */
+static uint32_t                 OPENEPT_EMU_SEQUENCE;
+static int                      OPENEPT_EMU_SEQUENCE_VALID;
+
+/* EP names by hash (openept_ephash table) and by section offset (openept_epelf table) */
+static OpenEPT_Emu_NameTable    OPENEPT_EMU_HASHES;
+static OpenEPT_Emu_NameTable    OPENEPT_EMU_OFFSETS;
+
+/* Partial SYNC side channel line */
+static char                     OPENEPT_EMU_SYNC[OPENEPT_EMU_SYNC_SIZE];
+static uint32_t                 OPENEPT_EMU_SYNC_USED;
+
+
+static uint64_t OpenEPT_Emu_NowNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static void OpenEPT_Emu_Stop(int signal)
+{
+    (void)signal;
+    OPENEPT_EMU_RUN = 0;
+}
+
+static int OpenEPT_Emu_Lose()
+{
+    if(OPENEPT_EMU_CONF.mode != OPENEPT_EMU_MODE_LOSSY) return 0;
+    return (uint32_t)(rand() % 100) < OPENEPT_EMU_CONF.lossPercent;
+}
+
+static void OpenEPT_Emu_SetRaw(int fd)
+{
+    struct termios tio;
+    if(tcgetattr(fd, &tio) != 0) return;
+    cfmakeraw(&tio);
+    tcsetattr(fd, TCSANOW, &tio);
+}
+
+/*
+ * Queue response, it is written once configured delay passes.
+ */
+static void OpenEPT_Emu_Reply(const char* reply)
+{
+    if(OPENEPT_EMU_CONF.mode == OPENEPT_EMU_MODE_ABSENT) return;
+    if(OpenEPT_Emu_Lose())
+    {
+        OPENEPT_EMU_STATS.lost++;
+        return;
+    }
+    OPENEPT_EMU_REPLY_SIZE = (uint32_t)snprintf(OPENEPT_EMU_REPLY, sizeof(OPENEPT_EMU_REPLY), "%s", reply);
+    OPENEPT_EMU_REPLY_STAMP = 0;
+    OPENEPT_EMU_REPLY_DUE_NS = OpenEPT_Emu_NowNs();
+    if(OPENEPT_EMU_CONF.mode == OPENEPT_EMU_MODE_SLOW) OPENEPT_EMU_REPLY_DUE_NS += (uint64_t)OPENEPT_EMU_CONF.delayMs * 1000000ull;
+}
+
+static void OpenEPT_Emu_ReplyFlush(int fd)
+{
+    if(OPENEPT_EMU_REPLY_SIZE == 0) return;
+    if(OpenEPT_Emu_NowNs() < OPENEPT_EMU_REPLY_DUE_NS) return;
+    if(OPENEPT_EMU_REPLY_STAMP)
+    {
+        OPENEPT_EMU_REPLY_SIZE += (uint32_t)snprintf(&OPENEPT_EMU_REPLY[OPENEPT_EMU_REPLY_SIZE], sizeof(OPENEPT_EMU_REPLY) - OPENEPT_EMU_REPLY_SIZE,
+                                                     " %llu\r", (unsigned long long)OpenEPT_Emu_NowNs());
+    }
+    if(write(fd, OPENEPT_EMU_REPLY, OPENEPT_EMU_REPLY_SIZE) == (ssize_t)OPENEPT_EMU_REPLY_SIZE) OPENEPT_EMU_STATS.replies++;
+    OPENEPT_EMU_REPLY_SIZE = 0;
+}
+
+/*
+ * Select highest rate offered in "START BAUD=<rate>,<rate>..." that does not exceed configured limit.
+ */
+static uint32_t OpenEPT_Emu_SelectBaud(const char* offer)
+{
+    uint32_t selected = 0;
+    unsigned long rate;
+    char* end;
+
+    offer = strstr(offer, "BAUD=");
+    if(offer == NULL) return 0;
+    offer += 5;
+    while(*offer != '\0')
+    {
+        rate = strtoul(offer, &end, 10);
+        if(end == offer) break;
+        if(rate <= OPENEPT_EMU_CONF.negotiateBaud && rate > selected) selected = (uint32_t)rate;
+        offer = (*end == ',') ? end + 1 : end;
+    }
+    return selected;
+}
+
+static void OpenEPT_Emu_DictionaryClear()
+{
+    uint32_t cnt;
+    for(cnt = 0; cnt < OPENEPT_EMU_DICTIONARY_SIZE; cnt++)
+    {
+        free(OPENEPT_EMU_DICTIONARY[cnt]);
+        OPENEPT_EMU_DICTIONARY[cnt] = NULL;
+    }
+    for(cnt = 0; cnt < OPENEPT_EMU_TASK_TABLE_SIZE; cnt++)
+    {
+        free(OPENEPT_EMU_TASKS[cnt].name);
+        OPENEPT_EMU_TASKS[cnt].name = NULL;
+        OPENEPT_EMU_TASKS[cnt].ns = 0;
+    }
+    OPENEPT_EMU_TASK_VALID = 0;
+}
+
+static int OpenEPT_Emu_TableLoad(OpenEPT_Emu_NameTable* table, const char* path)
+{
+    FILE* input = fopen(path, "r");
+    char line[512];
+    char* end;
+    uint32_t capacity = 0;
+    uint32_t key;
+
+    if(input == NULL) return -1;
+    while(fgets(line, sizeof(line), input) != NULL)
+    {
+        key = (uint32_t)strtoul(line, &end, 16);
+        if(end == line || *end != ' ') continue;
+        end[strcspn(end, "\r\n")] = '\0';
+        if(table->count == capacity)
+        {
+            capacity = capacity ? capacity * 2 : 64;
+            table->entries = realloc(table->entries, capacity * sizeof(OpenEPT_Emu_NameEntry));
+            if(table->entries == NULL) exit(1);
+        }
+        table->entries[table->count].key = key;
+        table->entries[table->count].name = strdup(end + 1);
+        table->count++;
+    }
+    fclose(input);
+    return 0;
+}
+
+static const char* OpenEPT_Emu_TableLookup(const OpenEPT_Emu_NameTable* table, uint32_t key)
+{
+    uint32_t cnt;
+    for(cnt = 0; cnt < table->count; cnt++)
+    {
+        if(table->entries[cnt].key == key) return table->entries[cnt].name;
+    }
+    return NULL;
+}
+
+static void OpenEPT_Emu_Control(const char* command)
+{
+    char reply[64];
+    const char* offer;
+    uint32_t baudrate;
+    uint32_t protocol = 0;
+    uint32_t cnt;
+    int size;
+
+    if(strncmp(command, "START", 5) == 0)
+    {
+        OPENEPT_EMU_STATS.sessionStartNs = OPENEPT_EMU_FRAME_START_NS;
+        OPENEPT_EMU_STATS.sessionEps = 0;
+        OPENEPT_EMU_STATS.sessionMissing = 0;
+        OPENEPT_EMU_STATS.sessionDropped = 0;
+        //First event of a session has sequence 0, events dropped before it are a gap too
+        OPENEPT_EMU_SEQUENCE = 0;
+        OPENEPT_EMU_SEQUENCE_VALID = 1;
+        OPENEPT_EMU_REGION_DEPTH_USED = 0;
+        OPENEPT_EMU_RECORD_USED = 0;
+        OPENEPT_EMU_TIMEBASE = 0;
+        OPENEPT_EMU_EVENT_TIME_VALID = 0;
+        OpenEPT_Emu_DictionaryClear();
+        baudrate = OPENEPT_EMU_CONF.negotiateBaud != 0 ? OpenEPT_Emu_SelectBaud(command) : 0;
+        offer = strstr(command, "PROTO=");
+        if(offer != NULL) protocol = (uint32_t)strtoul(offer + 6, NULL, 10);
+        if(protocol > OPENEPT_EMU_CONF.protocol) protocol = OPENEPT_EMU_CONF.protocol;
+        size = snprintf(reply, sizeof(reply), "OK");
+        //Link rate is not emulated; a pty or socket carries data at any rate
+        if(baudrate != 0) size += snprintf(&reply[size], sizeof(reply) - (size_t)size, " BAUD=%u", baudrate);
+        if(protocol != 0) size += snprintf(&reply[size], sizeof(reply) - (size_t)size, " PROTO=%u", protocol);
+        snprintf(&reply[size], sizeof(reply) - (size_t)size, "\r");
+        OpenEPT_Emu_Reply(reply);
+    }
+    else if(strcmp(command, "STOP") == 0)
+    {
+        uint64_t duration = OPENEPT_EMU_FRAME_START_NS - OPENEPT_EMU_STATS.sessionStartNs;
+        fprintf(OPENEPT_EMU_LOG, "%llu SESSION eps=%llu duration_ns=%llu missing=%llu dropped=%u\n",
+                (unsigned long long)OPENEPT_EMU_FRAME_START_NS,
+                (unsigned long long)OPENEPT_EMU_STATS.sessionEps,
+                (unsigned long long)duration,
+                (unsigned long long)OPENEPT_EMU_STATS.sessionMissing,
+                OPENEPT_EMU_STATS.sessionDropped);
+        //Time of the task running at STOP is not known, it has no switch after it
+        for(cnt = 0; cnt < OPENEPT_EMU_TASK_TABLE_SIZE; cnt++)
+        {
+            if(OPENEPT_EMU_TASKS[cnt].ns == 0) continue;
+            fprintf(OPENEPT_EMU_LOG, "%llu TASKTIME %s ns=%llu\n", (unsigned long long)OPENEPT_EMU_FRAME_START_NS,
+                    OPENEPT_EMU_TASKS[cnt].name != NULL ? OPENEPT_EMU_TASKS[cnt].name : "?", (unsigned long long)OPENEPT_EMU_TASKS[cnt].ns);
+        }
+        OpenEPT_Emu_Reply("OK\r");
+    }
+    else if(strcmp(command, "BAUD") == 0)
+    {
+        OpenEPT_Emu_Reply("OK\r");
+    }
+    else
+    {
+        OpenEPT_Emu_Reply("ERROR\r");
+    }
+}
+
+static const char* OpenEPT_Emu_Kind(uint8_t type)
+{
+    switch(type)
+    {
+    case OPENEPT_ED_RECORD_CONTROL: return "CTRL";
+    case OPENEPT_ED_RECORD_EP_NAME: return "EP";
+    case OPENEPT_ED_RECORD_INFO:    return "INFO";
+    case OPENEPT_ED_RECORD_REGION_BEGIN: return "BEGIN";
+    case OPENEPT_ED_RECORD_REGION_END:   return "END";
+    case OPENEPT_ED_RECORD_TASK:         return "TASK";
+    default:                        return NULL;
+    }
+}
+
+/*
+ * Convert DUT timestamp to ns, split so that the product can not overflow.
+ */
+static uint64_t OpenEPT_Emu_DutNs(uint64_t timestamp)
+{
+    return timestamp / OPENEPT_EMU_TIMEBASE * 1000000000ull + timestamp % OPENEPT_EMU_TIMEBASE * 1000000000ull / OPENEPT_EMU_TIMEBASE;
+}
+
+/*
+ * Log one event and act on control commands.
+ */
+static void OpenEPT_Emu_Event(uint8_t type, const char* payload)
+{
+    const char* kind = OpenEPT_Emu_Kind(type);
+
+    if(kind == NULL)
+    {
+        fprintf(OPENEPT_EMU_LOG, "%llu RAW type=%u %s\n", (unsigned long long)OPENEPT_EMU_FRAME_START_NS, type, payload);
+        return;
+    }
+    if(type == OPENEPT_ED_RECORD_EP_NAME || type == OPENEPT_ED_RECORD_REGION_BEGIN)
+    {
+        OPENEPT_EMU_STATS.eps++;
+        OPENEPT_EMU_STATS.sessionEps++;
+    }
+    if(type == OPENEPT_ED_RECORD_INFO) OPENEPT_EMU_STATS.infos++;
+    if(OPENEPT_EMU_EVENT_TIME_VALID && OPENEPT_EMU_TIMEBASE != 0)
+    {
+        fprintf(OPENEPT_EMU_LOG, "%llu %s %s @%llu\n", (unsigned long long)OPENEPT_EMU_FRAME_START_NS, kind, payload,
+                (unsigned long long)OpenEPT_Emu_DutNs(OPENEPT_EMU_EVENT_TIME));
+        OPENEPT_EMU_EVENT_TIME_VALID = 0;
+    }
+    else
+    {
+        fprintf(OPENEPT_EMU_LOG, "%llu %s %s\n", (unsigned long long)OPENEPT_EMU_FRAME_START_NS, kind, payload);
+    }
+    if(type == OPENEPT_ED_RECORD_CONTROL) OpenEPT_Emu_Control(payload);
+}
+
+/*
+ * Log energy point from lookup table, unknown keys are logged with the format.
+ */
+static void OpenEPT_Emu_TableEvent(const OpenEPT_Emu_NameTable* table, uint32_t key, const char* format)
+{
+    const char* known = OpenEPT_Emu_TableLookup(table, key);
+    char name[16];
+
+    if(known == NULL)
+    {
+        snprintf(name, sizeof(name), format, key);
+        known = name;
+    }
+    OpenEPT_Emu_Event(OPENEPT_ED_RECORD_EP_NAME, known);
+}
+
+/*
+ * Answer clock ping with "PONG <DUT timestamp> <receive ns> <send ns>", send time is taken
+ * when the answer is written, so reply delay does not count as link time.
+ */
+static void OpenEPT_Emu_Pong(uint64_t pingTime)
+{
+    char reply[64];
+
+    snprintf(reply, sizeof(reply), "PONG %llu %llu", (unsigned long long)pingTime, (unsigned long long)OPENEPT_EMU_FRAME_START_NS);
+    OpenEPT_Emu_Reply(reply);
+    OPENEPT_EMU_REPLY_STAMP = OPENEPT_EMU_REPLY_SIZE != 0;
+}
+
+/*
+ * Log clock estimate record "<varint DUT timestamp><zigzag offset ns><varint rtt ns><zigzag drift ppb>".
+ */
+static void OpenEPT_Emu_Clock(const uint8_t* record, uint32_t size)
+{
+    uint64_t timestamp;
+    int64_t offset;
+    int64_t drift;
+    uint32_t rtt;
+    uint32_t used;
+    uint32_t part;
+
+    used = OpenEPT_ED_Protocol_GetVarint64(record, size, &timestamp);
+    if(used == 0) return;
+    part = OpenEPT_ED_Protocol_GetZigzag64(&record[used], size - used, &offset);
+    if(part == 0) return;
+    used += part;
+    part = OpenEPT_ED_Protocol_GetVarint(&record[used], size - used, &rtt);
+    if(part == 0) return;
+    used += part;
+    if(OpenEPT_ED_Protocol_GetZigzag64(&record[used], size - used, &drift) == 0) return;
+    fprintf(OPENEPT_EMU_LOG, "%llu CLOCK offset_ns=%lld rtt_ns=%u drift_ppb=%lld", (unsigned long long)OPENEPT_EMU_FRAME_START_NS,
+            (long long)offset, rtt, (long long)drift);
+    if(OPENEPT_EMU_TIMEBASE != 0) fprintf(OPENEPT_EMU_LOG, " @%llu", (unsigned long long)OpenEPT_Emu_DutNs(timestamp));
+    fprintf(OPENEPT_EMU_LOG, "\n");
+}
+
+/*
+ * Log region begin or end. Ends carry inclusive time and exclusive time, the latter without
+ * regions nested in it; they are left out when events around the region were lost.
+ */
+static void OpenEPT_Emu_RegionEvent(uint8_t type, uint32_t depth, const char* name)
+{
+    uint64_t now = OPENEPT_EMU_EVENT_TIME_VALID && OPENEPT_EMU_TIMEBASE != 0 ? OpenEPT_Emu_DutNs(OPENEPT_EMU_EVENT_TIME) : OPENEPT_EMU_FRAME_START_NS;
+    char text[OPENEPT_EMU_FRAME_SIZE];
+    uint64_t inclusive;
+
+    snprintf(text, sizeof(text), "%u %s", depth, name);
+    if(type == OPENEPT_ED_RECORD_REGION_BEGIN)
+    {
+        //Regions deeper than a lost end are dropped, depth from DUT is authoritative
+        if(depth < OPENEPT_EMU_REGION_DEPTH)
+        {
+            OPENEPT_EMU_REGIONS[depth].beginNs = now;
+            OPENEPT_EMU_REGIONS[depth].nestedNs = 0;
+        }
+        OPENEPT_EMU_REGION_DEPTH_USED = depth + 1;
+    }
+    else
+    {
+        if(depth + 1 == OPENEPT_EMU_REGION_DEPTH_USED && depth < OPENEPT_EMU_REGION_DEPTH)
+        {
+            inclusive = now - OPENEPT_EMU_REGIONS[depth].beginNs;
+            snprintf(&text[strlen(text)], sizeof(text) - strlen(text), " inclusive_ns=%llu exclusive_ns=%llu",
+                     (unsigned long long)inclusive, (unsigned long long)(inclusive - OPENEPT_EMU_REGIONS[depth].nestedNs));
+            if(depth > 0) OPENEPT_EMU_REGIONS[depth - 1].nestedNs += inclusive;
+        }
+        OPENEPT_EMU_REGION_DEPTH_USED = depth;
+    }
+    OpenEPT_Emu_Event(type, text);
+}
+
+/*
+ * ASCII region marks are EP name frames with a prefix and carry no depth, it follows from
+ * the marks seen so far.
+ */
+static void OpenEPT_Emu_AsciiFrame()
+{
+    const char* payload = &OPENEPT_EMU_FRAME[2];
+    uint8_t type = (uint8_t)(OPENEPT_EMU_FRAME[0] - '0');
+
+    OPENEPT_EMU_FRAME[OPENEPT_EMU_FRAME_USED] = '\0';
+    if(type == OPENEPT_ED_RECORD_EP_NAME && strncmp(payload, OPENEPT_ED_ASCII_REGION_BEGIN, strlen(OPENEPT_ED_ASCII_REGION_BEGIN)) == 0)
+    {
+        OpenEPT_Emu_RegionEvent(OPENEPT_ED_RECORD_REGION_BEGIN, OPENEPT_EMU_REGION_DEPTH_USED, payload + strlen(OPENEPT_ED_ASCII_REGION_BEGIN));
+        return;
+    }
+    if(type == OPENEPT_ED_RECORD_EP_NAME && OPENEPT_EMU_REGION_DEPTH_USED != 0 &&
+       strncmp(payload, OPENEPT_ED_ASCII_REGION_END, strlen(OPENEPT_ED_ASCII_REGION_END)) == 0)
+    {
+        OpenEPT_Emu_RegionEvent(OPENEPT_ED_RECORD_REGION_END, OPENEPT_EMU_REGION_DEPTH_USED - 1, payload + strlen(OPENEPT_ED_ASCII_REGION_END));
+        return;
+    }
+    OpenEPT_Emu_Event(type, payload);
+}
+
+/*
+ * Log task switch and add the time since the previous switch to the task it switched in.
+ */
+static void OpenEPT_Emu_TaskEvent(uint32_t id)
+{
+    uint64_t now = OPENEPT_EMU_EVENT_TIME_VALID && OPENEPT_EMU_TIMEBASE != 0 ? OpenEPT_Emu_DutNs(OPENEPT_EMU_EVENT_TIME) : OPENEPT_EMU_FRAME_START_NS;
+    const char* name = id < OPENEPT_EMU_TASK_TABLE_SIZE ? OPENEPT_EMU_TASKS[id].name : NULL;
+    char unknown[16];
+
+    if(OPENEPT_EMU_TASK_VALID && now >= OPENEPT_EMU_TASK_SINCE_NS && OPENEPT_EMU_TASK_CURRENT < OPENEPT_EMU_TASK_TABLE_SIZE)
+    {
+        OPENEPT_EMU_TASKS[OPENEPT_EMU_TASK_CURRENT].ns += now - OPENEPT_EMU_TASK_SINCE_NS;
+    }
+    OPENEPT_EMU_TASK_CURRENT = id;
+    OPENEPT_EMU_TASK_SINCE_NS = now;
+    OPENEPT_EMU_TASK_VALID = 1;
+    if(name == NULL)
+    {
+        snprintf(unknown, sizeof(unknown), "#%u", id);
+        name = unknown;
+    }
+    OpenEPT_Emu_Event(OPENEPT_ED_RECORD_TASK, name);
+}
+
+/*
+ * Collect binary record payload, parts marked as continued are joined with the next one.
+ */
+static void OpenEPT_Emu_Record(uint8_t type, const uint8_t* payload, uint32_t size)
+{
+    char text[OPENEPT_EMU_FRAME_SIZE];
+    const char* format;
+    char name[16];
+    uint64_t time;
+    uint32_t depth;
+    uint32_t used;
+    uint32_t id;
+
+    if(size > OPENEPT_EMU_FRAME_SIZE - 1 - OPENEPT_EMU_RECORD_USED) size = OPENEPT_EMU_FRAME_SIZE - 1 - OPENEPT_EMU_RECORD_USED;
+    memcpy(&OPENEPT_EMU_RECORD[OPENEPT_EMU_RECORD_USED], payload, size);
+    OPENEPT_EMU_RECORD_USED += size;
+    if(type & OPENEPT_ED_RECORD_CONTINUED) return;
+
+    size = OPENEPT_EMU_RECORD_USED;
+    OPENEPT_EMU_RECORD[size] = '\0';
+    OPENEPT_EMU_RECORD_USED = 0;
+    switch(type)
+    {
+    case OPENEPT_ED_RECORD_CONTROL:
+        OpenEPT_Emu_Event(type, OPENEPT_EMU_RECORD[0] == OPENEPT_ED_CONTROL_STOP ? "STOP" : "UNKNOWN");
+        break;
+    case OPENEPT_ED_RECORD_EP_DEFINE:
+        used = OpenEPT_ED_Protocol_GetVarint((uint8_t*)OPENEPT_EMU_RECORD, size, &id);
+        if(used == 0 || id >= OPENEPT_EMU_DICTIONARY_SIZE) break;
+        free(OPENEPT_EMU_DICTIONARY[id]);
+        OPENEPT_EMU_DICTIONARY[id] = strdup(&OPENEPT_EMU_RECORD[used]);
+        fprintf(OPENEPT_EMU_LOG, "%llu DEFINE %u %s\n", (unsigned long long)OPENEPT_EMU_FRAME_START_NS, id, OPENEPT_EMU_DICTIONARY[id]);
+        break;
+    case OPENEPT_ED_RECORD_EP_ID:
+        //Expanded to the name, so capture log looks the same as with name records
+        used = OpenEPT_ED_Protocol_GetVarint((uint8_t*)OPENEPT_EMU_RECORD, size, &id);
+        if(used == 0) break;
+        if(id < OPENEPT_EMU_DICTIONARY_SIZE && OPENEPT_EMU_DICTIONARY[id] != NULL)
+        {
+            OpenEPT_Emu_Event(OPENEPT_ED_RECORD_EP_NAME, OPENEPT_EMU_DICTIONARY[id]);
+        }
+        else
+        {
+            snprintf(name, sizeof(name), "#%u", id);
+            OpenEPT_Emu_Event(OPENEPT_ED_RECORD_EP_NAME, name);
+        }
+        break;
+    case OPENEPT_ED_RECORD_EP_HASH:
+        if(size != 4) break;
+        id = (uint32_t)(uint8_t)OPENEPT_EMU_RECORD[0] | (uint32_t)(uint8_t)OPENEPT_EMU_RECORD[1] << 8 |
+             (uint32_t)(uint8_t)OPENEPT_EMU_RECORD[2] << 16 | (uint32_t)(uint8_t)OPENEPT_EMU_RECORD[3] << 24;
+        OpenEPT_Emu_TableEvent(&OPENEPT_EMU_HASHES, id, "#0x%08x");
+        break;
+    case OPENEPT_ED_RECORD_EP_FORMAT:
+        //Formatted here from the hash table format, so capture log looks the same as with name records
+        if(size < 4) break;
+        id = (uint32_t)(uint8_t)OPENEPT_EMU_RECORD[0] | (uint32_t)(uint8_t)OPENEPT_EMU_RECORD[1] << 8 |
+             (uint32_t)(uint8_t)OPENEPT_EMU_RECORD[2] << 16 | (uint32_t)(uint8_t)OPENEPT_EMU_RECORD[3] << 24;
+        format = OpenEPT_Emu_TableLookup(&OPENEPT_EMU_HASHES, id);
+        if(format == NULL)
+        {
+            OpenEPT_Emu_TableEvent(&OPENEPT_EMU_HASHES, id, "#0x%08x");
+            break;
+        }
+        OpenEPT_ED_Protocol_FormatArgs(text, sizeof(text), format, (uint8_t*)&OPENEPT_EMU_RECORD[4], size - 4);
+        OpenEPT_Emu_Event(OPENEPT_ED_RECORD_EP_NAME, text);
+        break;
+    case OPENEPT_ED_RECORD_REGION_BEGIN:
+    case OPENEPT_ED_RECORD_REGION_END:
+        used = OpenEPT_ED_Protocol_GetVarint((uint8_t*)OPENEPT_EMU_RECORD, size, &depth);
+        if(used == 0 || OpenEPT_ED_Protocol_GetVarint((uint8_t*)&OPENEPT_EMU_RECORD[used], size - used, &id) == 0) break;
+        if(id < OPENEPT_EMU_DICTIONARY_SIZE && OPENEPT_EMU_DICTIONARY[id] != NULL)
+        {
+            OpenEPT_Emu_RegionEvent(type, depth, OPENEPT_EMU_DICTIONARY[id]);
+            break;
+        }
+        snprintf(text, sizeof(text), "#%u", id);
+        OpenEPT_Emu_RegionEvent(type, depth, text);
+        break;
+    case OPENEPT_ED_RECORD_TASK_DEFINE:
+        used = OpenEPT_ED_Protocol_GetVarint((uint8_t*)OPENEPT_EMU_RECORD, size, &id);
+        if(used == 0 || id >= OPENEPT_EMU_TASK_TABLE_SIZE) break;
+        free(OPENEPT_EMU_TASKS[id].name);
+        OPENEPT_EMU_TASKS[id].name = strdup(&OPENEPT_EMU_RECORD[used]);
+        fprintf(OPENEPT_EMU_LOG, "%llu TASKDEF %u %s\n", (unsigned long long)OPENEPT_EMU_FRAME_START_NS, id, OPENEPT_EMU_TASKS[id].name);
+        break;
+    case OPENEPT_ED_RECORD_TASK:
+        if(OpenEPT_ED_Protocol_GetVarint((uint8_t*)OPENEPT_EMU_RECORD, size, &id) == 0) break;
+        OpenEPT_Emu_TaskEvent(id);
+        break;
+    case OPENEPT_ED_RECORD_PING:
+        if(OpenEPT_ED_Protocol_GetVarint64((uint8_t*)OPENEPT_EMU_RECORD, size, &time) == 0) break;
+        OpenEPT_Emu_Pong(time);
+        break;
+    case OPENEPT_ED_RECORD_CLOCK:
+        OpenEPT_Emu_Clock((uint8_t*)OPENEPT_EMU_RECORD, size);
+        break;
+    case OPENEPT_ED_RECORD_TIMEBASE:
+        if(OpenEPT_ED_Protocol_GetVarint((uint8_t*)OPENEPT_EMU_RECORD, size, &id) == 0) break;
+        OPENEPT_EMU_TIMEBASE = id;
+        fprintf(OPENEPT_EMU_LOG, "%llu TIMEBASE %u\n", (unsigned long long)OPENEPT_EMU_FRAME_START_NS, id);
+        break;
+    case OPENEPT_ED_RECORD_TIMESTAMP:
+        //Applies to the event record that follows
+        OPENEPT_EMU_EVENT_TIME_VALID = OpenEPT_ED_Protocol_GetVarint64((uint8_t*)OPENEPT_EMU_RECORD, size, &OPENEPT_EMU_EVENT_TIME) != 0;
+        break;
+    case OPENEPT_ED_RECORD_SEQUENCE:
+        if(OpenEPT_ED_Protocol_GetVarint((uint8_t*)OPENEPT_EMU_RECORD, size, &id) == 0) break;
+        //Events between the last received one and this one are lost, energy in that region is not attributed
+        if(OPENEPT_EMU_SEQUENCE_VALID && id != OPENEPT_EMU_SEQUENCE)
+        {
+            fprintf(OPENEPT_EMU_LOG, "%llu GAP events=%u first=%u\n", (unsigned long long)OPENEPT_EMU_FRAME_START_NS,
+                    id - OPENEPT_EMU_SEQUENCE, OPENEPT_EMU_SEQUENCE);
+            OPENEPT_EMU_STATS.sessionMissing += id - OPENEPT_EMU_SEQUENCE;
+        }
+        OPENEPT_EMU_SEQUENCE = id + 1;
+        OPENEPT_EMU_SEQUENCE_VALID = 1;
+        break;
+    case OPENEPT_ED_RECORD_DROPPED:
+        if(OpenEPT_ED_Protocol_GetVarint((uint8_t*)OPENEPT_EMU_RECORD, size, &id) == 0) break;
+        //Count is repeated before STOP, log only changes
+        if(id == OPENEPT_EMU_STATS.sessionDropped) break;
+        OPENEPT_EMU_STATS.sessionDropped = id;
+        fprintf(OPENEPT_EMU_LOG, "%llu DROPPED frames=%u\n", (unsigned long long)OPENEPT_EMU_FRAME_START_NS, id);
+        break;
+    case OPENEPT_ED_RECORD_EP_OFFSET:
+        if(OpenEPT_ED_Protocol_GetVarint((uint8_t*)OPENEPT_EMU_RECORD, size, &id) == 0) break;
+        OpenEPT_Emu_TableEvent(&OPENEPT_EMU_OFFSETS, id, "@%u");
+        break;
+    default:
+        OpenEPT_Emu_Event(type, OPENEPT_EMU_RECORD);
+        break;
+    }
+}
+
+static void OpenEPT_Emu_BinaryFrame()
+{
+    uint8_t* frame = (uint8_t*)OPENEPT_EMU_FRAME;
+    uint32_t size = OpenEPT_ED_Protocol_CobsDecode(frame, OPENEPT_EMU_FRAME_USED);
+    uint32_t pos = 0;
+    uint32_t length;
+    uint32_t used;
+    uint8_t type;
+
+    if(size < 3 || OpenEPT_ED_Protocol_Crc16(0xFFFF, frame, size - 2) != (uint16_t)(frame[size - 2] | (frame[size - 1] << 8)))
+    {
+        //Frame is dropped as a whole, receiver is in sync again from the next delimiter
+        OPENEPT_EMU_STATS.corrupt++;
+        OPENEPT_EMU_RECORD_USED = 0;
+        fprintf(OPENEPT_EMU_LOG, "%llu CORRUPT %u\n", (unsigned long long)OPENEPT_EMU_FRAME_START_NS, OPENEPT_EMU_FRAME_USED);
+        return;
+    }
+    size -= 2;
+    while(pos < size)
+    {
+        type = frame[pos++];
+        used = OpenEPT_ED_Protocol_GetVarint(&frame[pos], size - pos, &length);
+        if(used == 0 || length > size - pos - used)
+        {
+            OPENEPT_EMU_STATS.corrupt++;
+            return;
+        }
+        pos += used;
+        OpenEPT_Emu_Record(type, &frame[pos], length);
+        pos += length;
+    }
+}
+
+static void OpenEPT_Emu_Frame(int binary)
+{
+    OPENEPT_EMU_STATS.frames++;
+    if(OpenEPT_Emu_Lose())
+    {
+        OPENEPT_EMU_STATS.lost++;
+        return;
+    }
+    if(binary) OpenEPT_Emu_BinaryFrame();
+    else OpenEPT_Emu_AsciiFrame();
+}
+
+/*
+ * ASCII frames start with "<digit>:" and end with '\r'. Anything else is a COBS frame that
+ * ends with 0x00; binary record types never equal ':' so the two can not be confused.
+ */
+static void OpenEPT_Emu_Receive(const char* data, ssize_t size, uint64_t now)
+{
+    ssize_t cnt;
+
+    OPENEPT_EMU_STATS.bytes += (uint64_t)size;
+    for(cnt = 0; cnt < size; cnt++)
+    {
+        //Frame is timestamped with arrival of its first byte
+        if(OPENEPT_EMU_FRAME_USED == 0) OPENEPT_EMU_FRAME_START_NS = now;
+        if(data[cnt] == '\0')
+        {
+            if(OPENEPT_EMU_FRAME_USED != 0) OpenEPT_Emu_Frame(1);
+            OPENEPT_EMU_FRAME_USED = 0;
+            continue;
+        }
+        if(data[cnt] == '\r' && OPENEPT_EMU_FRAME_USED >= 2 && OPENEPT_EMU_FRAME[1] == ':' &&
+           OPENEPT_EMU_FRAME[0] >= '0' && OPENEPT_EMU_FRAME[0] <= '9')
+        {
+            OpenEPT_Emu_Frame(0);
+            OPENEPT_EMU_FRAME_USED = 0;
+            continue;
+        }
+        if(OPENEPT_EMU_FRAME_USED < OPENEPT_EMU_FRAME_SIZE - 1) OPENEPT_EMU_FRAME[OPENEPT_EMU_FRAME_USED++] = data[cnt];
+    }
+}
+
+/*
+ * SYNC side channel carries "<DUT ns> <level>" lines written by the POSIX port.
+ */
+static void OpenEPT_Emu_SyncReceive(const char* data, ssize_t size, uint64_t now)
+{
+    unsigned long long dutNs;
+    unsigned level;
+    ssize_t cnt;
+
+    for(cnt = 0; cnt < size; cnt++)
+    {
+        if(data[cnt] != '\n')
+        {
+            if(OPENEPT_EMU_SYNC_USED < OPENEPT_EMU_SYNC_SIZE - 1) OPENEPT_EMU_SYNC[OPENEPT_EMU_SYNC_USED++] = data[cnt];
+            continue;
+        }
+        OPENEPT_EMU_SYNC[OPENEPT_EMU_SYNC_USED] = '\0';
+        OPENEPT_EMU_SYNC_USED = 0;
+        if(sscanf(OPENEPT_EMU_SYNC, "%llu %u", &dutNs, &level) != 2) continue;
+        OPENEPT_EMU_STATS.syncs++;
+        fprintf(OPENEPT_EMU_LOG, "%llu SYNC %u %llu\n", (unsigned long long)now, level, dutNs);
+    }
+}
+
+static int OpenEPT_Emu_OpenPty()
+{
+    int master;
+    int slave;
+    char* name;
+
+    master = posix_openpt(O_RDWR | O_NOCTTY);
+    if(master < 0 || grantpt(master) != 0 || unlockpt(master) != 0) return -1;
+    name = ptsname(master);
+    if(name == NULL) return -1;
+    //Keep slave open so master does not report hangup while DUT reconnects
+    slave = open(name, O_RDWR | O_NOCTTY);
+    if(slave < 0) return -1;
+    OpenEPT_Emu_SetRaw(slave);
+    OpenEPT_Emu_SetRaw(master);
+    if(OPENEPT_EMU_CONF.ptyLink != NULL)
+    {
+        unlink(OPENEPT_EMU_CONF.ptyLink);
+        if(symlink(name, OPENEPT_EMU_CONF.ptyLink) != 0) return -1;
+        name = (char*)OPENEPT_EMU_CONF.ptyLink;
+    }
+    fprintf(stderr, "openept_emu: link %s\n", name);
+    return master;
+}
+
+static int OpenEPT_Emu_OpenSocket()
+{
+    struct sockaddr_un addr;
+    int fd;
+
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(fd < 0) return -1;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, OPENEPT_EMU_CONF.socketPath, sizeof(addr.sun_path) - 1);
+    unlink(OPENEPT_EMU_CONF.socketPath);
+    if(bind(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(fd, 1) != 0)
+    {
+        close(fd);
+        return -1;
+    }
+    fprintf(stderr, "openept_emu: listening on %s\n", OPENEPT_EMU_CONF.socketPath);
+    return fd;
+}
+
+/*
+ * Attach to a serial device or pty created by the DUT side (e.g. UART of Zephyr native_sim).
+ */
+static int OpenEPT_Emu_OpenDevice()
+{
+    int fd = open(OPENEPT_EMU_CONF.devicePath, O_RDWR | O_NOCTTY);
+    if(fd < 0) return -1;
+    if(isatty(fd)) OpenEPT_Emu_SetRaw(fd);
+    fprintf(stderr, "openept_emu: link %s\n", OPENEPT_EMU_CONF.devicePath);
+    return fd;
+}
+
+static int OpenEPT_Emu_OpenSync()
+{
+    int fd;
+    if(OPENEPT_EMU_CONF.syncPath == NULL) return -1;
+    if(mkfifo(OPENEPT_EMU_CONF.syncPath, 0644) != 0 && errno != EEXIST) return -1;
+    //Opened read-write so that it never reports end of file when writer closes
+    fd = open(OPENEPT_EMU_CONF.syncPath, O_RDWR | O_NONBLOCK);
+    return fd;
+}
+
+static void OpenEPT_Emu_Usage(const char* name)
+{
+    fprintf(stderr,
+            "usage: %s (-p [link] | -s socket | -c device) [options]\n"
+            "  -p [link]     create pty, optionally symlinked to link\n"
+            "  -s socket     listen on UNIX socket\n"
+            "  -c device     attach to existing tty or pty\n"
+            "  -y fifo       read SYNC edges from fifo (POSIX port side channel)\n"
+            "  -o file       capture log, default stdout\n"
+            "  -m mode       normal, slow, lossy or absent\n"
+            "  -d ms         response delay in slow mode (default 200)\n"
+            "  -r bytes/s    read rate limit in slow mode (default unlimited)\n"
+            "  -l percent    loss probability in lossy mode (default 30)\n"
+            "  -t table      expand hashed EPs with names from openept_ephash table\n"
+            "  -e table      expand linked EPs with names from openept_epelf table\n"
+            "  -b baud       accept baud rate offers up to baud\n"
+            "  -P version    accept binary protocol offers up to version (default %u, 0 for ASCII only)\n", name, OPENEPT_ED_PROTOCOL_VERSION);
+}
+
+int main(int argc, char** argv)
+{
+    struct pollfd pfd[3];
+    char data[512];
+    int listenFd = -1;
+    int linkFd = -1;
+    int syncFd = -1;
+    int option;
+    int usePty = 0;
+    uint64_t startNs;
+    uint64_t now;
+    ssize_t size;
+    int timeout;
+    nfds_t count;
+
+    OPENEPT_EMU_CONF.mode = OPENEPT_EMU_MODE_NORMAL;
+    OPENEPT_EMU_CONF.delayMs = 200;
+    OPENEPT_EMU_CONF.lossPercent = 30;
+    OPENEPT_EMU_CONF.protocol = OPENEPT_ED_PROTOCOL_VERSION;
+    while((option = getopt(argc, argv, "p::s:c:y:o:m:d:r:l:b:P:t:e:h")) != -1)
+    {
+        switch(option)
+        {
+        case 'p':
+            usePty = 1;
+            //Optional argument may also be given as a separate word
+            if(optarg == NULL && optind < argc && argv[optind][0] != '-') optarg = argv[optind++];
+            OPENEPT_EMU_CONF.ptyLink = optarg;
+            break;
+        case 's': OPENEPT_EMU_CONF.socketPath = optarg; break;
+        case 'c': OPENEPT_EMU_CONF.devicePath = optarg; break;
+        case 'y': OPENEPT_EMU_CONF.syncPath = optarg; break;
+        case 'o': OPENEPT_EMU_CONF.logPath = optarg; break;
+        case 't': OPENEPT_EMU_CONF.hashPath = optarg; break;
+        case 'e': OPENEPT_EMU_CONF.offsetPath = optarg; break;
+        case 'd': OPENEPT_EMU_CONF.delayMs = (uint32_t)strtoul(optarg, NULL, 10); break;
+        case 'r': OPENEPT_EMU_CONF.rateBps = (uint32_t)strtoul(optarg, NULL, 10); break;
+        case 'l': OPENEPT_EMU_CONF.lossPercent = (uint32_t)strtoul(optarg, NULL, 10); break;
+        case 'P': OPENEPT_EMU_CONF.protocol = (uint32_t)strtoul(optarg, NULL, 10); break;
+        case 'b': OPENEPT_EMU_CONF.negotiateBaud = (uint32_t)strtoul(optarg, NULL, 10); break;
+        case 'm':
+            if(strcmp(optarg, "normal") == 0) OPENEPT_EMU_CONF.mode = OPENEPT_EMU_MODE_NORMAL;
+            else if(strcmp(optarg, "slow") == 0) OPENEPT_EMU_CONF.mode = OPENEPT_EMU_MODE_SLOW;
+            else if(strcmp(optarg, "lossy") == 0) OPENEPT_EMU_CONF.mode = OPENEPT_EMU_MODE_LOSSY;
+            else if(strcmp(optarg, "absent") == 0) OPENEPT_EMU_CONF.mode = OPENEPT_EMU_MODE_ABSENT;
+            else
+            {
+                OpenEPT_Emu_Usage(argv[0]);
+                return 1;
+            }
+            break;
+        default:
+            OpenEPT_Emu_Usage(argv[0]);
+            return 1;
+        }
+    }
+    if(usePty + (OPENEPT_EMU_CONF.socketPath != NULL) + (OPENEPT_EMU_CONF.devicePath != NULL) != 1)
+    {
+        OpenEPT_Emu_Usage(argv[0]);
+        return 1;
+    }
+
+    if(OPENEPT_EMU_CONF.hashPath != NULL && OpenEPT_Emu_TableLoad(&OPENEPT_EMU_HASHES, OPENEPT_EMU_CONF.hashPath) != 0)
+    {
+        perror(OPENEPT_EMU_CONF.hashPath);
+        return 1;
+    }
+    if(OPENEPT_EMU_CONF.offsetPath != NULL && OpenEPT_Emu_TableLoad(&OPENEPT_EMU_OFFSETS, OPENEPT_EMU_CONF.offsetPath) != 0)
+    {
+        perror(OPENEPT_EMU_CONF.offsetPath);
+        return 1;
+    }
+
+    OPENEPT_EMU_LOG = stdout;
+    if(OPENEPT_EMU_CONF.logPath != NULL)
+    {
+        OPENEPT_EMU_LOG = fopen(OPENEPT_EMU_CONF.logPath, "w");
+        if(OPENEPT_EMU_LOG == NULL)
+        {
+            perror(OPENEPT_EMU_CONF.logPath);
+            return 1;
+        }
+    }
+    setvbuf(OPENEPT_EMU_LOG, NULL, _IOLBF, 0);
+    signal(SIGINT, OpenEPT_Emu_Stop);
+    signal(SIGTERM, OpenEPT_Emu_Stop);
+    signal(SIGPIPE, SIG_IGN);
+    srand((unsigned)OpenEPT_Emu_NowNs());
+
+    if(usePty) linkFd = OpenEPT_Emu_OpenPty();
+    else if(OPENEPT_EMU_CONF.devicePath != NULL) linkFd = OpenEPT_Emu_OpenDevice();
+    else listenFd = OpenEPT_Emu_OpenSocket();
+    if(linkFd < 0 && listenFd < 0)
+    {
+        perror("openept_emu");
+        return 1;
+    }
+    syncFd = OpenEPT_Emu_OpenSync();
+    if(OPENEPT_EMU_CONF.syncPath != NULL && syncFd < 0)
+    {
+        perror(OPENEPT_EMU_CONF.syncPath);
+        return 1;
+    }
+
+    startNs = OpenEPT_Emu_NowNs();
+    while(OPENEPT_EMU_RUN)
+    {
+        count = 0;
+        pfd[count].fd = linkFd >= 0 ? linkFd : listenFd;
+        pfd[count++].events = POLLIN;
+        if(syncFd >= 0)
+        {
+            pfd[count].fd = syncFd;
+            pfd[count++].events = POLLIN;
+        }
+        timeout = -1;
+        if(OPENEPT_EMU_REPLY_SIZE != 0)
+        {
+            now = OpenEPT_Emu_NowNs();
+            timeout = now >= OPENEPT_EMU_REPLY_DUE_NS ? 0 : (int)((OPENEPT_EMU_REPLY_DUE_NS - now) / 1000000ull) + 1;
+        }
+        if(poll(pfd, count, timeout) < 0 && errno != EINTR) break;
+        now = OpenEPT_Emu_NowNs();
+
+        if(pfd[0].revents & (POLLIN | POLLHUP | POLLERR))
+        {
+            if(linkFd < 0)
+            {
+                linkFd = accept(listenFd, NULL, NULL);
+                OPENEPT_EMU_FRAME_USED = 0;
+            }
+            else
+            {
+                size = read(linkFd, data, sizeof(data));
+                if(size > 0)
+                {
+                    OpenEPT_Emu_Receive(data, size, now);
+                    if(OPENEPT_EMU_CONF.mode == OPENEPT_EMU_MODE_SLOW && OPENEPT_EMU_CONF.rateBps != 0)
+                    {
+                        //Throttle reader so DUT sees back pressure of a slow link
+                        usleep((useconds_t)((uint64_t)size * 1000000ull / OPENEPT_EMU_CONF.rateBps));
+                    }
+                }
+                else if(size == 0 || (errno != EINTR && errno != EAGAIN))
+                {
+                    if(listenFd < 0) break;
+                    //DUT disconnected, wait for the next one
+                    close(linkFd);
+                    linkFd = -1;
+                    OPENEPT_EMU_REPLY_SIZE = 0;
+                }
+            }
+        }
+        if(count > 1 && (pfd[1].revents & POLLIN))
+        {
+            size = read(syncFd, data, sizeof(data));
+            if(size > 0) OpenEPT_Emu_SyncReceive(data, size, now);
+        }
+        if(linkFd >= 0) OpenEPT_Emu_ReplyFlush(linkFd);
+    }
+
+    now = OpenEPT_Emu_NowNs();
+    fprintf(stderr, "openept_emu: %llu frames (%llu EP, %llu INFO), %llu bytes, %llu SYNC edges, %llu replies, %llu lost, %llu corrupt in %.3f s\n",
+            (unsigned long long)OPENEPT_EMU_STATS.frames, (unsigned long long)OPENEPT_EMU_STATS.eps,
+            (unsigned long long)OPENEPT_EMU_STATS.infos, (unsigned long long)OPENEPT_EMU_STATS.bytes,
+            (unsigned long long)OPENEPT_EMU_STATS.syncs, (unsigned long long)OPENEPT_EMU_STATS.replies,
+            (unsigned long long)OPENEPT_EMU_STATS.lost, (unsigned long long)OPENEPT_EMU_STATS.corrupt, (double)(now - startNs) / 1e9);
+    if(OPENEPT_EMU_CONF.socketPath != NULL) unlink(OPENEPT_EMU_CONF.socketPath);
+    if(OPENEPT_EMU_CONF.ptyLink != NULL) unlink(OPENEPT_EMU_CONF.ptyLink);
+    return 0;
+}
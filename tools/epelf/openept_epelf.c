@@ -0,0 +1,143 @@
+/**
+ * @file openept_epelf.c
+ * @brief Energy point table extraction from firmware ELF.
+ *
+ * Reads the openept_eps section that OPENEPT_EP_DESCRIPTOR places names in and writes
+ * "<offset> <name>" lines, offset being the wire ID sent by OpenEPT_ED_SetEPDescriptor,
+ * for the Acquisition side (e.g. openept_emu -e). Handles 32 and 64 bit ELF of either
+ * byte order, so the same tool works for STM32, ESP and host builds.
+ */
+#include <elf.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../../feplib/feplib.h"
+
+static const uint8_t*   OPENEPT_EPELF_IMAGE;
+static long             OPENEPT_EPELF_SIZE;
+static int              OPENEPT_EPELF_SWAP;
+
+
+static uint64_t OpenEPT_EPElf_Read(uint64_t offset, uint32_t size)
+{
+    uint64_t value = 0;
+    uint32_t cnt;
+
+    if(offset + size > (uint64_t)OPENEPT_EPELF_SIZE) return 0;
+    for(cnt = 0; cnt < size; cnt++)
+    {
+        //Values are assembled explicitly, so host byte order does not matter
+        if(OPENEPT_EPELF_SWAP) value = (value << 8) | OPENEPT_EPELF_IMAGE[offset + cnt];
+        else value |= (uint64_t)OPENEPT_EPELF_IMAGE[offset + cnt] << (8 * cnt);
+    }
+    return value;
+}
+
+/*
+ * Find section by name. Returns 0 and sets file offset and size of its content on success.
+ */
+static int OpenEPT_EPElf_FindSection(const char* name, uint64_t* offset, uint64_t* size)
+{
+    int elf64 = OPENEPT_EPELF_IMAGE[EI_CLASS] == ELFCLASS64;
+    uint64_t sectionTable = elf64 ? OpenEPT_EPElf_Read(offsetof(Elf64_Ehdr, e_shoff), 8) : OpenEPT_EPElf_Read(offsetof(Elf32_Ehdr, e_shoff), 4);
+    uint32_t entrySize = (uint32_t)(elf64 ? OpenEPT_EPElf_Read(offsetof(Elf64_Ehdr, e_shentsize), 2) : OpenEPT_EPElf_Read(offsetof(Elf32_Ehdr, e_shentsize), 2));
+    uint32_t count = (uint32_t)(elf64 ? OpenEPT_EPElf_Read(offsetof(Elf64_Ehdr, e_shnum), 2) : OpenEPT_EPElf_Read(offsetof(Elf32_Ehdr, e_shnum), 2));
+    uint32_t names = (uint32_t)(elf64 ? OpenEPT_EPElf_Read(offsetof(Elf64_Ehdr, e_shstrndx), 2) : OpenEPT_EPElf_Read(offsetof(Elf32_Ehdr, e_shstrndx), 2));
+    uint64_t namesOffset;
+    uint64_t header;
+    uint64_t nameOffset;
+    uint32_t type;
+    uint32_t cnt;
+
+    if(sectionTable == 0 || names >= count) return -1;
+    header = sectionTable + (uint64_t)names * entrySize;
+    namesOffset = elf64 ? OpenEPT_EPElf_Read(header + offsetof(Elf64_Shdr, sh_offset), 8) : OpenEPT_EPElf_Read(header + offsetof(Elf32_Shdr, sh_offset), 4);
+    for(cnt = 0; cnt < count; cnt++)
+    {
+        header = sectionTable + (uint64_t)cnt * entrySize;
+        nameOffset = namesOffset + OpenEPT_EPElf_Read(header + (elf64 ? offsetof(Elf64_Shdr, sh_name) : offsetof(Elf32_Shdr, sh_name)), 4);
+        if(nameOffset + strlen(name) + 1 > (uint64_t)OPENEPT_EPELF_SIZE) continue;
+        if(strcmp((const char*)&OPENEPT_EPELF_IMAGE[nameOffset], name) != 0) continue;
+        type = (uint32_t)OpenEPT_EPElf_Read(header + (elf64 ? offsetof(Elf64_Shdr, sh_type) : offsetof(Elf32_Shdr, sh_type)), 4);
+        //Names must be in a loaded image, not only allocated
+        if(type == SHT_NOBITS) return -1;
+        *offset = elf64 ? OpenEPT_EPElf_Read(header + offsetof(Elf64_Shdr, sh_offset), 8) : OpenEPT_EPElf_Read(header + offsetof(Elf32_Shdr, sh_offset), 4);
+        *size = elf64 ? OpenEPT_EPElf_Read(header + offsetof(Elf64_Shdr, sh_size), 8) : OpenEPT_EPElf_Read(header + offsetof(Elf32_Shdr, sh_size), 4);
+        return *offset + *size <= (uint64_t)OPENEPT_EPELF_SIZE ? 0 : -1;
+    }
+    return -1;
+}
+
+int main(int argc, char** argv)
+{
+    FILE* output = stdout;
+    FILE* input;
+    uint8_t* image;
+    uint64_t offset;
+    uint64_t size;
+    uint64_t cnt;
+    uint32_t count = 0;
+
+    if(argc == 4 && strcmp(argv[1], "-o") == 0)
+    {
+        output = fopen(argv[2], "w");
+        if(output == NULL)
+        {
+            perror(argv[2]);
+            return 2;
+        }
+        argv += 2;
+    }
+    else if(argc != 2)
+    {
+        fprintf(stderr, "usage: %s [-o table] firmware.elf\n", argv[0]);
+        return 2;
+    }
+
+    input = fopen(argv[1], "rb");
+    if(input == NULL)
+    {
+        perror(argv[1]);
+        return 2;
+    }
+    fseek(input, 0, SEEK_END);
+    OPENEPT_EPELF_SIZE = ftell(input);
+    fseek(input, 0, SEEK_SET);
+    image = malloc((size_t)OPENEPT_EPELF_SIZE + 1);
+    if(image == NULL || OPENEPT_EPELF_SIZE < (long)sizeof(Elf32_Ehdr) ||
+       fread(image, 1, (size_t)OPENEPT_EPELF_SIZE, input) != (size_t)OPENEPT_EPELF_SIZE ||
+       memcmp(image, ELFMAG, SELFMAG) != 0)
+    {
+        fprintf(stderr, "%s: not an ELF file\n", argv[1]);
+        return 2;
+    }
+    fclose(input);
+    image[OPENEPT_EPELF_SIZE] = '\0';
+    OPENEPT_EPELF_IMAGE = image;
+    OPENEPT_EPELF_SWAP = image[EI_DATA] == ELFDATA2MSB;
+
+    if(OpenEPT_EPElf_FindSection(OPENEPT_EP_SECTION, &offset, &size) != 0)
+    {
+        fprintf(stderr, "%s: no %s section, no energy point descriptors are linked\n", argv[1], OPENEPT_EP_SECTION);
+        return 1;
+    }
+    //Descriptors are packed names; zero bytes between them are terminators or alignment padding
+    for(cnt = 0; cnt < size; cnt++)
+    {
+        if(image[offset + cnt] == '\0') continue;
+        if(memchr(&image[offset + cnt], '\0', (size_t)(size - cnt)) == NULL)
+        {
+            fprintf(stderr, "%s: name at offset %llu is not terminated\n", argv[1], (unsigned long long)cnt);
+            return 1;
+        }
+        fprintf(output, "%08llx %s\n", (unsigned long long)cnt, (const char*)&image[offset + cnt]);
+        cnt += strlen((const char*)&image[offset + cnt]);
+        count++;
+    }
+    if(output != stdout) fclose(output);
+    fprintf(stderr, "%u energy points\n", count);
+    free(image);
+    return 0;
+}
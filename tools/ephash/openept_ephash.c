@@ -0,0 +1,234 @@
+/**
+ * @file openept_ephash.c
+ * @brief Energy point hash table generator and collision check.
+ *
+ * Scans firmware sources for OPENEPT_EP("name"), OPENEPT_EP_HASH("name") and
+ * OPENEPT_EPF("format", ...), computes the same FNV-1a hash as the library and writes "<hash> <name>" lines for the Acquisition side
+ * (e.g. openept_emu -t). Exits with status 1 if two different names share a hash, so it can
+ * run as a build step over the whole firmware.
+ */
+#ifndef _DEFAULT_SOURCE
+#define _DEFAULT_SOURCE
+#endif
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../../feplib/feplib.h"
+
+typedef struct
+{
+    uint32_t    hash;
+    char*       name;
+    char*       location;
+}OpenEPT_EPHash_Entry;
+
+static OpenEPT_EPHash_Entry*    OPENEPT_EPHASH_ENTRIES;
+static uint32_t                 OPENEPT_EPHASH_COUNT;
+static uint32_t                 OPENEPT_EPHASH_CAPACITY;
+
+
+static uint32_t OpenEPT_EPHash_Hash(const char* name)
+{
+    uint32_t hash = OPENEPT_EP_HASH_BASIS;
+    while(*name != '\0') hash = (hash ^ (uint8_t)*name++) * OPENEPT_EP_HASH_PRIME;
+    return hash;
+}
+
+/*
+ * Parse one or more adjacent string literals starting at text. Returns pointer after the
+ * last literal or NULL if text does not start with a literal.
+ */
+static const char* OpenEPT_EPHash_ParseLiteral(const char* text, char* name, size_t size)
+{
+    size_t used = 0;
+    int found = 0;
+    char value;
+
+    for(;;)
+    {
+        while(*text == ' ' || *text == '\t' || *text == '\r' || *text == '\n') text++;
+        if(*text != '"') break;
+        found = 1;
+        for(text++; *text != '"' && *text != '\0'; text++)
+        {
+            value = *text;
+            if(value == '\\')
+            {
+                text++;
+                switch(*text)
+                {
+                case 'n': value = '\n'; break;
+                case 'r': value = '\r'; break;
+                case 't': value = '\t'; break;
+                case 'x': value = (char)strtoul(text + 1, (char**)&text, 16); text--; break;
+                case '0': case '1': case '2': case '3': case '4': case '5': case '6': case '7':
+                    value = (char)strtoul(text, (char**)&text, 8);
+                    text--;
+                    break;
+                default: value = *text; break;
+                }
+            }
+            if(used + 1 < size) name[used++] = value;
+        }
+        if(*text == '"') text++;
+    }
+    name[used] = '\0';
+    return found ? text : NULL;
+}
+
+/*
+ * Replace comments with spaces (newlines are kept for line numbers), so examples in
+ * comments are not taken for energy points.
+ */
+static void OpenEPT_EPHash_StripComments(char* text)
+{
+    char quote = 0;
+
+    for(; *text != '\0'; text++)
+    {
+        if(quote != 0)
+        {
+            if(*text == '\\' && text[1] != '\0') text++;
+            else if(*text == quote) quote = 0;
+            continue;
+        }
+        if(*text == '"' || *text == '\'')
+        {
+            quote = *text;
+        }
+        else if(text[0] == '/' && text[1] == '/')
+        {
+            while(*text != '\0' && *text != '\n') *text++ = ' ';
+            if(*text == '\0') return;
+        }
+        else if(text[0] == '/' && text[1] == '*')
+        {
+            while(*text != '\0' && !(text[0] == '*' && text[1] == '/'))
+            {
+                if(*text != '\n') *text = ' ';
+                text++;
+            }
+            if(*text == '\0') return;
+            text[0] = ' ';
+            text[1] = ' ';
+            text++;
+        }
+    }
+}
+
+static int OpenEPT_EPHash_Add(const char* name, const char* file, uint32_t line)
+{
+    uint32_t hash = OpenEPT_EPHash_Hash(name);
+    char location[512];
+    uint32_t cnt;
+
+    snprintf(location, sizeof(location), "%s:%u", file, line);
+    for(cnt = 0; cnt < OPENEPT_EPHASH_COUNT; cnt++)
+    {
+        if(OPENEPT_EPHASH_ENTRIES[cnt].hash != hash) continue;
+        if(strcmp(OPENEPT_EPHASH_ENTRIES[cnt].name, name) == 0) return 0;
+        fprintf(stderr, "%s: error: energy point \"%s\" has the same hash 0x%08x as \"%s\" (%s)\n",
+                location, name, hash, OPENEPT_EPHASH_ENTRIES[cnt].name, OPENEPT_EPHASH_ENTRIES[cnt].location);
+        return 1;
+    }
+    if(strlen(name) > OPENEPT_EP_NAME_MAX)
+    {
+        fprintf(stderr, "%s: warning: energy point \"%s\" is longer than %u characters\n", location, name, OPENEPT_EP_NAME_MAX);
+    }
+    if(OPENEPT_EPHASH_COUNT == OPENEPT_EPHASH_CAPACITY)
+    {
+        OPENEPT_EPHASH_CAPACITY = OPENEPT_EPHASH_CAPACITY ? OPENEPT_EPHASH_CAPACITY * 2 : 64;
+        OPENEPT_EPHASH_ENTRIES = realloc(OPENEPT_EPHASH_ENTRIES, OPENEPT_EPHASH_CAPACITY * sizeof(OpenEPT_EPHash_Entry));
+        if(OPENEPT_EPHASH_ENTRIES == NULL) exit(2);
+    }
+    OPENEPT_EPHASH_ENTRIES[OPENEPT_EPHASH_COUNT].hash = hash;
+    OPENEPT_EPHASH_ENTRIES[OPENEPT_EPHASH_COUNT].name = strdup(name);
+    OPENEPT_EPHASH_ENTRIES[OPENEPT_EPHASH_COUNT].location = strdup(location);
+    OPENEPT_EPHASH_COUNT++;
+    return 0;
+}
+
+static int OpenEPT_EPHash_Scan(const char* file)
+{
+    static const char* const macros[] = { "OPENEPT_EP_HASH(", "OPENEPT_EP(", "OPENEPT_EPF(" };
+    char name[256];
+    const char* pos;
+    const char* next;
+    char* text;
+    long size;
+    uint32_t line;
+    uint32_t cnt;
+    int errors = 0;
+    FILE* input;
+
+    input = fopen(file, "rb");
+    if(input == NULL)
+    {
+        perror(file);
+        return 1;
+    }
+    fseek(input, 0, SEEK_END);
+    size = ftell(input);
+    fseek(input, 0, SEEK_SET);
+    text = malloc((size_t)size + 1);
+    if(text == NULL || fread(text, 1, (size_t)size, input) != (size_t)size)
+    {
+        fclose(input);
+        free(text);
+        return 1;
+    }
+    text[size] = '\0';
+    fclose(input);
+    OpenEPT_EPHash_StripComments(text);
+
+    for(cnt = 0; cnt < sizeof(macros) / sizeof(macros[0]); cnt++)
+    {
+        for(pos = strstr(text, macros[cnt]); pos != NULL; pos = strstr(pos + 1, macros[cnt]))
+        {
+            //Skip longer identifiers that end with the macro name
+            if(pos != text && (pos[-1] == '_' || (pos[-1] >= 'A' && pos[-1] <= 'Z') || (pos[-1] >= 'a' && pos[-1] <= 'z') || (pos[-1] >= '0' && pos[-1] <= '9'))) continue;
+            //Macro definitions take a parameter, not a literal, and are skipped here
+            next = OpenEPT_EPHash_ParseLiteral(pos + strlen(macros[cnt]), name, sizeof(name));
+            if(next == NULL) continue;
+            line = 1;
+            for(next = text; next < pos; next++) line += (*next == '\n');
+            errors += OpenEPT_EPHash_Add(name, file, line);
+        }
+    }
+    free(text);
+    return errors;
+}
+
+int main(int argc, char** argv)
+{
+    FILE* output = stdout;
+    int errors = 0;
+    int cnt;
+
+    if(argc < 2)
+    {
+        fprintf(stderr, "usage: %s [-o table] source...\n", argv[0]);
+        return 2;
+    }
+    for(cnt = 1; cnt < argc; cnt++)
+    {
+        if(strcmp(argv[cnt], "-o") == 0 && cnt + 1 < argc)
+        {
+            output = fopen(argv[++cnt], "w");
+            if(output == NULL)
+            {
+                perror(argv[cnt]);
+                return 2;
+            }
+            continue;
+        }
+        errors += OpenEPT_EPHash_Scan(argv[cnt]);
+    }
+    for(cnt = 0; cnt < (int)OPENEPT_EPHASH_COUNT; cnt++)
+    {
+        fprintf(output, "%08x %s\n", OPENEPT_EPHASH_ENTRIES[cnt].hash, OPENEPT_EPHASH_ENTRIES[cnt].name);
+    }
+    if(output != stdout) fclose(output);
+    return errors != 0 ? 1 : 0;
+}
@@ -0,0 +1,297 @@
+/**
+ * @file openept_stress.c
+ * @brief Multi-producer stress test of the OpenEPT ED event ring.
+ *
+ * Runs producer threads that set energy points as fast as they can while one drain thread
+ * sends the event ring (woken by OpenEPT_ED_Platform_DrainRequest) and the main thread
+ * flushes concurrently, over the POSIX port to openept_emu. After STOP the capture log of
+ * the session is checked: no frame may be corrupt (interleaved), every thread must appear
+ * with exactly the events its calls queued, and the sequence gaps the emulator saw must
+ * match the dropped count the library reported.
+ *
+ * Built with the event ring enabled, e.g. -DOPENEPT_ED_CONF_EVENT_RING_SLOTS=256.
+ */
+#ifndef _DEFAULT_SOURCE
+#define _DEFAULT_SOURCE
+#endif
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "../../feplib/feplib.h"
+#include "../../feplib/platform.h"
+
+#if OPENEPT_CONF_EVENT_RING_SLOTS == 0
+#error "openept_stress needs the event ring, build with -DOPENEPT_ED_CONF_EVENT_RING_SLOTS=<slots>"
+#endif
+
+#define OPENEPT_STRESS_THREADS_MAX  OPENEPT_CONF_EP_DICTIONARY_SIZE
+#define OPENEPT_STRESS_LINE_SIZE    256
+
+typedef struct
+{
+    pthread_t   thread;
+    uint32_t    index;
+    uint32_t    epId;
+    char        name[16];
+    uint64_t    queued;        /* Calls that returned OK */
+    uint64_t    failed;        /* Calls that returned an error, the library counts them as dropped */
+    uint64_t    received;      /* EP lines of this thread in the capture */
+}OpenEPT_Stress_Producer;
+
+static struct
+{
+    uint32_t    threads;
+    uint64_t    events;
+    const char* capturePath;
+}OPENEPT_STRESS_CONF;
+
+static OpenEPT_Stress_Producer  OPENEPT_STRESS_PRODUCERS[OPENEPT_STRESS_THREADS_MAX];
+static sem_t                    OPENEPT_STRESS_DRAIN;
+static uint32_t                 OPENEPT_STRESS_RUN = 1;
+static uint32_t                 OPENEPT_STRESS_DONE;       /* Producers that finished */
+static pthread_barrier_t        OPENEPT_STRESS_GO;
+
+/**
+ * @brief Wake the drain thread, called by producers after they queued an event.
+ *
+ * Overrides the weak default; sem_post never blocks.
+ */
+void OpenEPT_ED_Platform_DrainRequest()
+{
+    int value;
+
+    //Drain thread sends everything queued so far, one pending wake is enough
+    if(sem_getvalue(&OPENEPT_STRESS_DRAIN, &value) == 0 && value > 0) return;
+    sem_post(&OPENEPT_STRESS_DRAIN);
+}
+
+static uint64_t OpenEPT_Stress_NowNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static void* OpenEPT_Stress_Producer_Run(void* arg)
+{
+    OpenEPT_Stress_Producer* producer = (OpenEPT_Stress_Producer*)arg;
+    uint64_t cnt;
+
+    pthread_barrier_wait(&OPENEPT_STRESS_GO);
+    for(cnt = 0; cnt < OPENEPT_STRESS_CONF.events; cnt++)
+    {
+        if(OpenEPT_ED_SetEP(producer->epId) == OPEN_EPT_STATUS_OK) producer->queued++;
+        else producer->failed++;
+    }
+    __atomic_fetch_add(&OPENEPT_STRESS_DONE, 1, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+/*
+ * Designated drainer: the only thread that sends the event ring while producers run.
+ */
+static void* OpenEPT_Stress_Drain_Run(void* arg)
+{
+    (void)arg;
+    while(__atomic_load_n(&OPENEPT_STRESS_RUN, __ATOMIC_ACQUIRE))
+    {
+        sem_wait(&OPENEPT_STRESS_DRAIN);
+        OpenEPT_ED_Poll();
+    }
+    return NULL;
+}
+
+/*
+ * Check capture log lines after the last START: "<ns> EP T<k> [@<DUT ns>]", CORRUPT, RAW
+ * and "SESSION eps=<n> duration_ns=<ns> missing=<n> dropped=<n>".
+ */
+static int OpenEPT_Stress_Check(uint32_t dropped)
+{
+    char line[OPENEPT_STRESS_LINE_SIZE];
+    char kind[16];
+    char payload[64];
+    unsigned long long ns;
+    unsigned long long eps = 0;
+    unsigned long long missing = 0;
+    unsigned long long sessionEps = 0;
+    unsigned sessionDropped = 0;
+    unsigned corrupt = 0;
+    unsigned raw = 0;
+    int session = 0;
+    int result = 0;
+    unsigned index;
+    uint32_t cnt;
+    FILE* capture = fopen(OPENEPT_STRESS_CONF.capturePath, "r");
+
+    if(capture == NULL)
+    {
+        perror(OPENEPT_STRESS_CONF.capturePath);
+        return 1;
+    }
+    while(fgets(line, sizeof(line), capture) != NULL)
+    {
+        if(sscanf(line, "%llu %15s %63s", &ns, kind, payload) < 2) continue;
+        if(strcmp(kind, "CTRL") == 0 && strncmp(payload, "START", 5) == 0)
+        {
+            //Only the last session counts
+            for(cnt = 0; cnt < OPENEPT_STRESS_CONF.threads; cnt++) OPENEPT_STRESS_PRODUCERS[cnt].received = 0;
+            eps = 0;
+            corrupt = 0;
+            raw = 0;
+            session = 0;
+        }
+        else if(strcmp(kind, "EP") == 0 && sscanf(payload, "T%u", &index) == 1 && index < OPENEPT_STRESS_CONF.threads)
+        {
+            OPENEPT_STRESS_PRODUCERS[index].received++;
+            eps++;
+        }
+        else if(strcmp(kind, "CORRUPT") == 0) corrupt++;
+        else if(strcmp(kind, "RAW") == 0) raw++;
+        else if(strcmp(kind, "SESSION") == 0 &&
+                sscanf(line, "%*u SESSION eps=%llu duration_ns=%*u missing=%llu dropped=%u", &sessionEps, &missing, &sessionDropped) == 3)
+        {
+            session = 1;
+        }
+    }
+    fclose(capture);
+
+    if(!session)
+    {
+        printf("FAIL no SESSION line in %s\n", OPENEPT_STRESS_CONF.capturePath);
+        return 1;
+    }
+    printf("capture: eps=%llu corrupt=%u raw=%u missing=%llu dropped=%u (library dropped=%u)\n", eps, corrupt, raw, missing, sessionDropped, dropped);
+    if(corrupt != 0 || raw != 0)
+    {
+        printf("FAIL interleaved or corrupt frames\n");
+        result = 1;
+    }
+    if(missing != sessionDropped || sessionDropped != dropped)
+    {
+        printf("FAIL sequence gaps do not match dropped count\n");
+        result = 1;
+    }
+    for(cnt = 0; cnt < OPENEPT_STRESS_CONF.threads; cnt++)
+    {
+        if(OPENEPT_STRESS_PRODUCERS[cnt].received != OPENEPT_STRESS_PRODUCERS[cnt].queued)
+        {
+            printf("FAIL %s queued %llu, captured %llu\n", OPENEPT_STRESS_PRODUCERS[cnt].name,
+                   (unsigned long long)OPENEPT_STRESS_PRODUCERS[cnt].queued, (unsigned long long)OPENEPT_STRESS_PRODUCERS[cnt].received);
+            result = 1;
+        }
+    }
+    return result;
+}
+
+static void OpenEPT_Stress_Usage(const char* name)
+{
+    fprintf(stderr,
+            "usage: %s -c capture [options]\n"
+            "  -c file       capture log written by openept_emu -o\n"
+            "  -t threads    producer threads (default 8, at most %u)\n"
+            "  -n events     events per thread (default 100000)\n", name, (unsigned)OPENEPT_STRESS_THREADS_MAX);
+}
+
+int main(int argc, char** argv)
+{
+    pthread_t drain;
+    uint64_t queued = 0;
+    uint64_t failed = 0;
+    uint64_t startNs;
+    uint64_t elapsedNs;
+    uint32_t flushes = 0;
+    uint32_t timeouts = 0;
+    uint32_t dropped;
+    uint32_t cnt;
+    int option;
+    int status;
+
+    OPENEPT_STRESS_CONF.threads = 8;
+    OPENEPT_STRESS_CONF.events = 100000;
+    while((option = getopt(argc, argv, "c:t:n:h")) != -1)
+    {
+        switch(option)
+        {
+        case 'c': OPENEPT_STRESS_CONF.capturePath = optarg; break;
+        case 't': OPENEPT_STRESS_CONF.threads = (uint32_t)strtoul(optarg, NULL, 10); break;
+        case 'n': OPENEPT_STRESS_CONF.events = strtoull(optarg, NULL, 10); break;
+        default:
+            OpenEPT_Stress_Usage(argv[0]);
+            return 1;
+        }
+    }
+    if(OPENEPT_STRESS_CONF.capturePath == NULL || OPENEPT_STRESS_CONF.threads == 0 || OPENEPT_STRESS_CONF.threads > OPENEPT_STRESS_THREADS_MAX)
+    {
+        OpenEPT_Stress_Usage(argv[0]);
+        return 1;
+    }
+
+    if(OpenEPT_ED_Init() != OPEN_EPT_STATUS_OK)
+    {
+        fprintf(stderr, "openept_stress: link init failed, set OPENEPT_LINK\n");
+        return 1;
+    }
+    for(cnt = 0; cnt < OPENEPT_STRESS_CONF.threads; cnt++)
+    {
+        OPENEPT_STRESS_PRODUCERS[cnt].index = cnt;
+        snprintf(OPENEPT_STRESS_PRODUCERS[cnt].name, sizeof(OPENEPT_STRESS_PRODUCERS[cnt].name), "T%u", cnt);
+        OpenEPT_ED_RegisterEP(OPENEPT_STRESS_PRODUCERS[cnt].name, &OPENEPT_STRESS_PRODUCERS[cnt].epId);
+    }
+    if(OpenEPT_ED_Start() != OPEN_EPT_STATUS_OK)
+    {
+        fprintf(stderr, "openept_stress: START failed\n");
+        return 1;
+    }
+
+    sem_init(&OPENEPT_STRESS_DRAIN, 0, 0);
+    pthread_barrier_init(&OPENEPT_STRESS_GO, NULL, OPENEPT_STRESS_CONF.threads + 1);
+    pthread_create(&drain, NULL, OpenEPT_Stress_Drain_Run, NULL);
+    for(cnt = 0; cnt < OPENEPT_STRESS_CONF.threads; cnt++)
+    {
+        pthread_create(&OPENEPT_STRESS_PRODUCERS[cnt].thread, NULL, OpenEPT_Stress_Producer_Run, &OPENEPT_STRESS_PRODUCERS[cnt]);
+    }
+    pthread_barrier_wait(&OPENEPT_STRESS_GO);
+    startNs = OpenEPT_Stress_NowNs();
+
+    //Control calls compete with the drain thread for the transport meanwhile
+    while(__atomic_load_n(&OPENEPT_STRESS_DONE, __ATOMIC_ACQUIRE) < OPENEPT_STRESS_CONF.threads)
+    {
+        status = OpenEPT_ED_Flush();
+        flushes++;
+        if(status == OPEN_EPT_STATUS_TIMEOUT) timeouts++;
+        usleep(1000);
+    }
+    for(cnt = 0; cnt < OPENEPT_STRESS_CONF.threads; cnt++)
+    {
+        pthread_join(OPENEPT_STRESS_PRODUCERS[cnt].thread, NULL);
+        queued += OPENEPT_STRESS_PRODUCERS[cnt].queued;
+        failed += OPENEPT_STRESS_PRODUCERS[cnt].failed;
+    }
+    elapsedNs = OpenEPT_Stress_NowNs() - startNs;
+    __atomic_store_n(&OPENEPT_STRESS_RUN, 0, __ATOMIC_RELEASE);
+    sem_post(&OPENEPT_STRESS_DRAIN);
+    pthread_join(drain, NULL);
+
+    if(OpenEPT_ED_Stop() != OPEN_EPT_STATUS_OK)
+    {
+        fprintf(stderr, "openept_stress: STOP failed\n");
+        return 1;
+    }
+    dropped = OpenEPT_ED_GetDropped();
+    printf("threads=%u events=%llu queued=%llu failed=%llu dropped=%u flushes=%u timeouts=%u %.3f Mevents/s\n",
+           OPENEPT_STRESS_CONF.threads, (unsigned long long)(queued + failed), (unsigned long long)queued, (unsigned long long)failed,
+           dropped, flushes, timeouts, (double)(queued + failed) * 1000.0 / (double)elapsedNs);
+    if(failed != dropped)
+    {
+        printf("FAIL failed calls do not match dropped count\n");
+        return 1;
+    }
+    status = OpenEPT_Stress_Check(dropped);
+    printf("%s\n", status == 0 ? "PASS" : "FAIL");
+    return status;
+}